@@ -17,6 +17,7 @@
 # along with adriagipas/MIX.  If not, see <https://www.gnu.org/licenses/>.
 #
  
+import struct
 import sys
 from array import array
 from optparse import OptionParser
@@ -358,6 +359,7 @@ class Mem:
     ASCII= 0
     PUNCHCARD= 1
     DECK= 2
+    IMAGE= 3
 
     # Fixa el valor de start.
     @classmethod
@@ -451,6 +453,39 @@ class Mem:
                 ind+= 1
                 begin= end
             f.write ( 'TRANS0%04d\n'%cls.__start )
+        elif mode == Mem.IMAGE :
+            # Segments de paraules consecutives, vore MIX_load_image_file.
+            segs= []
+            begin= 0
+            while begin < 4000 :
+                if not cls.__modified[begin] :
+                    begin+= 1
+                    continue
+                end= begin
+                while end < 4000 and cls.__modified[end] : end+= 1
+                segs.append ( (begin,end) )
+                begin= end
+            data= b'MIXPRG1\0'+struct.pack ( '>II', cls.__start, len(segs) )
+            for begin,end in segs:
+                data+= struct.pack ( '>II', begin, end-begin )
+                for i in range(begin,end):
+                    aux= cls.__mem[i]
+                    value= (((((((aux[1]<<6)|aux[2])<<6)|
+                               aux[3])<<6)|aux[4])<<6)|aux[5]
+                    if aux[0] : value|= 0x80000000
+                    data+= struct.pack ( '>I', value )
+            f.write ( data )
+
+    # Escriu el mapa de les línies de SOURCE, vore MIX_MAP_MAGIC.
+    @classmethod
+    def write_map ( cls, f, source ):
+        addrs= {}
+        for i in range(3999,-1,-1):
+            if cls.__modified[i] and cls.__lines[i] != None :
+                addrs[cls.__lines[i]]= i
+        f.write ( 'MIXMAP1\n' )
+        for i,l in enumerate(source):
+            f.write ( 'L %d %d %s\n'%(i+1,addrs.get(i+1,-1),l.rstrip('\r\n')) )
 
 
 # Caràcters '_' representa l'espai.
@@ -523,13 +558,14 @@ IChars[10]= '&'
 # FUNCIONS #
 ############
 
-# Processa el fitxer carregant les entrades
-def read_tuples ( input_fn ):
+# Processa el fitxer carregant les entrades. Afegix les línies a SOURCE.
+def read_tuples ( input_fn, source ):
     f= sys.stdin if input_fn == "" else open ( input_fn )
     code= []
     num_line= 0
     l= f.readline()
     while l != "":
+        source.append ( l )
         line= l.split()
         l= f.readline()
         num_line+= 1
@@ -878,9 +914,15 @@ parser.add_option ( "-o", "--output", action= "store",
                     type= "string", dest= "output",
                     default= "", metavar= "OUTPUT",
                     help= "Fitxer d'eixida" )
+parser.add_option ( "-s", "--map", action= "store",
+                    type= "string", dest= "map",
+                    default= "", metavar= "MAP",
+                    help= "Escriu en MAP l'adreça de cada línia, per a"+
+                    " anotar el codi amb MIX_profile_write_listing" )
 parser.add_option ( "-m", "--mode", action= "store",
                     type= "choice", dest= "mode",
-                    default= "DECK", choices= ["ASCII","PUNCHCARD","DECK"],
+                    default= "DECK",
+                    choices= ["ASCII","PUNCHCARD","DECK","IMAGE"],
                     metavar= "MODE",
                     help=
                     "Especifica quin tipus d'eixida a de generar:"+
@@ -894,7 +936,11 @@ parser.add_option ( "-m", "--mode", action= "store",
                     "                                                    "+
                     "  DECK: preparat per a ser executat per la màquina MIX"+
                     " l'única restricció és que les adreces siguen major que"+
-                    " 100. Típicament per a codi que va després del loader" )
+                    " 100. Típicament per a codi que va després del loader"+
+                    "                                                    "+
+                    "  IMAGE: imatge binària de la memòria per a carregar-la"+
+                    " directament amb MIX_load_image_file, sense"+
+                    " carregador ni restriccions d'adreces" )
 (opts, args)= parser.parse_args()
 if opts.mode == 'ASCII' :
     mode= Mem.ASCII
@@ -902,14 +948,25 @@ elif opts.mode == 'PUNCHCARD' :
     mode= Mem.PUNCHCARD
 elif opts.mode == 'DECK' :
     mode= Mem.DECK
+elif opts.mode == 'IMAGE' :
+    mode= Mem.IMAGE
 
 # Cos
 try:
-    code= read_tuples ( opts.input )
+    source= []
+    code= read_tuples ( opts.input, source )
     step1 ( code )
     step2 ( code )
-    f= sys.stdout if opts.output == "" else open ( opts.output, 'w' )
+    if mode == Mem.IMAGE :
+        f= (sys.stdout.buffer if opts.output == "" else
+            open ( opts.output, 'wb' ))
+    else:
+        f= sys.stdout if opts.output == "" else open ( opts.output, 'w' )
     Mem.write ( f, mode )
     if f != sys.stdout : f.close()
+    if opts.map != "" :
+        f= open ( opts.map, 'w' )
+        Mem.write_map ( f, source )
+        f.close()
 except Exception as msg:
     sys.exit ( 'Error: %s.'%msg )
@@ -0,0 +1,181 @@
+#
+# Copyright 2009-2022 Adrià Giménez Pastor.
+#
+# This file is part of adriagipas/MIX.
+#
+# adriagipas/MIX is free software: you can redistribute it and/or
+# modify it under the terms of the GNU General Public License as
+# published by the Free Software Foundation, either version 3 of the
+# License, or (at your option) any later version.
+#
+# adriagipas/MIX is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with adriagipas/MIX.  If not, see <https://www.gnu.org/licenses/>.
+#
+
+# Passa a text una traça de MIX_machine_trace_start (vore MIX.h).
+
+import struct
+import sys
+from optparse import OptionParser
+
+
+
+
+#############
+# CONSTANTS #
+#############
+
+MAGIC= b'MIXTRC1\0'
+
+NMASK= 0x80000000
+INMASK= 0x3FFFFFFF
+
+# Bits de 'changed'.
+TRACE_J= 0x0100
+TRACE_MEM= 0x0200
+TRACE_OVERFLOW= 0x0400
+TRACE_CMP= 0x0800
+
+# Noms dels registres pel seu número.
+REGS= ['A','I1','I2','I3','I4','I5','I6','X']
+
+# Noms de les instruccions amb F fixat, per codi C.
+NAMES_F= { 5 : ['NUM','CHAR','HLT'],
+           6 : ['SLA','SRA','SLAX','SRAX','SLC','SRC'],
+           39 : ['JMP','JSJ','JOV','JNOV','JL','JE','JG','JGE','JNE','JLE'] }
+
+# Noms de la resta d'instruccions.
+NAMES= { 0 : 'NOP', 1 : 'ADD', 2 : 'SUB', 3 : 'MUL', 4 : 'DIV',
+         7 : 'MOVE', 32 : 'STJ', 33 : 'STZ', 34 : 'JBUS', 35 : 'IOC',
+         36 : 'IN', 37 : 'OUT', 38 : 'JRED' }
+
+
+
+
+############
+# FUNCIONS #
+############
+
+# Torna el nom de la instrucció.
+def name ( C, F ):
+    if C in NAMES_F :
+        l= NAMES_F[C]
+        return l[F] if F < len(l) else '?'
+    if C in NAMES : return NAMES[C]
+    if C <= 15 : return 'LD'+REGS[C-8]
+    if C <= 23 : return 'LD'+REGS[C-16]+'N'
+    if C <= 31 : return 'ST'+REGS[C-24]
+    if C <= 47 :
+        l= ['N','Z','P','NN','NZ','NP']
+        return 'J'+REGS[C-40]+l[F] if F < len(l) else '?'
+    if C <= 55 :
+        l= ['INC','DEC','ENT','ENN']
+        return l[F]+REGS[C-48] if F < len(l) else '?'
+    return 'CMP'+REGS[C-56]
+
+
+# Torna la paraula com un sencer amb signe.
+def word ( w ):
+    return '%+d'%(-(w&INMASK) if w&NMASK else w&INMASK)
+
+
+# Torna el text de la instrucció.
+def inst ( w ):
+    C= w&0x3F
+    F= (w>>6)&0x3F
+    I= (w>>12)&0x3F
+    A= (w>>18)&0xFFF
+    if w&NMASK : A= -A
+    ret= '%-4s %d'%(name(C,F),A)
+    if I != 0 : ret+= ',%d'%I
+    # En i/o i salts F no és un camp, com en mixala.
+    if C >= 34 and C <= 47 : return ret+'(%d)'%F
+    return ret+'(%d:%d)'%(F>>3,F&0x7)
+
+
+# Torna el text dels canvis del registre. El desbordament sempre
+# canvia a l'altre valor.
+def changes ( changed, value, addr ):
+    ret= []
+    if changed&TRACE_MEM : ret.append ( '[%04d]=%s'%(addr,word(value)) )
+    for i in range(0,8):
+        if changed&(1<<i) : ret.append ( '%s=%s'%(REGS[i],word(value)) )
+    if changed&TRACE_J : ret.append ( 'J=%s'%word(value) )
+    if changed&TRACE_CMP :
+        ret.append ( 'CI=%s'%'ELG'[value] )
+    if changed&TRACE_OVERFLOW : ret.append ( 'OV' )
+    return ' '.join ( ret )
+
+
+# Llig el mapa de mixala, torna el text de cada adreça.
+def read_map ( fn ):
+    ret= {}
+    f= open ( fn )
+    if f.readline() != 'MIXMAP1\n' :
+        raise Exception ( "'%s' no és un mapa de mixala"%fn )
+    for l in f:
+        aux= l.rstrip('\n').split ( ' ', 3 )
+        if len(aux) >= 3 and aux[2] != '-1' :
+            ret[int(aux[2])]= aux[3].strip() if len(aux) == 4 else ''
+    f.close()
+    return ret
+
+
+# Escriu en F el text de la traça TRACE.
+def decode ( trace, f, lines ):
+    header= trace.read ( 16 )
+    if len(header) != 16 or header[:8] != MAGIC :
+        raise Exception ( 'no és una traça de MIX' )
+    order= '<' if struct.unpack ( '<I', header[12:] )[0] == 0x01020304 else '>'
+    size= struct.unpack ( order+'I', header[8:12] )[0]
+    if size != 24 :
+        raise Exception ( 'grandària de registre desconeguda: %d'%size )
+    rec= struct.Struct ( order+'QIIHHHH' )
+    while True:
+        data= trace.read ( size )
+        if len(data) < size : break
+        clock,w,value,pc,addr,changed,cycles= rec.unpack ( data )
+        l= '%12d %04d %-20s %3du  %s'%(clock,pc,inst(w),cycles,
+                                       changes(changed,value,addr))
+        if lines != None and pc in lines :
+            l= '%-70s ; %s'%(l,lines[pc])
+        f.write ( l.rstrip()+'\n' )
+
+
+
+
+########
+# MAIN #
+########
+
+parser= OptionParser( usage= "mixtrace.py -i <traça> [-s <mapa>]",
+                      version= "mixtrace.py 1.0" )
+parser.add_option ( "-i", "--input", action= "store",
+                    type= "string", dest= "input",
+                    default= "", metavar= "INPUT",
+                    help= "Fitxer amb la traça" )
+parser.add_option ( "-o", "--output", action= "store",
+                    type= "string", dest= "output",
+                    default= "", metavar= "OUTPUT",
+                    help= "Fitxer d'eixida" )
+parser.add_option ( "-s", "--map", action= "store",
+                    type= "string", dest= "map",
+                    default= "", metavar= "MAP",
+                    help= "Mapa de mixala (opció --map) per a mostrar"+
+                    " la línia de cada instrucció" )
+(opts, args)= parser.parse_args()
+
+try:
+    lines= read_map ( opts.map ) if opts.map != "" else None
+    trace= (sys.stdin.buffer if opts.input == "" else
+            open ( opts.input, 'rb' ))
+    f= sys.stdout if opts.output == "" else open ( opts.output, 'w' )
+    decode ( trace, f, lines )
+    if f != sys.stdout : f.close()
+except Exception as msg:
+    sys.exit ( 'Error: %s.'%msg )
@@ -21,6 +21,10 @@
  *          una màquina amb bytes de 6 bits i amb unes prestacions
  *          normals (5MHz).
  *
+ *          La implementació està en mix.c, mix_dev.c i mix_aot.c.
+ *          mix.c depén de mix_aot.c (MIX_machine_translate), així
+ *          que sempre s'han d'enllaçar junts.
+ *
  */
 
 #ifndef __MIX_H__
@@ -29,6 +33,8 @@
 #include <limits.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
 
 
 /*********/
@@ -177,6 +183,7 @@ typedef struct
   
   size_t remain;    /* Paraules que falten per escriure/llegir. */
   int    _addr;     /* Adreça on s'escriu/llig. */
+  long   block;     /* Bloc dels discs (magnitud de rX). */
   
 } MIX_IOOPWord;
 
@@ -188,7 +195,8 @@ typedef enum
         			      pàgina. */
     MIX_MT_REWOUND,                /* Rebobina la cinta. */
     MIX_MT_SKIPBACKWARD,           /* Retrocedeix blocs. */
-    MIX_MT_SKIPFORWARD             /* Avança blocs. */
+    MIX_MT_SKIPFORWARD,            /* Avança blocs. */
+    MIX_DK_SEEK                    /* Posiciona el disc. */
   } MIX_IOControlOp;
 
 /* Funció per a metre avísos. */
@@ -251,6 +259,9 @@ typedef MIX_Bool
  * MIX_MT_SKIPFORWARD [0-7] N
  *   - Avança la cinta indicada N paraules, o va al final de la cinta,
  *     el que ocorrega primer.
+ * MIX_DK_SEEK [8-15] BLOC
+ *   - Posiciona el disc indicat en el bloc BLOC (long, magnitud de
+ *     rX). No transferix res, sols és una indicació.
  */
 typedef void
 (MIX_IOControl) (
@@ -300,9 +311,923 @@ typedef struct
   
 } MIX_Frontend;
 
+/* Màquina MIX. Tipus opac que conté tot l'estat d'un simulador
+ * (registres, memòria, operacions de i/o en curs i frontend). Les
+ * màquines són independents entre elles, per tant es poden executar
+ * diferents màquines en paral·lel, cadascuna en el seu fil. Una
+ * mateixa màquina no s'ha de manipular des de més d'un fil a la
+ * vegada.
+ */
+typedef struct MIX_Machine MIX_Machine;
+
 
 /* FUNCIONS */
 
+/* Crea una màquina nova parada. Cal inicialitzar-la amb
+ * MIX_machine_init abans d'usar-la. Torna NULL si no hi ha memòria.
+ */
+MIX_Machine *
+MIX_machine_new (void);
+
+/* Allibera una màquina creada amb MIX_machine_new. */
+void
+MIX_machine_free (
+                  MIX_Machine *m
+                  );
+
+/* Igual que MIX_go però sobre la màquina indicada. */
+void
+MIX_machine_go (
+                MIX_Machine *m
+                );
+
+/* Copia COUNT paraules en la memòria a partir de START i, si PC no és
+ * negatiu, engega la màquina en PC amb J=0, com ho faria el
+ * carregador en llegir la targeta TRANS0. Evita MIX_go i el
+ * carregador de les targetes. S'ha de cridar amb la màquina
+ * parada. Torna MIX_FALSE si les adreces estan fora de rang.
+ */
+MIX_Bool
+MIX_load_image (
+                MIX_Machine    *m,
+                const MIX_Word *words,
+                const int       start,
+                const int       count,
+                const int       pc
+                );
+
+/* Imatges binàries de programes (mode IMAGE de mixala). Tots els
+ * sencers són de 32 bits en big-endian. Comença per MIX_IMAGE_MAGIC
+ * (8 bytes amb el '\0'), l'adreça d'inici i el nombre de
+ * segments. Cada segment té l'adreça, el nombre de paraules i les
+ * paraules.
+ */
+#define MIX_IMAGE_MAGIC "MIXPRG1"
+
+/* Carrega el fitxer FN amb MIX_load_image i engega la màquina en
+ * l'adreça d'inici. Torna MIX_FALSE si no es pot llegir o no és una
+ * imatge vàlida; en eixe cas la memòria pot haver canviat.
+ */
+MIX_Bool
+MIX_load_image_file (
+                     MIX_Machine *m,
+                     const char  *fn
+                     );
+
+/* Còpia de l'estat d'una màquina: registres, indicadors, memòria,
+ * estat d'execució, descriptors de les operacions d'i/o en curs, el
+ * rellotge (cicles des de MIX_machine_init), el nombre d'instruccions
+ * executades, les aplicacions de superinstruccions
+ * (MIX_machine_fusion_hits) i l'estat del model de temps dels
+ * dispositius (MIX_machine_set_device_timing i
+ * MIX_machine_set_disk_timing, amb les operacions pendents i
+ * MIX_machine_disk_stats). No inclou MIX_Counters, la configuració de
+ * MIX_machine_init ni l'estat dels dispositius del frontal, per això
+ * convé fer-la i restaurar-la quan el frontal no té cap operació en
+ * curs.
+ */
+typedef struct MIX_Snapshot MIX_Snapshot;
+
+/* Reserva una còpia buida. Torna NULL si no hi ha memòria. */
+MIX_Snapshot *
+MIX_snapshot_new (void);
+
+/* Allibera una còpia creada amb MIX_snapshot_new. */
+void
+MIX_snapshot_free (
+                   MIX_Snapshot *s
+                   );
+
+/* Guarda en S l'estat de la màquina, que no ha d'estar dins de
+ * MIX_run.
+ */
+void
+MIX_machine_snapshot (
+                      MIX_Machine  *m,
+                      MIX_Snapshot *s
+                      );
+
+/* Torna la màquina a l'estat guardat en S, que pot vindre d'una altra
+ * màquina. Copia tota la memòria.
+ */
+void
+MIX_machine_restore (
+                     MIX_Machine        *m,
+                     const MIX_Snapshot *s
+                     );
+
+/* Com MIX_machine_restore, però si l'última còpia o restauració de la
+ * màquina va ser amb S només copia les pàgines de 64 paraules escrites
+ * des d'aleshores. Permet llançar moltes execucions des d'un mateix
+ * punt, per exemple després de carregar el programa.
+ */
+void
+MIX_machine_fork (
+                  MIX_Machine        *m,
+                  const MIX_Snapshot *s
+                  );
+
+/* Igual que MIX_init però sobre la màquina indicada. */
+void
+MIX_machine_init (
+                  MIX_Machine        *m,
+                  const MIX_Frontend *frontend,
+                  void               *udata
+                  );
+
+/* Motors d'execució. */
+typedef enum
+  {
+    MIX_ENGINE_INTERP= 0, // Intèrpret (per defecte)
+    MIX_ENGINE_JIT,       // Traducció a codi natiu dels blocs més executats
+    MIX_ENGINE_AOT,       // Codi generat amb MIX_aot_translate
+    MIX_ENGINE_PROFILE    // Intèrpret que compta cada adreça (vore
+                          // MIX_machine_profile)
+  } MIX_Engine;
+
+/* Traducció anticipada (AOT). MIX_aot_translate escriu un fitxer C
+ * amb una funció per cada bloc bàsic accessible des dels punts
+ * d'entrada, i la variable 'MIX_aot_module' que els agrupa. El
+ * fitxer es compila com una llibreria dinàmica:
+ *
+ *   cc -O2 -shared -fPIC -I <directori de MIX.h> prog.c -o prog.so
+ *
+ * i, després d'obtindre 'MIX_aot_module' amb dlopen/dlsym (o enllaçant
+ * el fitxer directament), es registra amb MIX_machine_set_aot. Cada
+ * bloc només s'executa si la memòria coincidix amb la imatge traduïda,
+ * en cas contrari (o amb les instruccions no traduïdes: i/o, HLT, MOVE
+ * i DIV) s'usa l'intèrpret.
+ */
+#define MIX_AOT_VERSION 3
+
+/* Estat que es passa als blocs traduïts. 'overflow' és 0 o 1 i
+ * 'cmp' 0 (igual), 1 (menor) o 2 (major).
+ */
+typedef struct
+{
+  MIXu32               A;
+  MIXu32               X;
+  MIXu32               I[6];
+  MIXu32               J;
+  int                  overflow;
+  int                  cmp;
+  int                  cc;      // Cicles que queden per executar
+  int                  written; // Adreça precalculada modificada (-1 cap)
+  unsigned long long   dirty;   // Pàgines de 64 paraules escrites (bit M>>6)
+  unsigned long long   insts;   // Instruccions executades
+  MIXu32              *mem;
+  const unsigned char *code;
+} MIX_AOTState;
+
+/* Bloc traduït. Torna la següent adreça, o -1-PC si l'instrucció en
+ * PC l'ha d'executar l'intèrpret.
+ */
+typedef int (MIX_AOTBlock) (MIX_AOTState *s);
+
+/* Mòdul generat per MIX_aot_translate. */
+typedef struct
+{
+  int                        version; // MIX_AOT_VERSION
+  const MIX_Word            *image;   // Memòria traduïda
+  MIX_AOTBlock *const       *table;   // Bloc que comença en cada adreça
+  const short               *owner;   // Inici del bloc de cada adreça
+  const short               *end;     // Final de cada bloc
+} MIX_AOTModule;
+
+/* Escriu en F la traducció a C de MEM, començant pels NENTRIES punts
+ * d'entrada ENTRIES. Torna el número de blocs traduïts o -1 si hi ha
+ * un error d'escriptura.
+ */
+int
+MIX_aot_translate (
+                   const MIX_Word  mem[4000],
+                   const int      *entries,
+                   const int       nentries,
+                   FILE           *f
+                   );
+
+/* Selecciona el motor d'execució de la màquina. Tots els motors
+ * produïxen el mateix estat i els mateixos cicles, es pot canviar en
+ * qualsevol moment entre crides a MIX_machine_iter. Torna MIX_FALSE si
+ * el motor no està disponible (el JIT sols existix per a x86-64 en
+ * Linux i necessita que el sistema permeta fer executable la memòria,
+ * l'AOT necessita un mòdul registrat amb MIX_machine_set_aot), en eixe
+ * cas la màquina es queda amb l'intèrpret. El codi del JIT mai és
+ * alhora escrivible i executable; si el sistema ho impedix després
+ * d'haver-lo seleccionat, la màquina també torna a l'intèrpret.
+ */
+MIX_Bool
+MIX_machine_set_engine (
+                        MIX_Machine      *m,
+                        const MIX_Engine  engine
+                        );
+
+/* Registra en la màquina un mòdul generat per MIX_aot_translate, el
+ * qual s'usa amb el motor MIX_ENGINE_AOT. NULL l'elimina (i torna a
+ * l'intèrpret si estava en ús). Torna MIX_FALSE si la versió del
+ * mòdul no és MIX_AOT_VERSION.
+ */
+MIX_Bool
+MIX_machine_set_aot (
+                     MIX_Machine         *m,
+                     const MIX_AOTModule *mod
+                     );
+
+/* Tradueix a C la memòria actual de la màquina, amb el PC com a punt
+ * d'entrada (vore MIX_aot_translate). Està en mix.c però crida a
+ * MIX_aot_translate, per tant qualsevol programa que enllace mix.c
+ * també ha d'enllaçar mix_aot.c.
+ */
+int
+MIX_machine_translate (
+                       MIX_Machine *m,
+                       FILE        *f
+                       );
+
+/* Superinstruccions del motor 'threaded'. Són seqüències habituals
+ * d'instruccions que s'executen juntes, amb els mateixos cicles que
+ * per separat.
+ */
+typedef enum
+  {
+    MIX_FUSION_MOP_JREG= 0, // INCr/DECr + Jr (final de bucle)
+    MIX_FUSION_LD_CMP_JOP,  // LDr + CMPr + JL-JLE (cerca), r= A,X
+    MIX_FUSION_ST_MOP_JREG, // ST + INCi/DECi + Ji (omplir una taula)
+    MIX_FUSION_NUM
+  } MIX_Fusion;
+
+/* Torna les vegades que s'ha executat la superinstrucció indicada
+ * des de l'última crida a MIX_machine_init. Servix per a saber quines
+ * són útils en un programa.
+ */
+unsigned long long
+MIX_machine_fusion_hits (
+                         MIX_Machine      *m,
+                         const MIX_Fusion  idiom
+                         );
+
+/* Classes d'instruccions dels comptadors. */
+typedef enum
+  {
+    MIX_CLASS_ARITH= 0, // ADD, SUB, MUL, DIV
+    MIX_CLASS_SPECIAL,  // NOP, NUM, CHAR, HLT, desplaçaments i MOVE
+    MIX_CLASS_LOAD,     // LDr, LDrN
+    MIX_CLASS_STORE,    // STr, STJ, STZ
+    MIX_CLASS_IO,       // JBUS, IOC, IN, OUT, JRED
+    MIX_CLASS_JUMP,     // JMP-JLE, Jr
+    MIX_CLASS_MOP,      // INCr, DECr, ENTr, ENNr
+    MIX_CLASS_CMP,      // CMPr
+    MIX_CLASS_NUM
+  } MIX_OpClass;
+
+/* Tipus d'avís dels comptadors. */
+typedef enum
+  {
+    MIX_WARN_FIELD= 0, // F no és un camp (L:R) vàlid
+    MIX_WARN_INDEX,    // I major que 6
+    MIX_WARN_ADDRESS,  // M o I1 (MOVE) fora de la memòria
+    MIX_WARN_OP,       // Operació no vàlida o no implementada
+    MIX_WARN_DEVICE,   // Dispositiu no vàlid o operació no suportada
+    MIX_WARN_NUM
+  } MIX_WarningKind;
+
+/* Comptadors de rendiment des de MIX_machine_init o
+ * MIX_machine_reset_counters. Són camps normals de la màquina i no
+ * formen part de les còpies (MIX_Snapshot).
+ *
+ * OPS, OPS_F, CYCLES i UNTRACKED són per instrucció i sols es porten
+ * mentre estan activats amb MIX_machine_set_counting. La resta
+ * (esperes, GO, avisos i SMC) es porten sempre. OPS i CYCLES sols
+ * inclouen les instruccions executades per l'intèrpret. Les dels
+ * blocs traduïts pel JIT o per MIX_aot_translate no s'instrumenten,
+ * es compten en UNTRACKED. Els cicles en WAIT_DEVICE inclouen els
+ * dels bucles d'espera de JBUS/JRED, que també es compten com a
+ * instruccions executades.
+ * SMC són les escriptures de ST o MOVE en paraules que ja s'havien
+ * descodificat per a executar-les.
+ */
+typedef struct
+{
+
+  unsigned long long ops[64];               // Instruccions per codi C
+  unsigned long long ops_f[3][64];          // Per F de C=5, 6 i 39
+  unsigned long long cycles[MIX_CLASS_NUM]; // Cicles per MIX_OpClass
+  unsigned long long untracked;             // Instruccions de codi traduït
+  unsigned long long wait[21];              // Cicles esperant cada dispositiu
+  unsigned long long go_steps;              // Iteracions del botó GO
+  unsigned long long warnings[MIX_WARN_NUM];
+  unsigned long long smc;                   // Codi automodificat
+
+} MIX_Counters;
+
+void
+MIX_machine_counters (
+                      MIX_Machine  *m,
+                      MIX_Counters *counters
+                      );
+
+void
+MIX_machine_reset_counters (
+                            MIX_Machine *m
+                            );
+
+/* Activa o desactiva els comptadors per instrucció (per defecte estan
+ * desactivats). Mentre estan activats no s'usa el 'threaded
+ * dispatch', sinó l'intèrpret instrucció a instrucció, de manera que
+ * desactivats no costen res. Els blocs del JIT i de MIX_aot_translate
+ * continuen executant-se i es compten en UNTRACKED. La configuració es
+ * manté després de MIX_machine_init.
+ */
+void
+MIX_machine_set_counting (
+                          MIX_Machine    *m,
+                          const MIX_Bool  enable
+                          );
+
+/* Perfil d'una adreça, a l'estil de les anàlisis de TAOCP. Els cicles
+ * són les unitats de temps (u) de cada execució. Els salts (JBUS,
+ * JRED, JMP-JXP) es compten com a presos quan la següent instrucció no
+ * és la de l'adreça següent.
+ */
+typedef struct
+{
+  unsigned long long count;     // Execucions
+  unsigned long long cycles;    // Cicles
+  unsigned long long taken;     // Salts presos
+  unsigned long long not_taken; // Salts no presos
+} MIX_ProfileEntry;
+
+/* Torna el perfil de les 4000 adreces des de l'última crida a
+ * MIX_machine_init. Sols s'actualitza mentre la màquina usa el motor
+ * MIX_ENGINE_PROFILE, i és NULL si no s'ha seleccionat mai.
+ */
+const MIX_ProfileEntry *
+MIX_machine_profile (
+                     MIX_Machine *m
+                     );
+
+/* Escriu en F les adreces executades del perfil PROF en CSV (amb
+ * capçalera) o en JSON. Tornen MIX_FALSE si hi ha un error d'escriptura.
+ */
+MIX_Bool
+MIX_profile_write_csv (
+                       const MIX_ProfileEntry  prof[4000],
+                       FILE                   *f
+                       );
+
+MIX_Bool
+MIX_profile_write_json (
+                        const MIX_ProfileEntry  prof[4000],
+                        FILE                   *f
+                        );
+
+/* Mapa de símbols generat per mixala (opció --map). Després de la
+ * línia MIX_MAP_MAGIC hi ha un registre per cada línia del codi font:
+ *
+ *   L <línia> <adreça o -1> <text de la línia>
+ */
+#define MIX_MAP_MAGIC "MIXMAP1"
+
+/* Escriu en F el codi font del mapa MAP amb les execucions, els
+ * cicles i els salts de cada línia segons PROF, i el total al
+ * final. Torna MIX_FALSE si MAP no és un mapa vàlid o hi ha un error
+ * d'escriptura.
+ */
+MIX_Bool
+MIX_profile_write_listing (
+                           const MIX_ProfileEntry  prof[4000],
+                           FILE                   *map,
+                           FILE                   *f
+                           );
+
+/* Traça binària de l'execució. Mentre està activa la màquina usa el
+ * motor 'threaded' sense superinstruccions (o l'intèrpret si els
+ * comptadors estan activats) i escriu un registre per cada instrucció
+ * seleccionada en un buffer circular, i un fil a banda el buida en el
+ * fitxer. Si el buffer s'ompli la màquina espera, no es perden
+ * registres.
+ *
+ * El fitxer comença per MIX_TRACE_MAGIC (8 bytes amb el '\0'), un
+ * sencer de 32 bits amb la grandària de MIX_TraceRecord i un altre amb
+ * 0x01020304 per a saber l'ordre dels bytes, que és el de la màquina
+ * que l'ha generat. Després venen els registres. 'mixala/mixtrace.py'
+ * els passa a text.
+ */
+#define MIX_TRACE_MAGIC "MIXTRC1"
+
+/* Què ha canviat una instrucció. Els registres tenen el bit del seu
+ * número: A 0, I1-I6 1-6 i X 7.
+ */
+#define MIX_TRACE_A        0x0001
+#define MIX_TRACE_I(N)     (0x0001<<(N))
+#define MIX_TRACE_X        0x0080
+#define MIX_TRACE_J        0x0100
+#define MIX_TRACE_MEM      0x0200 // Paraula escrita per una instrucció ST
+#define MIX_TRACE_OVERFLOW 0x0400
+#define MIX_TRACE_CMP      0x0800
+
+/* Registre de la traça (24 bytes). Per no alentir la màquina sols es
+ * comprova el destí principal de la instrucció (el registre que
+ * carrega o modifica, J en els salts, la paraula en ST, la comparació
+ * en CMP) i l'indicador de desbordament. Els registres que canvien de
+ * passada, com X en MUL, DIV, SLAX o SRC, no apareixen en CHANGED.
+ * VALUE és el valor nou del destí principal, encara que no canvie
+ * (l'indicador de comparació val 0, 1 o 2: igual, menor o major). El
+ * desbordament sempre canvia a l'altre valor.
+ */
+typedef struct
+{
+  uint64_t clock;   // Cicle en què comença la instrucció
+  MIX_Word inst;    // Paraula de la instrucció
+  MIX_Word value;
+  uint16_t pc;
+  uint16_t addr;    // Paraula escrita (MIX_TRACE_MEM)
+  uint16_t changed; // MIX_TRACE_*
+  uint16_t cycles;  // Cicles de la instrucció
+} MIX_TraceRecord;
+
+/* Instruccions que es tracen: les de les adreces [BEGIN,END) amb un
+ * codi d'operació C que tinga el bit C de OPS a 1.
+ */
+typedef struct
+{
+  int      begin;
+  int      end;
+  uint64_t ops;
+} MIX_TraceFilter;
+
+/* Comença a traçar en el fitxer FN les instruccions que passen el
+ * filtre (totes si és NULL). Torna MIX_FALSE si ja s'està traçant o no
+ * es pot obrir el fitxer. Mentre es traça el perfil de
+ * MIX_ENGINE_PROFILE no s'actualitza. Els bucles d'espera de JBUS/JRED
+ * no s'executen una volta per cicle, per això sols generen el registre
+ * de la primera.
+ */
+MIX_Bool
+MIX_machine_trace_start (
+                         MIX_Machine           *m,
+                         const char            *fn,
+                         const MIX_TraceFilter *filter
+                         );
+
+/* Para la traça, espera que s'escriguen tots els registres i tanca el
+ * fitxer. Torna MIX_FALSE si hi ha hagut un error d'escriptura.
+ */
+MIX_Bool
+MIX_machine_trace_stop (
+                        MIX_Machine *m
+                        );
+
+/* Mostreig de la pila de subrutines. Cada PERIOD cicles simulats es
+ * guarda la pila de la instrucció que s'executa. Com MIX no té pila, es
+ * reconstruïx amb la convenció de Knuth: una subrutina comença amb STJ
+ * EXIT i acaba amb EXIT JMP *, i l'adreça de retorn està en el camp
+ * d'adreça de EXIT (o en J si encara no s'ha guardat). El codi que no
+ * està dins de cap subrutina és l'arrel de la pila. Les piles de més de
+ * 32 nivells perden els més externs. Funciona amb tots els motors, però
+ * cada mostra talla l'execució en curs: amb períodes de milers de
+ * cicles el cost no es nota. Torna MIX_FALSE si PERIOD és 0 o no hi ha
+ * memòria. Si ja s'havia mostrejat es descarten les mostres anteriors.
+ */
+MIX_Bool
+MIX_machine_sample_start (
+                          MIX_Machine        *m,
+                          const unsigned int  period
+                          );
+
+/* Para el mostreig, les mostres es conserven fins al següent
+ * MIX_machine_sample_start o MIX_machine_init.
+ */
+void
+MIX_machine_sample_stop (
+                         MIX_Machine *m
+                         );
+
+/* Escriu en F les mostres en el format plegat de 'flamegraph.pl' (una
+ * línia 'arrel;...;subrutina mostres' per pila). Si MAP és un mapa de
+ * mixala cada marc pren el nom de l'última etiqueta no local que hi ha
+ * fins a la seua adreça, si és NULL el nom és l'adreça. Torna
+ * MIX_FALSE si MAP no és un mapa vàlid, no hi ha memòria o hi ha un
+ * error d'escriptura.
+ */
+MIX_Bool
+MIX_machine_sample_write_folded (
+                                 MIX_Machine *m,
+                                 FILE        *map,
+                                 FILE        *f
+                                 );
+
+/* Cronologia de l'activitat de la CPU i els dispositius, en cicles
+ * simulats. Es registra el començament de cada IN, OUT i IOC (també la
+ * lectura de la targeta de MIX_machine_go), quan acaba, les esperes de
+ * la CPU a un dispositiu ocupat i HLT. Amb el model de temps
+ * (MIX_machine_set_device_timing) l'operació acaba quan diu el model,
+ * sense ell quan la màquina veu que el dispositiu està lliure. Si ja
+ * s'havia registrat es descarta l'anterior. Torna MIX_FALSE si no hi
+ * ha memòria.
+ */
+MIX_Bool
+MIX_machine_timeline_start (
+                            MIX_Machine *m
+                            );
+
+/* Para el registre, els esdeveniments es conserven fins al següent
+ * MIX_machine_timeline_start o MIX_machine_init.
+ */
+void
+MIX_machine_timeline_stop (
+                           MIX_Machine *m
+                           );
+
+/* Escriu en F la cronologia en el format JSON de Chrome (trace event
+ * format), que es pot obrir amb Perfetto o chrome://tracing. Hi ha una
+ * pista per a la CPU, amb les esperes i HLT, i una per cada dispositiu
+ * usat. Cada cicle és un microsegon del visor. Les operacions i les
+ * esperes que no han acabat es tallen en el cicle actual. En
+ * 'otherData' està la utilització de cada pista des de
+ * MIX_machine_timeline_start. Torna MIX_FALSE si no s'ha registrat mai
+ * o hi ha un error d'escriptura.
+ */
+MIX_Bool
+MIX_machine_timeline_write (
+                            MIX_Machine *m,
+                            FILE        *f
+                            );
+
+/* Notifica que el dispositiu DEV ha acabat una operació i pot haver
+ * deixat d'estar ocupat. Es pot cridar des de qualsevol fil, per
+ * exemple des del fil que fa les transferències.
+ */
+void
+MIX_machine_device_ready (
+                          MIX_Machine      *m,
+                          const MIX_Device  dev
+                          );
+
+/* Si la màquina està esperant un dispositiu ocupat (MIX_machine_iter
+ * consumix els cicles sense executar), bloqueja el fil fins que es
+ * notifica amb MIX_machine_device_ready que el dispositiu està
+ * preparat, o fins que passen TIMEOUT_MS milisegons (si és negatiu no
+ * hi ha límit). Torna MIX_FALSE si s'ha acabat el temps. Si la màquina
+ * no està esperant torna MIX_TRUE immediatament. Després cal tornar a
+ * cridar a MIX_machine_iter, que és qui consulta device_busy.
+ */
+MIX_Bool
+MIX_machine_wait_device (
+                         MIX_Machine *m,
+                         const int    timeout_ms
+                         );
+
+/* Motiu pel qual ha tornat MIX_run. */
+typedef enum
+  {
+    MIX_RUN_HALT= 0, // La màquina està parada
+    MIX_RUN_LIMIT,   // S'han executat els cicles demanats
+    MIX_RUN_WAIT,    // La màquina espera un dispositiu ocupat
+    MIX_RUN_STOP     // CHECK ha demanat parar la màquina
+  } MIX_RunStatus;
+
+typedef struct
+{
+  
+  MIX_RunStatus status;
+  uint64_t      cycles; // Cicles executats en esta crida
+  uint64_t      clock;  // Cicles des de MIX_machine_init
+  uint64_t      insts;  // Instruccions executades en esta crida
+  MIX_Device    dev;    // Dispositiu que s'espera (sols MIX_RUN_WAIT)
+  
+} MIX_RunResult;
+
+/* Cicles per defecte entre crides a CHECK en MIX_run. */
+#define MIX_CHECK_INTERVAL 100000
+
+/* Executa la màquina fins que es para, fins que s'han executat
+ * MAX_CYCLES cicles (pot passar-se'n uns pocs) o fins que ha
+ * d'esperar un dispositiu ocupat. A diferència de MIX_machine_iter,
+ * els cicles d'espera no es consumixen: amb MIX_RUN_WAIT es pot
+ * cridar a MIX_machine_wait_device i després tornar a cridar a
+ * MIX_run. CHECK sols es crida cada MIX_machine_set_check_interval
+ * cicles. Si RES no és NULL hi deixa el resultat, amb el rellotge de
+ * 64 bits de la màquina i les instruccions executades.
+ */
+MIX_RunStatus
+MIX_run (
+         MIX_Machine    *m,
+         const uint64_t  max_cycles,
+         MIX_RunResult  *res
+         );
+
+/* Canvia els cicles entre crides a CHECK en MIX_run (per defecte
+ * MIX_CHECK_INTERVAL).
+ */
+void
+MIX_machine_set_check_interval (
+                                MIX_Machine *m,
+                                const int    cycles
+                                );
+
+/* Latència simulada d'un dispositiu, en cicles del rellotge de la
+ * màquina. Una operació ocupa el dispositiu START cicles més WORD
+ * cicles per paraula transferida (els dispositius de caràcters
+ * transferixen 5 caràcters per paraula). En les cintes, IOC afegix
+ * BLOCK cicles per bloc saltat o rebobinat. Per exemple, amb un cicle
+ * per microsegon una lectora de 1000 targetes per minut té
+ * START+16*WORD=60000.
+ */
+typedef struct
+{
+
+  unsigned int start; // Arrencada i parada, posicionament...
+  unsigned int word;  // Per paraula transferida
+  unsigned int block; // Per bloc en IOC de cintes
+
+} MIX_DeviceTiming;
+
+/* Activa el model de temps per al dispositiu DEV (NULL el
+ * desactiva). Mentre dura la latència simulada el dispositiu està
+ * ocupat encara que el frontend ja haja acabat, i l'espera consumix
+ * cicles de la màquina, així el temps no depén del rellotge real. Si
+ * el frontend tarda més, MIX_run torna MIX_RUN_WAIT sense consumir
+ * cicles. La configuració es manté després de MIX_machine_init.
+ */
+void
+MIX_machine_set_device_timing (
+                               MIX_Machine            *m,
+                               const MIX_Device        dev,
+                               const MIX_DeviceTiming *timing
+                               );
+
+/* Planificació de les peticions als discs i tambors. */
+typedef enum
+  {
+    MIX_DISK_FIFO= 0, // Per ordre d'arribada
+    MIX_DISK_SSTF,    // La pista més pròxima al braç
+    MIX_DISK_ELEVATOR // La més pròxima en el sentit actual del braç
+  } MIX_DiskPolicy;
+
+/* Model dels discs i tambors. Les unitats 8-15 compartixen un
+ * controlador i un braç, com les superfícies d'un paquet de discs: el
+ * bloc B d'una unitat està en la pista B/BLOCKS i en el sector
+ * B%BLOCKS. Moure el braç D pistes costa SEEK+D*TRACK cicles, després
+ * s'espera a que el sector passe per davall del capçal (ROTATION
+ * cicles per volta, la posició depén del rellotge) i transferir un
+ * bloc costa ROTATION/BLOCKS cicles. Un tambor té SEEK i TRACK a 0.
+ */
+typedef struct
+{
+
+  unsigned int   blocks;   // Blocs per pista (>0)
+  unsigned int   seek;     // Arrencada i parada del braç
+  unsigned int   track;    // Per pista recorreguda
+  unsigned int   rotation; // Cicles per volta
+  MIX_DiskPolicy policy;
+
+} MIX_DiskTiming;
+
+/* Activa el model dels discs (NULL el desactiva). Amb el model actiu
+ * un IN, OUT o IOC en una unitat lliure mentre el controlador està
+ * ocupat es posa en cua, i la unitat queda ocupada fins que s'ha
+ * servit la petició. Substituïx MIX_machine_set_device_timing en les
+ * unitats 8-15. No s'ha de canviar amb peticions en curs. La
+ * configuració es manté després de MIX_machine_init.
+ */
+void
+MIX_machine_set_disk_timing (
+                             MIX_Machine          *m,
+                             const MIX_DiskTiming *timing
+                             );
+
+/* Estadístiques d'una unitat de disc des de MIX_machine_init. La
+ * profunditat mitjana de la cua és QUEUE_SUM/REQUESTS.
+ */
+typedef struct
+{
+
+  unsigned long long requests;       // IN, OUT i IOC
+  unsigned long long queue_sum;      // Peticions per davant en arribar
+  unsigned int       queue_max;
+  unsigned long long seek_tracks;    // Pistes recorregudes pel braç
+  unsigned long long wait_cycles;    // Cicles en la cua
+  unsigned long long service_cycles; // Posicionament, rotació i transferència
+
+} MIX_DiskStats;
+
+void
+MIX_machine_disk_stats (
+                        MIX_Machine      *m,
+                        const MIX_Device  dev,
+                        MIX_DiskStats    *stats
+                        );
+
+/* Igual que MIX_iter però sobre la màquina indicada. */
+int
+MIX_machine_iter (
+                  MIX_Machine *m,
+                  const int    cc,
+                  MIX_Bool    *halt
+                  );
+
+/* Igual que MIX_read_chars però sobre la màquina indicada. */
+size_t
+MIX_machine_read_chars (
+                        MIX_Machine  *m,
+                        MIX_Char     *to,
+                        size_t        nmeb,
+                        MIX_IOOPChar *op
+                        );
+
+/* Igual que MIX_write_chars però sobre la màquina indicada. */
+size_t
+MIX_machine_write_chars (
+                         MIX_Machine    *m,
+                         const MIX_Char *from,
+                         size_t          nmeb,
+                         MIX_IOOPChar   *op
+                         );
+
+/* Igual que MIX_read_words però sobre la màquina indicada. */
+size_t
+MIX_machine_read_words (
+                        MIX_Machine  *m,
+                        MIX_Word     *to,
+                        size_t        nmeb,
+                        MIX_IOOPWord *op
+                        );
+
+/* Igual que MIX_write_words però sobre la màquina indicada. */
+size_t
+MIX_machine_write_words (
+                         MIX_Machine    *m,
+                         const MIX_Word *from,
+                         size_t          nmeb,
+                         MIX_IOOPWord   *op
+                         );
+
+/* Substituts ASCII de Δ, Σ i Π en les conversions de text. Un 0
+ * indica que s'usa el caràcter en UTF-8, i amb NULL s'usa UTF-8 per
+ * als tres. mixala escriu Δ com '&' i no pot codificar Σ ni Π.
+ */
+typedef struct
+{
+
+  char delta;
+  char sigma;
+  char pi;
+
+} MIX_TextSubst;
+
+/* Bytes que pot ocupar com a molt el text de N caràcters. */
+#define MIX_TEXT_SIZE(N) (2*(N))
+
+/* Converteix N caràcters en text, sense '\0' final. Els valors 56-63
+ * es converteixen en espais. TO ha de tindre espai per a
+ * MIX_TEXT_SIZE(N) bytes. Torna els bytes escrits.
+ */
+size_t
+MIX_chars_to_text (
+                   char                *to,
+                   const MIX_Char      *from,
+                   size_t               n,
+                   const MIX_TextSubst *subst
+                   );
+
+/* Converteix com a molt LEN bytes de text en com a molt N
+ * caràcters. Para en '\n' i '\0'. Accepta majúscules, dígits,
+ * signes, Δ, Σ i Π en UTF-8 i els substituts de SUBST; la resta de
+ * caràcters es converteixen en espais. Torna els caràcters escrits i,
+ * si USED no és NULL, els bytes consumits.
+ */
+size_t
+MIX_text_to_chars (
+                   MIX_Char            *to,
+                   size_t               n,
+                   const char          *from,
+                   size_t               len,
+                   const MIX_TextSubst *subst,
+                   size_t              *used
+                   );
+
+/* Com MIX_machine_read_chars però escriu en TO el text de com a molt
+ * NMEB caràcters (MIX_TEXT_SIZE(NMEB) bytes). En LEN es torna el
+ * nombre de bytes escrits.
+ */
+size_t
+MIX_machine_read_text (
+                       MIX_Machine         *m,
+                       char                *to,
+                       size_t               nmeb,
+                       MIX_IOOPChar        *op,
+                       const MIX_TextSubst *subst,
+                       size_t              *len
+                       );
+
+/* Escriu en la memòria tot el que queda del registre de OP a partir
+ * del text FROM (vore MIX_text_to_chars). Si el text s'acaba abans,
+ * la resta s'omplin amb espais. Torna el nombre de caràcters que
+ * falten per escriure, és a dir, 0.
+ */
+size_t
+MIX_machine_write_text (
+                        MIX_Machine         *m,
+                        const char          *from,
+                        size_t               len,
+                        MIX_IOOPChar        *op,
+                        const MIX_TextSubst *subst
+                        );
+
+/* Dispositius per defecte. Implementen les funcions de i/o del
+ * frontend sobre fitxers: les cintes (0-7) i els discs (8-15) són
+ * fitxers de blocs de 100 paraules, i el lector de targetes, la
+ * perforadora, l'impresora, el terminal i la cinta de paper són
+ * fitxers de text amb un registre per línia. Per defecte les
+ * transferències es fan senceres en iniciar l'operació, per tant els
+ * dispositius mai estan ocupats (vore MIX_devices_set_workers).
+ */
+typedef struct MIX_Devices MIX_Devices;
+
+/* Crea els dispositius de la màquina M, tots sense fitxer. Torna NULL
+ * si no hi ha memòria.
+ */
+MIX_Devices *
+MIX_devices_new (
+                 MIX_Machine *m
+                 );
+
+/* Tanca els fitxers i allibera els dispositius. */
+void
+MIX_devices_free (
+                  MIX_Devices *d
+                  );
+
+/* Associa el fitxer FN al dispositiu DEV ("-" és l'entrada o
+ * l'eixida estàndard). Les cintes i els discs s'obrin per a llegir i
+ * escriure, i es creen si no existixen. TYPE sols s'usa amb el
+ * terminal i la cinta de paper, que poden tindre un fitxer d'entrada
+ * i un altre d'eixida. Torna MIX_FALSE si no s'ha pogut obrir.
+ */
+MIX_Bool
+MIX_devices_open (
+                  MIX_Devices      *d,
+                  const MIX_Device  dev,
+                  const char       *fn,
+                  const MIX_OPType  type
+                  );
+
+/* Associa al dispositiu DEV (una cinta o un disc) la imatge FN, que es
+ * projecta en memòria. Si FN no existix, o és un fitxer buit, es crea
+ * una imatge buida; si té un altre contingut que no és una imatge es
+ * rebutja sense modificar-lo. Una imatge és una capçalera de 24 bytes
+ * (el text "MIXIMG1" acabat en 0, el sencer de 32 bits 0x01020304, 4
+ * bytes reservats i el nombre de paraules escrites en 64 bits) seguida
+ * de les paraules en el format de MIX_Word, tot en l'ordre de bytes de
+ * la màquina. Els blocs es copien directament entre la imatge i la
+ * memòria de la MIX. Torna MIX_FALSE si no s'ha pogut obrir o no és
+ * una imatge vàlida.
+ */
+MIX_Bool
+MIX_devices_open_image (
+                        MIX_Devices      *d,
+                        const MIX_Device  dev,
+                        const char       *fn
+                        );
+
+/* Fa que les operacions amb fitxers (no les imatges) les facen N
+ * fils de treball, de manera que la màquina continua executant
+ * mentre el dispositiu està ocupat. Quan acaba una operació es crida
+ * a MIX_machine_device_ready. Amb N=0 (per defecte) es fan en el fil
+ * de la màquina. Torna MIX_FALSE si N no és vàlid o no s'han pogut
+ * crear els fils.
+ */
+MIX_Bool
+MIX_devices_set_workers (
+                         MIX_Devices *d,
+                         const int    n
+                         );
+
+/* Espera que acaben totes les operacions en curs i copia en la
+ * memòria les dades llegides. Normalment no cal, la còpia es fa quan
+ * la màquina consulta si el dispositiu està ocupat, però és útil per
+ * a inspeccionar la memòria després de parar la màquina.
+ */
+void
+MIX_devices_sync (
+                  MIX_Devices *d
+                  );
+
+/* Ompli FE amb les funcions dels dispositius. Cal passar D com a
+ * 'udata' a MIX_machine_init.
+ */
+void
+MIX_devices_frontend (
+                      MIX_Devices  *d,
+                      MIX_Frontend *fe
+                      );
+
+/* Les funcions següents treballen sobre una màquina per defecte
+ * interna a la llibreria. Es mantenen per compatibilitat, no són
+ * segures si s'usen des de més d'un fil.
+ */
+
 /* Llig la targeta del lector de targetes en la posició 0, fixa J=0 i
  * PC=0. És lo més paregut a un reset. S'ha de cridar amb la màquina
  * apagada.
@@ -22,13 +22,31 @@
  */
 
 
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "MIX.h"
 
+#if defined(__x86_64__) && defined(__linux__) && !defined(MIX_NO_JIT)
+#define JIT_X86_64
+#include <sys/mman.h>
+#endif
+
+#if defined(__SSE2__) && !defined(MIX_NO_SIMD)
+#define SIMD_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__SSSE3__) && !defined(MIX_NO_SIMD)
+#define SIMD_SSSE3
+#include <tmmintrin.h>
+#endif
+
 
 
 
@@ -44,9 +62,7 @@
 
 #define IMASK 0x80000FFF
 
-#define READ_F ((_vars.inst>>6)&0x3F)
-
-#define READ_I ((_vars.inst>>12)&0x3F)
+#define READ_F (m->vars.d->F)
 
 #define IS_NEG(DATA) ((DATA)&NMASK)
 
@@ -54,11 +70,11 @@
   (VAR)= ((DATA)>>18)&0xFFF;           \
   if ( IS_NEG ( DATA ) ) (VAR)= -(VAR)
 
-#define GET_DATA _mem[_vars.M]
+#define GET_DATA m->mem[m->vars.M]
 
-#define LDI (ld()&IMASK)
+#define LDI (ld ( m )&IMASK)
 
-#define LDN (ld()^NMASK)
+#define LDN (ld ( m )^NMASK)
 
 #define LDIN (LDN&IMASK)
 
@@ -67,32 +83,30 @@
     (WORD)= -((WORD)&INMASK)
 
 #define CALC_OP2(OP2)        \
-  calc_LR ();        	\
-  calc_M ();                \
-  (OP2)= (MIXs32) ld ()
+  (OP2)= (MIXs32) ld ( m )
 
 #define CALC_OP1_OP2(OP1,OP2) \
   CALC_OP2 ( OP2 );              \
   WORDTOS32 ( OP2 );              \
-  (OP1)= (MIXs32) _regs.A;    \
+  (OP1)= (MIXs32) m->regs.A;    \
   WORDTOS32 ( (OP1) )
 
 #define ADD_(OP,OP1,OP2)              \
   CALC_OP1_OP2 ( OP1, OP2 );              \
   (OP1) OP (OP2);        	      \
-  _regs.A= add_aux ( _regs.A, (OP1) )
+  m->regs.A= add_aux ( m, m->regs.A, (OP1) )
 
 #define ABS(S32) ((S32)&INMASK)
 
-#define MOPI(REG) (mop ( (REG) )&IMASK)
+#define MOPI(REG) (mop ( m, (REG), READ_F )&IMASK)
 
 
 #define CHECK_DEV_BASE(DEV,BASE)        	     \
   if ( (DEV) > 20 )                                  \
     {                                                \
-      _warning ( _udata,                             \
-        	 "número de dispositiu invàlid: %d", \
-        	 (DEV) );			     \
+      WARNING ( MIX_WARN_DEVICE,                     \
+        	"número de dispositiu invàlid: %d",    \
+        	(DEV) );        			     \
       BASE;                                          \
     }
 
@@ -100,16 +114,173 @@
 #define CHECK_DEV(DEV) CHECK_DEV_BASE ( DEV, return )
 
 
+/* Grandària d'una línia de cache. */
+#define CACHE_LINE 64
+
+
+/* Marques de 'code'. */
+#define CODE_DECODED 0x01
+#define CODE_THREADED 0x02
+#define CODE_JIT 0x04
+#define CODE_AOT 0x08
+#define CODE_FUSED 0x10 // Forma part d'una superinstrucció (no la primera)
+#define CODE_SNAP 0x20  // La pàgina no s'ha escrit des de l'última còpia
+#define CODE_TRACE 0x40 // S'ha aplicat el filtre de la traça
+#define CODE_SAMPLE 0x80 // S'ha buscat la subrutina de l'adreça
+
+/* Marques de 'code' que no indiquen que la paraula s'ha descodificat
+   per a executar-la. */
+#define CODE_MARKS (CODE_SNAP|CODE_TRACE|CODE_SAMPLE)
+
+
+/* Registres del buffer de la traça (potència de 2) i cada quants
+   registres es publiquen per al fil que els escriu. */
+#define TRACE_SIZE (1<<16)
+#define TRACE_PUBLISH 256
+
+
+/* Què escriu cada instrucció traçada. Els registres es representen
+   pel seu número (A 0, I1-I6 1-6, X 7), la resta pel bit de
+   MIX_TRACE_* que els correspon. */
+#define TRACE_J 8
+#define TRACE_MEM 9
+#define TRACE_CMP 11
+#define TRACE_NONE 12
+#define TRACE_OFF 0xFF // No es traça
+
+
+/* Mostreig: marcs de pila que es guarden per mostra i marca dels
+   marcs que són codi fora de qualsevol subrutina (vore sample_take). */
+#define SAMPLE_DEPTH 32
+#define SAMPLE_ROOT 0x8000
+
+
+/* Pàgines de memòria per al seguiment de MIX_machine_fork. */
+#define PAGE_BITS 6
+#define PAGE_SIZE (1<<PAGE_BITS)
+#define NPAGES ((4000+PAGE_SIZE-1)/PAGE_SIZE)
+
+
+/* El motor 'threaded' necessita etiquetes com a valors (GCC/Clang). */
+#if defined(__GNUC__) && !defined(MIX_NO_THREADED_DISPATCH)
+#define THREADED_DISPATCH
+#endif
+
+
+/* Acceleració dels bucles comptats en el motor 'threaded'. Es pot
+   desactivar definint MIX_NO_LOOP_ACCEL. */
+#if defined(THREADED_DISPATCH) && !defined(MIX_NO_LOOP_ACCEL)
+#define LOOP_ACCEL
+#endif
+
+
+/* Estat dels blocs del motor AOT. */
+#define AOT_UNKNOWN 0
+#define AOT_OK 1
+#define AOT_DIFF 2
+
+
+/* Número màxim de blocs traduïts pel JIT. */
+#define JIT_MAX_BLOCKS 4096
+
+
+/* Cal cridar-la cada vegada que es modifica una paraula de
+ * memòria. Invalida la informació precalculada a partir del contingut
+ * anterior de la paraula.
+ */
+#define MEM_WRITTEN(ADDR)        		\
+  if ( m->code[(ADDR)] ) invalidate ( m, (ADDR) )
+
+/* Igual que MEM_WRITTEN per a les escriptures de ST i MOVE, que a més
+ * es compten com a codi automodificat si la paraula s'havia
+ * descodificat.
+ */
+#define ST_WRITTEN(ADDR)        				\
+  if ( m->code[(ADDR)] )        				\
+    {        							\
+      if ( m->code[(ADDR)]&~CODE_MARKS ) ++m->ctr.smc;        	\
+      invalidate ( m, (ADDR) );        				\
+    }
+
+/* Mostra un avís de tipus KIND (MIX_WARN_*). */
+#define WARNING(KIND,...)        				\
+  do {        							\
+    ++m->ctr.warnings[(KIND)];        				\
+    m->warning ( m->udata, __VA_ARGS__ );        		\
+  } while ( 0 )
+
+
 
 
 /*********/
-/* ESTAT */
+/* TIPUS */
 /*********/
 
+/* Inidicadors d'estat. */
+typedef enum {
+  OFF= 0,
+  ON
+} overflow_t;
+typedef enum {
+  EQUAL= 0,
+  LESS,
+  GREATER
+} cmp_t;
+
+
+/* Instrucció descodificada. Conté els camps de la instrucció ja
+ * extrets i validats, de manera que no cal tornar a calcular-los cada
+ * vegada que s'executa.
+ */
+typedef struct decoded decoded_t;
+struct decoded
+{
+  
+  unsigned int (*op) (MIX_Machine *); // Implementació de la instrucció
+  MIXu32 inst;       // Paraula original
+  int    addr;       // Adreça amb signe (sense sumar l'índex)
+  int    I;          // Registre índex (0 sense índex)
+  int    F;
+  bool   bad_I;      // I era major que 6, s'usa 6
+  bool   bad_F;      // F no és un camp (L:R) vàlid, s'usa (0:5)
+  bool   sign;       // El camp (L:R) inclou el signe
+  int    shift;      // Desplaçament del byte R a la posició 5
+  MIXu32 mask;       // Màscara dels bytes de (L:R) ja desplaçats
+#ifdef THREADED_DISPATCH
+  const void *label; // Etiqueta en run_threaded
+  bool        loop;  // La superinstrucció és un bucle comptat
+#endif
+  
+};
+
+
+#ifdef JIT_X86_64
+/* Bloc traduït pel JIT. Conté les adreces [start,end) marcades amb
+   CODE_JIT. */
+typedef struct
+{
+  int start;
+  int end;
+} jit_block_t;
+#endif
+
+
+/* Estats del simulador. */
+typedef enum
+  {
+   RUNNING,
+   HALT,
+   WAIT_DEVICE,
+   RUNNING_GO_STEP0,
+   RUNNING_GO_STEP1
+  } run_state_t;
+
+
 /* Registres. El bit més alt s'empra per al signe, els 30 bits amb
-   menys pes per als bytes. El byte 5 es correspon amb els 6 bts de
-   menys pes. */
-static struct
+ * menys pes per als bytes. El byte 5 es correspon amb els 6 bts de
+ * menys pes.
+ */
+typedef struct
 {
   
   MIXu32 A;
@@ -119,71 +290,368 @@ static struct
   int  PC;
   int  old_PC;
   
-} _regs;
+} regs_t;
 
 
-/* Variables auxiliars. */
-static struct
+/* Estat del simulador. */
+typedef struct
 {
-  
-  MIXu32 inst;
-  int    L;
-  int    R;
-  int    M;
+  run_state_t v;
+  int dev; // Utilitzat amb WAIT_DEVICE
+  MIX_Bool busy; // S'espera mentre device_busy torna este valor
+  int spin; // Adreça del JMP d'un bucle d'espera de dos instruccions
+            // (-1 si no n'hi ha)
+  bool spinning; // L'espera ve d'un bucle d'espera
+  bool notify_cr;
+} state_t;
 
-} _vars;
 
+/* Model de temps dels dispositius (MIX_machine_set_device_timing).
+ * Les operacions en curs es guarden en una cua de prioritat ordenada
+ * pel cicle en què acaben. El cicle actual és base+budget-left: 'base'
+ * i 'budget' els fixa run abans de cada estat i els motors actualitzen
+ * 'left' abans d'executar una instrucció d'entrada/eixida.
+ */
+typedef struct
+{
+  bool             on;
+  bool             has[21];
+  MIX_DeviceTiming timing[21];
+  bool             busy[21];
+  uint64_t         until[21];
+  long             pos[8];  // Bloc actual de cada cinta
+  struct
+  {
+    uint64_t t;
+    int      dev;
+  }                heap[21];
+  int              n;
+  uint64_t         base;
+  int              budget;
+  int              left;
+  
+  /* Controlador dels discs (MIX_machine_set_disk_timing). Mentre
+     'active' és cert hi ha una petició en la cua de prioritat; la
+     resta esperen en 'queue'. Les unitats en cua tenen 'until' a
+     UINT64_MAX. */
+  struct
+  {
+    bool           on;
+    MIX_DiskTiming timing;
+    bool           active;
+    long           track; // Pista del braç
+    int            dir;   // Sentit de l'ascensor (1 o -1)
+    struct
+    {
+      int      dev;
+      long     block;
+      bool     seek;      // IOC
+      uint64_t t;         // Cicle d'arribada
+    }              queue[8];
+    int            nqueue;
+    MIX_DiskStats  stats[8];
+  } disk;
+} sched_t;
+
+
+/* Traça en curs (MIX_machine_trace_start). El fil de la màquina posa
+ * els registres en 'buf' i publica 'head', el fil 'thread' els escriu
+ * i avança 'tail'. Cadascú sols modifica el seu índex, així que no
+ * calen bloquejos.
+ */
+typedef struct
+{
+  int             begin;     // Filtre
+  int             end;
+  uint64_t        ops;
+  uint8_t         sel[4000]; // TRACE_* de cada adreça (vàlid amb CODE_TRACE)
+#ifdef THREADED_DISPATCH
+  const void     *label[4000]; // Etiqueta de run_threaded (amb CODE_THREADED)
+#endif
+  MIXu32         *regs[9];   // Registres pel seu número, i J
+  size_t          whead;     // Següent registre a escriure (productor)
+  size_t          wtail;     // Últim 'tail' llegit pel productor
+  _Alignas(CACHE_LINE) atomic_size_t head;
+  _Alignas(CACHE_LINE) atomic_size_t tail;
+  atomic_bool     stop;
+  bool            error;
+  FILE           *f;
+  pthread_t       thread;
+  MIX_TraceRecord buf[TRACE_SIZE];
+} trace_t;
+
+
+/* Pila mostrejada. FRAMES comença per l'arrel, DEPTH 0 indica una
+ * entrada lliure de la taula.
+ */
+typedef struct
+{
+  unsigned long long count;
+  int                depth;
+  uint16_t           frames[SAMPLE_DEPTH];
+} sample_stack_t;
 
-/* Memòria. */
-static MIXu32 _mem[4000];
 
+/* Mostreig en curs (MIX_machine_sample_start). Les piles es guarden
+ * en una taula de dispersió amb adreçament obert que creix quan està
+ * mig plena. 'entry' és la subrutina de cada adreça, -1 si no n'hi ha
+ * (vàlid amb CODE_SAMPLE).
+ */
+typedef struct
+{
+  bool            on;
+  uint64_t        period;
+  uint64_t        next;      // Cicle de la següent mostra
+  int16_t         entry[4000];
+  size_t          size;      // Potència de 2
+  size_t          n;
+  sample_stack_t *v;
+} sampler_t;
+
+
+/* Esdeveniments de la cronologia (MIX_machine_timeline_start). */
+enum {
+  TL_IN= 0,
+  TL_OUT,
+  TL_IOC,
+  TL_DONE,   // Acaba l'operació del dispositiu
+  TL_WAIT,   // La CPU espera el dispositiu
+  TL_RUN,    // La CPU deixa d'esperar
+  TL_HALT
+};
 
-/* Inidicadors d'estat. */
-static enum {
-  OFF= 0,
-  ON
-} _overflow;
-static enum {
-  EQUAL= 0,
-  LESS,
-  GREATER
-} _cmp;
+typedef struct
+{
+  uint64_t t;
+  uint8_t  kind;   // TL_*
+  uint8_t  dev;
+  int16_t  M;
+  int32_t  block;  // Sols en les unitats de disc
+} tl_event_t;
+
+
+/* Cronologia en curs. 'open' i 'start' són l'operació de cada
+ * dispositiu que encara no ha acabat, 'state' l'últim estat de la CPU
+ * que s'ha vist.
+ */
+typedef struct
+{
+  bool        on;
+  bool        lost;      // No hi ha hagut memòria per a algun esdeveniment
+  run_state_t state;
+  uint64_t    t0;        // Cicle en què es va començar
+  bool        open[21];
+  uint64_t    start[21];
+  size_t      size;
+  size_t      n;
+  tl_event_t *v;
+} timeline_t;
+
+
+/* Comptadors de rendiment (MIX_machine_counters). Els cicles es
+ * guarden per codi C i s'agrupen per classes en consultar-los.
+ */
+typedef struct
+{
+  unsigned long long ops[64];
+  unsigned long long ops_f[3][64]; // C=5, 6 i 39
+  unsigned long long cycles[64];
+  unsigned long long untracked;
+  unsigned long long wait[21];
+  unsigned long long go_steps;
+  unsigned long long warnings[MIX_WARN_NUM];
+  unsigned long long smc;
+} counters_t;
+
+
+/* Tot l'estat d'una màquina MIX. L'estat que es consulta en cada
+ * instrucció (registres, variables auxiliars i indicadors) es manté
+ * junt al principi i alineat a una línia de cache, de manera que
+ * màquines executant-se en fils diferents no compartixen línies.
+ */
+struct MIX_Machine
+{
 
+  /* Registres. */
+  _Alignas(CACHE_LINE) regs_t regs;
+
+  /* Variables auxiliars. */
+  struct
+  {
+    
+    const decoded_t *d; // Instrucció en execució
+    int              M;
+    
+  } vars;
+
+  /* Inidicadors d'estat. */
+  overflow_t overflow;
+  cmp_t      cmp;
+
+  /* Memòria. */
+  _Alignas(CACHE_LINE) MIXu32 mem[4000];
+
+  /* Instruccions descodificades. S'omplin conforme s'executen i
+     s'invaliden quan s'escriu en la paraula corresponent. 'code'
+     indica per a cada adreça quina informació precalculada existix
+     (CODE_*). */
+  decoded_t dec[4000];
+  uint8_t   code[4000];
+
+  // Controla l'estat del simulador.
+  state_t run_state;
+
+  /* Descriptors de les operacions de i/o en curs. */
+  MIX_IOOPChar ioopchars[21];
+  MIX_IOOPWord ioopwords[21];
+  MIX_IOOPChar go_ioop; // Operació inicial
+  
+  /* Avísos. */
+  MIX_Warning *warning;
+
+  /* I/O. */
+  MIX_InitIOOPChar *init_ioopchar;
+  MIX_InitIOOPWord *init_ioopword;
+  MIX_DeviceBusy *device_busy;
+  MIX_IOControl *io_control;
+  MIX_NotifyWaitingDevice *notify_waiting_device;
+
+  /* Dades d'usuari. */
+  void *udata;
+
+  /* Tractament de senyals. */
+  MIX_CheckSignals *check;
+
+  /* Vegades que s'ha executat cada superinstrucció. */
+  unsigned long long fusion_hits[MIX_FUSION_NUM];
+
+  /* Comptadors de rendiment. Els de cada instrucció (ops, ops_f,
+     cycles i untracked) sols es porten amb 'counting'. */
+  counters_t ctr;
+  bool       counting;
+
+  /* Perfil d'execució (MIX_ENGINE_PROFILE). 'v' es reserva la primera
+     vegada que se selecciona el motor i es manté encara que es canvie
+     de motor. */
+  struct
+  {
+    bool              on;
+    MIX_ProfileEntry *v;
+  } prof;
+
+  /* Traça en curs, NULL si no se'n fa. */
+  trace_t *trace;
+
+  /* Mostreig. NULL si no s'ha començat mai, es manté després de
+     parar-lo per a poder escriure les piles. */
+  sampler_t *sample;
+
+  /* Cronologia de la CPU i els dispositius. NULL si no s'ha començat
+     mai, es manté després de parar-la. */
+  timeline_t *timeline;
+
+  /* Comptadors des de MIX_machine_init: cicles consumits (inclosos els
+     d'espera) i instruccions executades. */
+  uint64_t clock;
+  uint64_t insts;
+  int      check_interval; // Cicles entre crides a check en MIX_run
+
+  /* Model de temps dels dispositius (MIX_machine_set_device_timing). */
+  sched_t sched;
+
+  /* Notificacions de MIX_machine_device_ready. Es poden rebre des
+     d'altres fils, per això estan protegides per 'lock'. */
+  struct
+  {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    unsigned int    ready; // Un bit per dispositiu
+  } events;
+
+#ifdef JIT_X86_64
+  /* Motor JIT. 'buf' és NULL si la màquina usa l'intèrpret. */
+  struct
+  {
+    uint8_t       *buf;        // Codi natiu
+    size_t         used;
+    size_t         stubs_size; // Codi d'entrada i eixida
+    int          (*enter) (MIX_Machine *, const void *);
+    const uint8_t *exit;
+    const void    *exit0;      // Eixida per a les adreces sense traduir
+    int            cc;         // Cicles que queden per executar
+    int            written;    // Adreça amb informació precalculada
+        		       // modificada pel codi natiu (-1 cap)
+    bool           killed;     // S'ha invalidat algun bloc
+    const void    *entry[4000];
+    uint16_t       count[4000];
+    jit_block_t    blocks[JIT_MAX_BLOCKS];
+    int            nblocks;
+  } jit;
+#endif
 
-/* Avísos. */
-static MIX_Warning *_warning;
+  /* Motor AOT. Les adreces dels blocs del mòdul ja comparats amb la
+     imatge es marquen amb CODE_AOT, i escriure en elles torna a
+     comparar el bloc. */
+  struct
+  {
+    const MIX_AOTModule *mod;
+    bool                 on;        // S'usa el motor AOT
+    uint8_t              ok[4000];  // AOT_* per a cada inici de bloc
+    MIX_AOTState         s;
+  } aot;
+
+  /* Pàgines escrites des de l'última vegada que la màquina es va
+     copiar a 'base' o es va restaurar des de 'base'. Les adreces de
+     les pàgines no escrites tenen CODE_SNAP, de manera que la primera
+     escriptura en cada pàgina passa per invalidate. */
+  struct
+  {
+    const MIX_Snapshot *base;
+    uint64_t            gen;   // 'gen' de 'base' en eixe moment
+    uint64_t            dirty; // Un bit per pàgina
+  } snap;
+  
+  
+};
 
 
-/* I/O. */
-static MIX_InitIOOPChar *_init_ioopchar;
-static MIX_InitIOOPWord *_init_ioopword;
-static MIX_DeviceBusy *_device_busy;
-static MIX_IOControl *_io_control;
-static MIX_NotifyWaitingDevice *_notify_waiting_device;
+/* Còpia de l'estat d'una màquina (MIX_machine_snapshot). */
+struct MIX_Snapshot
+{
+  
+  uint64_t           gen; // Distinguix cada còpia feta
+  regs_t             regs;
+  int                M;
+  overflow_t         overflow;
+  cmp_t              cmp;
+  state_t            run_state;
+  MIX_IOOPChar       ioopchars[21];
+  MIX_IOOPWord       ioopwords[21];
+  MIX_IOOPChar       go_ioop;
+  unsigned long long fusion_hits[MIX_FUSION_NUM];
+  uint64_t           clock;
+  uint64_t           insts;
+  sched_t            sched;
+  _Alignas(CACHE_LINE) MIXu32 mem[4000];
+  
+};
 
 
-/* Dades d'usuari. */
-static void *_udata;
 
 
-/* Tractament de senyals. */
-static MIX_CheckSignals *_check;
+/*********/
+/* ESTAT */
+/*********/
 
+/* Màquina per defecte, utilitzada per la interfície sense màquina
+   explícita. */
+static MIX_Machine _default=
+  {
+    .events= { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, 0 }
+  };
 
-// Controla l'estat del simulador.
-static struct
-{
-  enum
-    {
-     RUNNING,
-     HALT,
-     WAIT_DEVICE,
-     RUNNING_GO_STEP0,
-     RUNNING_GO_STEP1
-    } v;
-  int dev; // Utilitzat amb WAIT_DEVICE
-  bool notify_cr;
-} _run_state;
+/* Última còpia feta per MIX_machine_snapshot. */
+static atomic_uint_fast64_t _snap_gen= 0;
 
 
 
@@ -192,92 +660,141 @@ static struct
 /* FUNCIONS PRIVADES */
 /*********************/
 
+#ifdef JIT_X86_64
+static void
+jit_invalidate (
+        	MIX_Machine *m,
+        	const int    addr
+        	);
+#endif
+
+
+/* Marca com a escrita la pàgina de ADDR. */
+static void
+snap_dirty (
+            MIX_Machine *m,
+            const int    addr
+            )
+{
+  
+  int p, a, end;
+  
+  
+  p= addr>>PAGE_BITS;
+  m->snap.dirty|= ((uint64_t) 1)<<p;
+  end= (p+1)*PAGE_SIZE; if ( end > 4000 ) end= 4000;
+  for ( a= p*PAGE_SIZE; a < end; ++a )
+    m->code[a]&= ~CODE_SNAP;
+  
+} /* end snap_dirty */
+
+
+static void
+invalidate (
+            MIX_Machine *m,
+            int          addr
+            )
+{
+  
+  if ( m->code[addr]&CODE_SNAP )
+    snap_dirty ( m, addr );
+#ifdef JIT_X86_64
+  if ( m->code[addr]&CODE_JIT )
+    jit_invalidate ( m, addr );
+#endif
+  if ( m->code[addr]&CODE_AOT )
+    m->aot.ok[m->aot.mod->owner[addr]]= AOT_UNKNOWN;
+  if ( m->code[addr]&CODE_FUSED )
+    {
+      m->code[addr-1]&= ~CODE_THREADED;
+      if ( addr >= 2 ) m->code[addr-2]&= ~CODE_THREADED;
+    }
+  m->code[addr]= 0;
+  
+} /* end invalidate */
+
+
 static void
-calc_LR ()
+calc_LR (
+         MIX_Machine *m
+         )
 {
   
   int F;
   
   
-  F= READ_F;
-  _vars.L= F>>3;
-  _vars.R= F&0x7;
-  if ( _vars.L > 5 || _vars.R > 5 || _vars.L > _vars.R )
+  if ( m->vars.d->bad_F )
     {
-      _warning ( _udata,
-        	 "valor de F invàlid: 8*L[%d]+R[%d] = F[%d]",
-        	 _vars.L, _vars.R, F );
-      _vars.L= 0; _vars.R= 5;
+      F= READ_F;
+      WARNING ( MIX_WARN_FIELD,
+                "valor de F invàlid: 8*L[%d]+R[%d] = F[%d]",
+                F>>3, F&0x7, F );
     }
   
 } /* end calc_LR */
 
 
 static void
-calc_M_val ()
+calc_M_val (
+            MIX_Machine *m
+            )
 {
   
-  int I, aux;
+  const decoded_t *d;
+  int aux;
   MIXu32 value;
   
   
-  I= READ_I;
-  if ( I > 6 )
+  d= m->vars.d;
+  if ( d->bad_I )
+    WARNING ( MIX_WARN_INDEX,
+              "valor de I invàlid: %d",
+              (d->inst>>12)&0x3F );
+  m->vars.M= d->addr;
+  if ( d->I != 0 )
     {
-      _warning ( _udata,
-        	 "valor de I invàlid: %d",
-        	 I );
-      I= 6;
-    }
-  CALC_ADDR ( _vars.inst, _vars.M );
-  if ( I != 0 )
-    {
-      value= _regs.I[I-1];
+      value= m->regs.I[d->I-1];
       aux= value&0xFFF;
       if ( IS_NEG ( value ) )
         aux= -aux;
-      _vars.M+= aux;
+      m->vars.M+= aux;
     }
   
 } /* end calc_M_val */
 
 
 static void
-calc_M ()
+calc_M (
+        MIX_Machine *m
+        )
 {
   
-  calc_M_val ();
-  if ( _vars.M < 0 || _vars.M > 3999 )
+  calc_M_val ( m );
+  if ( m->vars.M < 0 || m->vars.M > 3999 )
     {
-      _warning ( _udata, "valor de M invàlid: %d", _vars.M );
-      _vars.M= 3999;
+      WARNING ( MIX_WARN_ADDRESS, "valor de M invàlid: %d", m->vars.M );
+      m->vars.M= 3999;
     }
   
 } /* end calc_M */
 
 
 static MIXu32
-ld ()
+ld (
+    MIX_Machine *m
+    )
 {
   
-  MIXu32 ret, data, mask;
+  const decoded_t *d;
+  MIXu32 ret, data;
   
   
-  calc_LR ();
-  calc_M ();
+  calc_LR ( m );
+  calc_M ( m );
+  d= m->vars.d;
   data= GET_DATA;
-  ret= 0;
-  if ( _vars.L == 0 )
-    {
-      ret|= data&NMASK;
-      _vars.L= 1;
-    }
-  if ( _vars.R != 0 )
-    {
-      data>>= 6*(5-_vars.R);
-      mask= 0xFFFFFFFF<<(6*(_vars.R-_vars.L+1));
-      ret|= ((~mask)&data);
-    }
+  ret= d->sign ? data&NMASK : 0;
+  ret|= (data>>d->shift)&d->mask;
   
   return ret;
   
@@ -286,37 +803,35 @@ ld ()
 
 static void
 st (
+    MIX_Machine *m,
     MIXu32 value
     )
 {
   
+  const decoded_t *d;
   MIXu32 data, mask;
   
   
-  calc_LR ();
-  calc_M ();
+  calc_LR ( m );
+  calc_M ( m );
+  d= m->vars.d;
   data= GET_DATA;
-  if ( _vars.L == 0 )
+  if ( d->sign )
     {
       data&= INMASK;
       data|= value&NMASK;
-      _vars.L= 1;
     }
-  if ( _vars.R != 0 )
-    {
-      mask=
-        (INMASK>>(6*(_vars.L-1))) &
-        (INMASK<<(6*(5-_vars.R)));
-      value<<= 6*(5-_vars.R);
-      data= (data&(~mask)) | (value&mask);
-    }
-  _mem[_vars.M]= data;
+  mask= d->mask<<d->shift;
+  data= (data&(~mask)) | ((value<<d->shift)&mask);
+  m->mem[m->vars.M]= data;
+  ST_WRITTEN ( m->vars.M );
   
 } /* end st */
 
 
 static MIXu32
 add_aux (
+         MIX_Machine *m,
          MIXu32 reg,
          MIXs32 val
          )
@@ -332,7 +847,7 @@ add_aux (
           val= -val;
         }
       else reg= 0;
-      if ( val&0xC0000000 ) _overflow= ON;
+      if ( val&0xC0000000 ) m->overflow= ON;
       reg|= ((MIXu32) val)&INMASK;
     }
   
@@ -341,53 +856,53 @@ add_aux (
 } /* end add_aux */
 
 
-static MIXu32
+static inline MIXu32
 mop (
-     MIXu32 reg
+     MIX_Machine *m,
+     MIXu32 reg,
+     const int F
      )
 {
   
-  int F;
   MIXs32 op;
   
   
-  F= READ_F;
-  calc_M_val ();
+  calc_M_val ( m );
   
   /* IN i DE. */
   if ( F < 2 )
     {
       op= (MIXs32) reg;
       WORDTOS32 ( op );
-      reg= add_aux ( reg, op + (MIXs32) (F?-_vars.M:_vars.M) );
+      reg= add_aux ( m, reg, op + (MIXs32) (F?-m->vars.M:m->vars.M) );
     }
   
   /* EN i ENN. */
   else if ( F < 4 )
     {
-      if ( _vars.M == 0 )
+      if ( m->vars.M == 0 )
         {
-          reg= _vars.inst&NMASK;
+          reg= m->vars.d->inst&NMASK;
           if ( F == 3 ) reg^= NMASK;
         }
       else
         {
-          if ( _vars.M < 0 )
+          if ( m->vars.M < 0 )
             {
-              _vars.M= -_vars.M;
+              m->vars.M= -m->vars.M;
               reg= NMASK;
             }
           else reg= 0;
           if ( F == 3 ) reg^= NMASK;
-          reg|= (MIXu32) _vars.M;
+          reg|= (MIXu32) m->vars.M;
         }
     }
   
   else
     {
       reg= 0;
-      _warning ( _udata, "operació C=%d F=%d no vàlida",
-        	 _vars.inst&0x3F, F );
+      WARNING ( MIX_WARN_OP, "operació C=%d F=%d no vàlida",
+                m->vars.d->inst&0x3F, F );
     }
   
   return reg;
@@ -397,59 +912,52 @@ mop (
 
 static void
 cmp (
+     MIX_Machine *m,
      MIXu32 value
      )
 {
   
-  MIXu32 data, mask;
+  const decoded_t *d;
+  MIXu32 data;
   MIXs32 op1, op2;
-  MIX_Bool sign;
-  int desp;
   
   
-  calc_LR ();
-  calc_M ();
+  calc_LR ( m );
+  calc_M ( m );
+  d= m->vars.d;
   data= GET_DATA;
-  if ( _vars.L == 0 )
-    {
-      sign= MIX_TRUE;
-      _vars.L= 1;
-    }
-  else sign= MIX_FALSE;
-  if ( _vars.R != 0 )
+  if ( d->mask != 0 )
     {
-      mask= ~(0xFFFFFFFF<<(6*(_vars.R-_vars.L+1)));
-      desp= 6*(5-_vars.R);
-      op1= (value>>desp)&mask;
-      op2= (data>>desp)&mask;
-      if ( sign )
+      op1= (value>>d->shift)&d->mask;
+      op2= (data>>d->shift)&d->mask;
+      if ( d->sign )
         {
           if ( value&NMASK ) op1= -op1;
           if ( data&NMASK ) op2= -op2;
         }
-      if ( op1 == op2 ) _cmp= EQUAL;
-      else if ( op1 < op2 ) _cmp= LESS;
-      else _cmp= GREATER;
+      if ( op1 == op2 ) m->cmp= EQUAL;
+      else if ( op1 < op2 ) m->cmp= LESS;
+      else m->cmp= GREATER;
     }
-  else _cmp= EQUAL;
+  else m->cmp= EQUAL;
   
 } /* end cmp */
 
 
-static void
+static inline void
 jreg (
-      MIXu32 reg
+      MIX_Machine *m,
+      MIXu32 reg,
+      const int F
       )
 {
   
   MIXs32 op;
   MIX_Bool jump;
-  int F;
   
   
   op= (MIXs32) reg;
   WORDTOS32 ( op );
-  F= READ_F;
   switch ( F )
     {
       
@@ -473,1227 +981,7379 @@ jreg (
       
     default:
       jump= MIX_FALSE;
-      _warning ( _udata, "operació C=%d F=%d no vàlida",
-                 _vars.inst&0x3F, F );
+      WARNING ( MIX_WARN_OP, "operació C=%d F=%d no vàlida",
+                m->vars.d->inst&0x3F, F );
       
     }
   
   if ( jump )
     {
-      _regs.J= _regs.PC;
-      calc_M ();
-      _regs.PC= _vars.M;
+      m->regs.J= m->regs.PC;
+      calc_M ( m );
+      m->regs.PC= m->vars.M;
     }
   
 } /* end jreg */
 
 
-static void
-inout (
-       MIX_OPType op
-       )
+/* Fixa el cicle en què comença l'estat actual de run. */
+static inline void
+sched_at (
+          MIX_Machine *m,
+          const int    cc_total,
+          const int    cc_remain
+          )
 {
-  
-  int dev;
-  MIX_IOOPChar *ioop;
-  MIX_IOOPWord *ioopw;
-  
-  static MIX_IOOPChar ioopchars[21];
-  static const size_t remain_chars[21]=
-    {
-      0, 0, 0, 0, 0, 0, 0, 0,
-      0, 0, 0, 0, 0, 0, 0, 0,
-      80, 80, 120, 70, 70
-    };
-  static MIX_IOOPWord ioopwords[21];
-  
-  
-  dev= READ_F;
-  CHECK_DEV ( dev );
-  if ( _device_busy ( _udata, dev ) )
-    {
-      _regs.PC= _regs.old_PC;
-      _run_state.v= WAIT_DEVICE;
-      _run_state.dev= dev;
-      _notify_waiting_device ( _udata, dev, true );
-      return;
-    }
-  calc_M ();
-  if ( dev < MIX_CARDREADER )
-    {
-      ioopw= &(ioopwords[dev]);
-      ioopw->remain= 100;
-      ioopw->_addr= _vars.M;
-      _init_ioopword ( _udata, dev, ioopw, op );
-    }
-  else
-    {
-      ioop= &(ioopchars[dev]);
-      ioop->remain= remain_chars[dev];
-      ioop->_pos= 0;
-      ioop->_addr= _vars.M;
-      if ( op == MIX_IN )
-        ioop->_aux= 0;
-      else
-        {
-          ioop->_aux= _mem[ioop->_addr];
-          if ( ++(ioop->_addr) == 4000 ) ioop->_addr= 0;
-        }
-      _init_ioopchar ( _udata, dev, ioop, op );
-    }
-  
-} /* end inout */
 
+  m->sched.base= m->clock + (uint64_t) cc_total;
+  m->sched.budget= m->sched.left= cc_remain;
 
-static void
-jbusy (
-       MIX_Bool jump
-       )
+} /* end sched_at */
+
+
+static uint64_t
+sched_now (
+           const MIX_Machine *m
+           )
 {
-  
-  int dev;
-  
-  
-  dev= READ_F;
-  CHECK_DEV ( dev )
-  if ( _device_busy ( _udata, dev ) == jump )
-    {
-      _regs.J= _regs.PC;
-      calc_M ();
-      _regs.PC= _vars.M;
-    }
-  
-} /* end jbusy */
+  return m->sched.base + (uint64_t) (m->sched.budget - m->sched.left);
+} /* end sched_now */
 
 
+/* Afegix a la cua l'esdeveniment de final de l'operació de DEV. */
 static void
-num ()
+sched_push (
+            MIX_Machine    *m,
+            const int       dev,
+            const uint64_t  until
+            )
 {
-  
-  /* NOTA: El desbordament té una senzilla solució, simplement el
-   * mòdul de 2^30 es pot calcular ignorant tots els bits majors.
-   */
-  int i;
-  MIXu32 res;
-  
-  
-  res= 0;
-  for ( i= 24; i != -6; i-= 6 )
-    {
-      res*= 10;
-      res+= ((_regs.A>>i)&0x3F)%10;
-    }
-  for ( i= 24; i != -6; i-= 6 )
+
+  int i, p;
+
+
+  m->sched.busy[dev]= true;
+  m->sched.until[dev]= until;
+  i= m->sched.n++;
+  while ( i > 0 && m->sched.heap[p= (i-1)/2].t > until )
     {
-      res*= 10;
-      res+= ((_regs.X>>i)&0x3F)%10;
+      m->sched.heap[i]= m->sched.heap[p];
+      i= p;
     }
-  _regs.A&= NMASK;
-  _regs.A|= res&INMASK;
-  
-} /* end num */
+  m->sched.heap[i].t= until;
+  m->sched.heap[i].dev= dev;
+
+} /* end sched_push */
 
 
+/* Comença a servir en el cicle T la petició de DEV al bloc BLOCK que
+   va arribar en ARRIVAL. */
 static void
-char_op ()
+disk_serve (
+            MIX_Machine    *m,
+            const int       dev,
+            const long      block,
+            const bool      seek,
+            const uint64_t  arrival,
+            const uint64_t  t
+            )
 {
-  
-  int i;
-  MIXu32 aux, aux2;
-  
-  
-  aux= _regs.A&INMASK;
-  aux2= 0;
-  for ( i= 0; i < 5; ++i )
-    {
-      aux2>>= 6;
-      aux2|= ((aux%10)+30)<<24;
-      aux/= 10;
-    }
-  _regs.X&= NMASK;
-  _regs.X|= aux2;
-  aux2= 0;
-  for ( i= 0; i < 5; ++i )
+
+  const MIX_DiskTiming *dt;
+  MIX_DiskStats *st;
+  uint64_t end, unit;
+  long track, dist;
+
+
+  dt= &(m->sched.disk.timing);
+  st= &(m->sched.disk.stats[dev-MIX_DISKORDRUMUNIT1]);
+  track= block/dt->blocks;
+  dist= track - m->sched.disk.track;
+  if ( dist != 0 ) m->sched.disk.dir= dist > 0 ? 1 : -1;
+  if ( dist < 0 ) dist= -dist;
+  end= t;
+  if ( dist > 0 ) end+= dt->seek + (uint64_t) dist*dt->track;
+  if ( !seek && dt->rotation > 0 )
     {
-      aux2>>= 6;
-      aux2|= ((aux%10)+30)<<24;
-      aux/= 10;
+      unit= dt->rotation/dt->blocks;
+      end+= ((block%dt->blocks)*unit + dt->rotation - end%dt->rotation) %
+        dt->rotation;
+      end+= unit;
     }
-  _regs.A&= NMASK;
-  _regs.A|= aux2;
-  
-} /* end char_op */
+  m->sched.disk.track= track;
+  m->sched.disk.active= true;
+  st->seek_tracks+= (unsigned long long) dist;
+  st->wait_cycles+= t - arrival;
+  st->service_cycles+= end - t;
+  sched_push ( m, dev, end );
 
+} /* end disk_serve */
 
 
-
-/****************/
-/* INSTRUCCIONS */
-/****************/
-
-static unsigned int
-LDA ()
+/* Trau de 'queue' la següent petició segons la política i la servix
+   en el cicle T. */
+static void
+disk_next (
+           MIX_Machine    *m,
+           const uint64_t  t
+           )
 {
-  
-  _regs.A= ld ();
-  return 2;
-  
-} /* end LDA */
 
+  int i, sel, n;
+  long track, dist, best, cur;
+  bool rev;
 
-static unsigned int
-LDX ()
-{
-  
-  _regs.X= ld ();
-  return 2;
-  
-} /* end LDX */
 
+  n= m->sched.disk.nqueue;
+  cur= m->sched.disk.track;
+  sel= 0;
+  if ( m->sched.disk.timing.policy != MIX_DISK_FIFO )
+    for ( rev= false; ; rev= true )
+      {
+        sel= -1;
+        best= 0;
+        for ( i= 0; i < n; ++i )
+          {
+            track= m->sched.disk.queue[i].block/m->sched.disk.timing.blocks;
+            dist= track - cur;
+            if ( m->sched.disk.timing.policy == MIX_DISK_ELEVATOR )
+              {
+                dist*= m->sched.disk.dir;
+                if ( dist < 0 ) continue;
+              }
+            else if ( dist < 0 ) dist= -dist;
+            if ( sel == -1 || dist < best ) { sel= i; best= dist; }
+          }
+        // L'ascensor canvia de sentit quan no queda res per davant.
+        if ( sel != -1 || rev ) break;
+        m->sched.disk.dir= -m->sched.disk.dir;
+      }
+  disk_serve ( m, m->sched.disk.queue[sel].dev, m->sched.disk.queue[sel].block,
+               m->sched.disk.queue[sel].seek, m->sched.disk.queue[sel].t, t );
+  for ( i= sel+1; i < n; ++i )
+    m->sched.disk.queue[i-1]= m->sched.disk.queue[i];
+  m->sched.disk.nqueue= n-1;
 
-static unsigned int
-LD1 ()
-{
-  
-  _regs.I[0]= LDI;
-  return 2;
-  
-} /* end LD1 */
+} /* end disk_next */
 
 
-static unsigned int
-LD2 ()
+/* Trau de la cua els esdeveniments anteriors o iguals a NOW. */
+static void
+sched_retire (
+              MIX_Machine    *m,
+              const uint64_t  now
+              )
 {
-  
-  _regs.I[1]= LDI;
-  return 2;
-  
-} /* end LD2 */
 
+  int i, c, n, dev;
+  uint64_t t;
 
-static unsigned int
-LD3 ()
-{
-  
-  _regs.I[2]= LDI;
-  return 2;
-  
-} /* end LD3 */
 
+  while ( m->sched.n > 0 && m->sched.heap[0].t <= now )
+    {
+      t= m->sched.heap[0].t;
+      dev= m->sched.heap[0].dev;
+      m->sched.busy[dev]= false;
+      n= --m->sched.n;
+      i= 0;
+      for (;;)
+        {
+          c= 2*i + 1;
+          if ( c >= n ) break;
+          if ( c+1 < n && m->sched.heap[c+1].t < m->sched.heap[c].t ) ++c;
+          if ( m->sched.heap[n].t <= m->sched.heap[c].t ) break;
+          m->sched.heap[i]= m->sched.heap[c];
+          i= c;
+        }
+      m->sched.heap[i]= m->sched.heap[n];
+      if ( m->sched.disk.on && dev >= MIX_DISKORDRUMUNIT1 &&
+           dev <= MIX_DISKORDRUMUNIT8 )
+        {
+          m->sched.disk.active= false;
+          if ( m->sched.disk.nqueue > 0 ) disk_next ( m, t );
+        }
+    }
 
-static unsigned int
-LD4 ()
-{
-  
-  _regs.I[3]= LDI;
-  return 2;
-  
-} /* end LD4 */
+} /* end sched_retire */
 
 
-static unsigned int
-LD5 ()
+/* Cicles que falten perquè acabe l'operació simulada de DEV. */
+static uint64_t
+sched_remain (
+              MIX_Machine *m,
+              const int    dev
+              )
 {
-  
-  _regs.I[4]= LDI;
-  return 2;
-  
-} /* end LD5 */
 
+  uint64_t now;
 
-static unsigned int
-LD6 ()
-{
-  
-  _regs.I[5]= LDI;
-  return 2;
+
+  if ( !m->sched.on ) return 0;
+  now= sched_now ( m );
+  sched_retire ( m, now );
+  if ( !m->sched.busy[dev] ) return 0;
   
-} /* end LD6 */
+  // Les unitats en cua esperen al següent esdeveniment.
+  return m->sched.until[dev] != UINT64_MAX ?
+    m->sched.until[dev] - now : m->sched.heap[0].t - now;
 
+} /* end sched_remain */
 
-static unsigned int
-LDAN ()
+
+/* Ocupa DEV durant START+WORDS*word+BLOCKS*block cicles. El
+   dispositiu no està ocupat perquè les instruccions esperen abans de
+   començar una operació. */
+static void
+sched_start (
+             MIX_Machine *m,
+             const int    dev,
+             const long   words,
+             const long   blocks
+             )
 {
-  
-  _regs.A= LDN;
-  return 2;
-  
-} /* end LDAN */
 
+  const MIX_DeviceTiming *t;
 
-static unsigned int
-LDXN ()
-{
-  
-  _regs.X= LDN;
-  return 2;
-  
-} /* end LDXN */
 
+  if ( !m->sched.has[dev] ) return;
+  t= &(m->sched.timing[dev]);
+  sched_push ( m, dev, sched_now ( m ) + t->start +
+               (uint64_t) words*t->word + (uint64_t) blocks*t->block );
 
-static unsigned int
-LD1N ()
-{
-  
-  _regs.I[0]= LDIN;
-  return 2;
-  
-} /* end LD1N */
+} /* end sched_start */
 
 
-static unsigned int
-LD2N ()
+/* Petició d'un IN/OUT (SEEK fals) o IOC (SEEK cert) al bloc BLOCK de
+   la unitat de disc DEV. */
+static void
+disk_request (
+              MIX_Machine *m,
+              const int    dev,
+              const long   block,
+              const bool   seek
+              )
 {
-  
-  _regs.I[1]= LDIN;
-  return 2;
-  
-} /* end LD2N */
 
+  MIX_DiskStats *st;
+  uint64_t now;
+  unsigned int depth;
+  int n;
 
-static unsigned int
-LD3N ()
-{
-  
-  _regs.I[2]= LDIN;
-  return 2;
-  
-} /* end LD3N */
 
+  now= sched_now ( m );
+  st= &(m->sched.disk.stats[dev-MIX_DISKORDRUMUNIT1]);
+  n= m->sched.disk.nqueue;
+  depth= (unsigned int) n + (m->sched.disk.active ? 1 : 0);
+  ++st->requests;
+  st->queue_sum+= depth;
+  if ( depth > st->queue_max ) st->queue_max= depth;
+  if ( !m->sched.disk.active ) disk_serve ( m, dev, block, seek, now, now );
+  else
+    {
+      m->sched.busy[dev]= true;
+      m->sched.until[dev]= UINT64_MAX;
+      m->sched.disk.queue[n].dev= dev;
+      m->sched.disk.queue[n].block= block;
+      m->sched.disk.queue[n].seek= seek;
+      m->sched.disk.queue[n].t= now;
+      m->sched.disk.nqueue= n+1;
+    }
+
+} /* end disk_request */
 
-static unsigned int
-LD4N ()
+
+
+static void
+sched_update_on (
+                 MIX_Machine *m
+                 )
 {
-  
-  _regs.I[3]= LDIN;
-  return 2;
-  
-} /* end LD4N */
+
+  int i;
 
 
-static unsigned int
-LD5N ()
+  m->sched.on= m->sched.disk.on;
+  for ( i= 0; i < 21; ++i )
+    m->sched.on|= m->sched.has[i];
+
+} /* end sched_update_on */
+
+
+/* Afegix un esdeveniment a la cronologia, si no hi ha memòria es
+   perd. */
+static void
+timeline_add (
+              timeline_t     *tl,
+              const uint64_t  t,
+              const int       kind,
+              const int       dev,
+              const int       M,
+              const long      block
+              )
 {
-  
-  _regs.I[4]= LDIN;
-  return 2;
-  
-} /* end LD5N */
 
+  tl_event_t *v;
+  size_t size;
 
-static unsigned int
-LD6N ()
+
+  if ( tl->n == tl->size )
+    {
+      size= tl->size == 0 ? 1024 : 2*tl->size;
+      v= (tl_event_t *) realloc ( tl->v, size*sizeof(tl_event_t) );
+      if ( v == NULL ) { tl->lost= true; return; }
+      tl->v= v;
+      tl->size= size;
+    }
+  v= &(tl->v[tl->n++]);
+  v->t= t;
+  v->kind= (uint8_t) kind;
+  v->dev= (uint8_t) dev;
+  v->M= (int16_t) M;
+  v->block= (int32_t) block;
+
+} /* end timeline_add */
+
+
+/* Registra que DEV comença ara una operació KIND (TL_IN, TL_OUT o
+   TL_IOC). */
+static void
+timeline_io (
+             MIX_Machine *m,
+             const int    dev,
+             const int    kind,
+             const int    M,
+             const long   block
+             )
 {
-  
-  _regs.I[5]= LDIN;
-  return 2;
-  
-} /* end LD6N */
 
+  timeline_t *tl;
 
-static unsigned int
-STA ()
+
+  tl= m->timeline;
+  if ( !tl->on ) return;
+  tl->open[dev]= true;
+  tl->start[dev]= sched_now ( m );
+  timeline_add ( tl, tl->start[dev], kind, dev, M, block );
+
+} /* end timeline_io */
+
+
+/* Registra que l'operació de DEV ha acabat. Amb el model de temps
+   acaba quan diu el model, sense ell quan la màquina veu que el
+   dispositiu està lliure. */
+static void
+timeline_done (
+               MIX_Machine *m,
+               const int    dev
+               )
 {
-  
-  st ( _regs.A );
-  return 2;
-  
-} /* end STA */
 
+  timeline_t *tl;
+  uint64_t now, t;
+  bool timed;
 
-static unsigned int
-STX ()
+
+  tl= m->timeline;
+  if ( !tl->on || !tl->open[dev] ) return;
+  now= sched_now ( m );
+  timed= m->sched.has[dev] ||
+    (m->sched.disk.on && dev >= MIX_DISKORDRUMUNIT1 &&
+     dev <= MIX_DISKORDRUMUNIT8);
+  t= timed && m->sched.until[dev] <= now ? m->sched.until[dev] : now;
+  if ( t < tl->start[dev] ) t= tl->start[dev];
+  timeline_add ( tl, t, TL_DONE, dev, 0, 0 );
+  tl->open[dev]= false;
+
+} /* end timeline_done */
+
+
+/* Registra els canvis d'estat de la CPU en el cicle T: quan comença
+   o acaba una espera i quan es para. */
+static void
+timeline_cpu (
+              MIX_Machine    *m,
+              const uint64_t  t
+              )
 {
-  
-  st ( _regs.X );
-  return 2;
-  
-} /* end STX */
 
+  timeline_t *tl;
 
-static unsigned int
-ST1 ()
+
+  tl= m->timeline;
+  if ( !tl->on || tl->state == m->run_state.v ) return;
+  if ( tl->state == WAIT_DEVICE ) timeline_add ( tl, t, TL_RUN, 0, 0, 0 );
+  if ( m->run_state.v == WAIT_DEVICE )
+    timeline_add ( tl, t, TL_WAIT, m->run_state.dev, 0, 0 );
+  else if ( m->run_state.v == HALT )
+    timeline_add ( tl, t, TL_HALT, 0, 0, 0 );
+  tl->state= m->run_state.v;
+
+} /* end timeline_cpu */
+
+
+/* Espera entre comprovacions del buffer quan està ple (productor) o
+   buit (consumidor). */
+static const struct timespec _trace_wait= { 0, 100000 };
+
+
+/* Aplica el filtre a l'instrucció de ADDR i guarda en 'sel' què
+   escriu (TRACE_*). Es torna a fer quan s'escriu en l'adreça, igual
+   que la descodificació. */
+static void
+trace_select (
+              MIX_Machine *m,
+              const int    addr
+              )
 {
   
-  st ( _regs.I[0] );
-  return 2;
-  
-} /* end ST1 */
+  trace_t *t;
+  int C, F, k;
+  
+  
+  t= m->trace;
+  C= m->mem[addr]&0x3F;
+  F= (m->mem[addr]>>6)&0x3F;
+  if ( addr < t->begin || addr >= t->end || !((t->ops>>C)&0x1) )
+    k= TRACE_OFF;
+  else if ( C == 0 ) k= TRACE_NONE; // NOP
+  else if ( C <= 4 ) k= 0; // ADD, SUB, MUL, DIV
+  else if ( C == 5 ) k= F == 0 ? 0 : (F == 1 ? 7 : TRACE_NONE);
+  else if ( C == 6 ) k= 0;
+  else if ( C == 7 ) k= 1; // MOVE
+  else if ( C <= 15 ) k= C-8;
+  else if ( C <= 23 ) k= C-16;
+  else if ( C <= 33 ) k= TRACE_MEM;
+  else if ( C == 34 || (C >= 38 && C <= 47) ) k= TRACE_J;
+  else if ( C >= 48 && C <= 55 ) k= C-48;
+  else if ( C >= 56 ) k= TRACE_CMP;
+  else k= TRACE_NONE; // IOC, IN, OUT
+  t->sel[addr]= (uint8_t) k;
+  m->code[addr]|= CODE_TRACE;
+  
+} /* end trace_select */
+
+
+/* Fa visibles per al consumidor els registres escrits. */
+static void
+trace_publish (
+               trace_t *t
+               )
+{
+  atomic_store_explicit ( &(t->head), t->whead, memory_order_release );
+} /* end trace_publish */
 
 
-static unsigned int
-ST2 ()
+/* Publica un bloc de TRACE_PUBLISH registres i espera, si el buffer
+   està ple, que hi haja lloc per al següent. */
+static void
+trace_flush (
+             trace_t *t
+             )
 {
   
-  st ( _regs.I[1] );
-  return 2;
+  trace_publish ( t );
+  while ( t->whead+TRACE_PUBLISH-
+          (t->wtail= atomic_load_explicit ( &(t->tail),
+                                            memory_order_acquire ))
+          > TRACE_SIZE )
+    nanosleep ( &_trace_wait, NULL );
   
-} /* end ST2 */
+} /* end trace_flush */
 
 
-static unsigned int
-ST3 ()
+/* Torna el següent registre lliure. Gràcies a trace_flush sempre n'hi
+   ha fins al següent múltiple de TRACE_PUBLISH. */
+static inline MIX_TraceRecord *
+trace_next (
+            trace_t *t
+            )
+{
+  return &(t->buf[t->whead&(TRACE_SIZE-1)]);
+} /* end trace_next */
+
+
+/* Completa el registre R d'una instrucció que escriu K (TRACE_*) i el
+   fa visible. OLD és el valor del destí abans d'executar-la i VALUE
+   el de després (la paraula escrita per ST i 0 si no escriu res), OV
+   el desbordament d'abans i M l'adreça escrita per ST. Els bits de
+   'changed' són 1<<K, així que no cal distingir casos. S'expandeix
+   dins de run_threaded, on GCC no l'expandiria per si sol. */
+#if defined(__GNUC__)
+__attribute__((always_inline))
+#endif
+static inline void
+trace_close (
+             MIX_Machine      *m,
+             trace_t          *t,
+             MIX_TraceRecord  *r,
+             const int         k,
+             const MIXu32      old,
+             const MIXu32      value,
+             const overflow_t  ov,
+             const int         M,
+             const int         cycles
+             )
 {
   
-  st ( _regs.I[2] );
-  return 2;
+  unsigned int changed;
   
-} /* end ST3 */
+  
+  changed= (((unsigned int) (value != old) | (k == TRACE_MEM))<<k)&0x0FFF;
+  changed|= (unsigned int) (m->overflow != ov)<<10;
+  r->value= value;
+  r->addr= k == TRACE_MEM ? (uint16_t) M : 0;
+  r->changed= (uint16_t) changed;
+  r->cycles= (uint16_t) cycles;
+  if ( (++t->whead&(TRACE_PUBLISH-1)) == 0 ) trace_flush ( t );
+  
+} /* end trace_close */
 
 
-static unsigned int
-ST4 ()
+/* El dispositiu està ocupat per al frontend o per al model de
+   temps. */
+static MIX_Bool
+dev_busy (
+          MIX_Machine *m,
+          const int    dev
+          )
 {
-  
-  st ( _regs.I[3] );
-  return 2;
-  
-} /* end ST4 */
 
+  MIX_Bool ret;
 
-static unsigned int
-ST5 ()
+
+  ret= sched_remain ( m, dev ) > 0 || m->device_busy ( m->udata, dev );
+  if ( !ret && m->timeline != NULL ) timeline_done ( m, dev );
+
+  return ret;
+
+} /* end dev_busy */
+
+
+/* Cicles que s'han d'esperar, sense passar de CC, a que acabe
+   l'operació simulada de DEV. */
+static int
+sched_wait (
+            MIX_Machine *m,
+            const int    dev,
+            const int    cc
+            )
 {
-  
-  st ( _regs.I[4] );
-  return 2;
-  
-} /* end ST5 */
 
+  uint64_t remain;
 
-static unsigned int
-ST6 ()
+
+  remain= sched_remain ( m, dev );
+
+  return remain < (uint64_t) cc ? (int) remain : cc;
+
+} /* end sched_wait */
+
+
+static void
+inout (
+       MIX_Machine *m,
+       MIX_OPType op
+       )
 {
   
-  st ( _regs.I[5] );
-  return 2;
+  int dev;
+  MIX_IOOPChar *ioop;
+  MIX_IOOPWord *ioopw;
   
-} /* end ST6 */
+  static const size_t remain_chars[21]=
+    {
+      0, 0, 0, 0, 0, 0, 0, 0,
+      0, 0, 0, 0, 0, 0, 0, 0,
+      80, 80, 120, 70, 70
+    };
+  
+  
+  dev= READ_F;
+  CHECK_DEV ( dev );
+  if ( dev_busy ( m, dev ) )
+    {
+      m->regs.PC= m->regs.old_PC;
+      m->run_state.v= WAIT_DEVICE;
+      m->run_state.dev= dev;
+      m->run_state.busy= MIX_TRUE;
+      m->run_state.spin= -1;
+      m->run_state.spinning= false;
+      m->notify_waiting_device ( m->udata, dev, true );
+      --m->insts; // Es tornarà a executar
+      if ( m->counting ) --m->ctr.ops[m->vars.d->inst&0x3F];
+      return;
+    }
+  calc_M ( m );
+  if ( dev < MIX_CARDREADER )
+    {
+      ioopw= &(m->ioopwords[dev]);
+      ioopw->remain= 100;
+      ioopw->_addr= m->vars.M;
+      ioopw->block= dev >= MIX_DISKORDRUMUNIT1 ? (long) (m->regs.X&INMASK) : 0;
+      m->init_ioopword ( m->udata, dev, ioopw, op );
+      if ( dev < MIX_DISKORDRUMUNIT1 )
+        {
+          sched_start ( m, dev, 100, 0 );
+          ++m->sched.pos[dev];
+        }
+      else if ( m->sched.disk.on ) disk_request ( m, dev, ioopw->block, false );
+      else sched_start ( m, dev, 100, 0 );
+    }
+  else
+    {
+      ioop= &(m->ioopchars[dev]);
+      ioop->remain= remain_chars[dev];
+      ioop->_pos= 0;
+      ioop->_addr= m->vars.M;
+      if ( op == MIX_IN )
+        ioop->_aux= 0;
+      else
+        {
+          ioop->_aux= m->mem[ioop->_addr];
+          if ( ++(ioop->_addr) == 4000 ) ioop->_addr= 0;
+        }
+      m->init_ioopchar ( m->udata, dev, ioop, op );
+      sched_start ( m, dev, (long) remain_chars[dev]/5, 0 );
+    }
+  if ( m->timeline != NULL )
+    timeline_io ( m, dev, op == MIX_IN ? TL_IN : TL_OUT, m->vars.M,
+                  dev >= MIX_DISKORDRUMUNIT1 && dev < MIX_CARDREADER ?
+                  m->ioopwords[dev].block : 0 );
+  
+} /* end inout */
 
 
-static unsigned int
-STJ ()
+/* Oblida les notificacions anteriors del dispositiu. S'ha de cridar
+   abans de consultar device_busy per a decidir si es continua
+   esperant, així no es perd cap notificació posterior. */
+static void
+events_clear (
+              MIX_Machine *m,
+              const int    dev
+              )
 {
   
-  st ( _regs.J );
-  return 2;
+  pthread_mutex_lock ( &(m->events.lock) );
+  m->events.ready&= ~(1U<<dev);
+  pthread_mutex_unlock ( &(m->events.lock) );
   
-} /* end STJ */
+} /* end events_clear */
 
 
-static unsigned int
-STZ ()
+/* Bucles d'espera. Un JBUS/JRED que salta a ell mateix, o un
+ * JBUS/JRED que no salta seguit d'un JMP a ell, es repetix sense fer
+ * res més fins que canvia l'estat del dispositiu. En compte
+ * d'executar-lo es passa a WAIT_DEVICE, que consumix tots els cicles
+ * de colp, i s'actualitzen PC i J com si s'haguera executat.
+ */
+static void
+spin_wait (
+           MIX_Machine    *m,
+           const int       dev,
+           const MIX_Bool  busy,
+           const int       spin
+           )
 {
   
-  st ( 0 );
-  return 2;
+  m->run_state.v= WAIT_DEVICE;
+  m->run_state.dev= dev;
+  m->run_state.busy= busy;
+  m->run_state.spin= spin;
+  m->run_state.spinning= true;
+  m->notify_waiting_device ( m->udata, dev, true );
   
-} /* end STZ */
+} /* end spin_wait */
 
 
-static unsigned int
-ADD ()
+/* Avança CC cicles el bucle d'espera de dos instruccions. Torna false
+   si el JMP s'ha modificat mentre s'esperava. */
+static bool
+spin_advance (
+              MIX_Machine *m,
+              const int    cc
+              )
 {
   
-  MIXs32 op1, op2;
+  int jmp, loop, next;
+  MIXu32 w;
   
   
-  ADD_ ( +=, op1, op2 );
+  jmp= m->run_state.spin;
+  w= m->mem[jmp];
+  loop= (w>>18)&0xFFF;
+  if ( w != ((((MIXu32) loop)<<18)|39) ) return false;
+  if ( cc == 0 ) return true;
+  next= jmp == 3999 ? 0 : jmp+1;
+  if ( m->regs.PC == jmp )
+    {
+      m->regs.J= next;
+      m->regs.PC= cc%2 ? loop : jmp;
+    }
+  else if ( cc >= 2 )
+    {
+      m->regs.J= next;
+      m->regs.PC= cc%2 ? jmp : loop;
+    }
+  else m->regs.PC= jmp;
   
-  return 2;
+  return true;
   
-} /* end ADD */
+} /* end spin_advance */
 
 
-static unsigned int
-SUB ()
+static void
+jbusy (
+       MIX_Machine *m,
+       MIX_Bool jump
+       )
 {
   
-  MIXs32 op1, op2;
+  const decoded_t *d;
+  int dev;
+  MIX_Bool busy;
   
   
-  ADD_ ( -=, op1, op2 );
+  dev= READ_F;
+  CHECK_DEV ( dev )
+  busy= dev_busy ( m, dev );
+  if ( busy == jump )
+    {
+      m->regs.J= m->regs.PC;
+      calc_M ( m );
+      m->regs.PC= m->vars.M;
+      d= m->vars.d;
+      if ( d->I == 0 && d->addr == m->regs.old_PC )
+        spin_wait ( m, dev, busy, -1 );
+    }
+  else if ( m->mem[m->regs.PC] == ((((MIXu32) m->regs.old_PC)<<18)|39) )
+    spin_wait ( m, dev, busy, m->regs.PC );
   
-  return 2;
-  
-} /* end SUB */
+} /* end jbusy */
 
 
-static unsigned int
-MUL ()
+static void
+num (
+     MIX_Machine *m
+     )
 {
-
-#ifdef _MIX_64
-  MIXs32 op1, op2;
-  MIXs64 res;
+  
+  /* NOTA: El desbordament té una senzilla solució, simplement el
+   * mòdul de 2^30 es pot calcular ignorant tots els bits majors.
+   */
+  int i;
+  MIXu32 res;
   
   
-  CALC_OP1_OP2 ( op1, op2 );
-  res= (MIXs64) op1 * (MIXs64) op2;
-  if ( res < 0 )
+  res= 0;
+  for ( i= 24; i != -6; i-= 6 )
     {
-      _regs.A= _regs.X= NMASK;
-      res= -res;
+      res*= 10;
+      res+= ((m->regs.A>>i)&0x3F)%10;
     }
-  else _regs.A= _regs.X= 0;
-  _regs.X|= (MIXu32) (res&INMASK);
-  _regs.A|= (MIXu32) ((res>>30)&INMASK);
-#else
-  _warning ( _udata, "l'operació MUL no està implementada" );
-#endif
-  
-  return 10;
+  for ( i= 24; i != -6; i-= 6 )
+    {
+      res*= 10;
+      res+= ((m->regs.X>>i)&0x3F)%10;
+    }
+  m->regs.A&= NMASK;
+  m->regs.A|= res&INMASK;
   
-} /* end MUL */
+} /* end num */
 
 
-static unsigned int
-DIV ()
+static void
+char_op (
+         MIX_Machine *m
+         )
 {
   
-#ifdef _MIX_64
-  MIXs32 op1, op2, aop1, aop2;
-  MIXs64 op;
+  int i;
+  MIXu32 aux, aux2;
   
   
-  op1= (MIXs32) _regs.A; aop1= ABS ( op1 );
-  CALC_OP2 ( op2 ); aop2= ABS ( op2 );
-  if ( aop1 >= aop2 || aop2 == 0 )
-    _overflow= ON;
-  /* Es supossa que en aquest cas tant el resultat com la resta caben
-     en 30 bits cadascuna. */
-  else
+  aux= m->regs.A&INMASK;
+  aux2= 0;
+  for ( i= 0; i < 5; ++i )
     {
-      op= ((MIXs32) aop1)<<30;
-      op|= (MIXs32) (_regs.X&INMASK);
-      _regs.A= (MIXu32) (op/aop2);
-      _regs.X= (MIXu32) (op%aop2);
-      if ( (op1&NMASK) != (op2&NMASK) )
-        {
-          _regs.A|= NMASK;
-          _regs.X|= NMASK;
-        }
+      aux2>>= 6;
+      aux2|= ((aux%10)+30)<<24;
+      aux/= 10;
     }
-#else
-  _warning ( _udata, "la operació DIV no està implementada" );
-#endif
-
-  return 12;
+  m->regs.X&= NMASK;
+  m->regs.X|= aux2;
+  aux2= 0;
+  for ( i= 0; i < 5; ++i )
+    {
+      aux2>>= 6;
+      aux2|= ((aux%10)+30)<<24;
+      aux/= 10;
+    }
+  m->regs.A&= NMASK;
+  m->regs.A|= aux2;
   
-} /* end DIV */
+} /* end char_op */
+
+
+
 
+/****************/
+/* INSTRUCCIONS */
+/****************/
 
 static unsigned int
-MOPA ()
+LDA (
+     MIX_Machine *m
+     )
 {
   
-  _regs.A= mop ( _regs.A );
-  return 1;
+  m->regs.A= ld ( m );
+  return 2;
   
-} /* end MOPA */
+} /* end LDA */
 
 
 static unsigned int
-MOPX ()
+LDX (
+     MIX_Machine *m
+     )
 {
   
-  _regs.X= mop ( _regs.X );
-  return 1;
+  m->regs.X= ld ( m );
+  return 2;
   
-} /* end MOPX */
+} /* end LDX */
 
 
 static unsigned int
-MOP1 ()
+LD1 (
+     MIX_Machine *m
+     )
 {
   
-  _regs.I[0]= MOPI ( _regs.I[0] );
-  return 1;
+  m->regs.I[0]= LDI;
+  return 2;
   
-} /* end MOP1 */
+} /* end LD1 */
 
 
 static unsigned int
-MOP2 ()
+LD2 (
+     MIX_Machine *m
+     )
 {
   
-  _regs.I[1]= MOPI ( _regs.I[1] );
-  return 1;
+  m->regs.I[1]= LDI;
+  return 2;
   
-} /* end MOP2 */
+} /* end LD2 */
 
 
 static unsigned int
-MOP3 ()
+LD3 (
+     MIX_Machine *m
+     )
 {
   
-  _regs.I[2]= MOPI ( _regs.I[2] );
-  return 1;
+  m->regs.I[2]= LDI;
+  return 2;
   
-} /* end MOP3 */
+} /* end LD3 */
 
 
 static unsigned int
-MOP4 ()
+LD4 (
+     MIX_Machine *m
+     )
 {
   
-  _regs.I[3]= MOPI ( _regs.I[3] );
-  return 1;
+  m->regs.I[3]= LDI;
+  return 2;
   
-} /* end MOP4 */
+} /* end LD4 */
 
 
 static unsigned int
-MOP5 ()
+LD5 (
+     MIX_Machine *m
+     )
 {
   
-  _regs.I[4]= MOPI ( _regs.I[4] );
-  return 1;
+  m->regs.I[4]= LDI;
+  return 2;
   
-} /* end MOP5 */
+} /* end LD5 */
 
 
 static unsigned int
-MOP6 ()
+LD6 (
+     MIX_Machine *m
+     )
 {
   
-  _regs.I[5]= MOPI ( _regs.I[5] );
-  return 1;
+  m->regs.I[5]= LDI;
+  return 2;
   
-} /* end MOP6 */
+} /* end LD6 */
 
 
 static unsigned int
-CMPA ()
+LDAN (
+      MIX_Machine *m
+      )
 {
   
-  cmp ( _regs.A );
+  m->regs.A= LDN;
   return 2;
   
-} /* end CMPA */
+} /* end LDAN */
 
 
 static unsigned int
-CMPX ()
+LDXN (
+      MIX_Machine *m
+      )
 {
   
-  cmp ( _regs.X );
+  m->regs.X= LDN;
   return 2;
   
-} /* end CMPX */
+} /* end LDXN */
 
 
 static unsigned int
-CMP1 ()
+LD1N (
+      MIX_Machine *m
+      )
 {
   
-  cmp ( _regs.I[0] );
+  m->regs.I[0]= LDIN;
   return 2;
   
-} /* end CMP1 */
+} /* end LD1N */
 
 
 static unsigned int
-CMP2 ()
+LD2N (
+      MIX_Machine *m
+      )
 {
   
-  cmp ( _regs.I[1] );
+  m->regs.I[1]= LDIN;
   return 2;
   
-} /* end CMP2 */
+} /* end LD2N */
 
 
 static unsigned int
-CMP3 ()
+LD3N (
+      MIX_Machine *m
+      )
 {
   
-  cmp ( _regs.I[2] );
+  m->regs.I[2]= LDIN;
   return 2;
   
-} /* end CMP3 */
+} /* end LD3N */
 
 
 static unsigned int
-CMP4 ()
+LD4N (
+      MIX_Machine *m
+      )
 {
   
-  cmp ( _regs.I[3] );
+  m->regs.I[3]= LDIN;
   return 2;
   
-} /* end CMP4 */
+} /* end LD4N */
 
 
 static unsigned int
-CMP5 ()
+LD5N (
+      MIX_Machine *m
+      )
 {
   
-  cmp ( _regs.I[4] );
+  m->regs.I[4]= LDIN;
   return 2;
   
-} /* end CMP5 */
+} /* end LD5N */
 
 
 static unsigned int
-CMP6 ()
+LD6N (
+      MIX_Machine *m
+      )
 {
   
-  cmp ( _regs.I[5] );
+  m->regs.I[5]= LDIN;
   return 2;
   
-} /* end CMP6 */
+} /* end LD6N */
 
 
-/* NOTA: És precís que PC s'incremente abans de cridar a les
-   instruccions. */
 static unsigned int
-JOP ()
+STA (
+     MIX_Machine *m
+     )
 {
   
-  int F;
-  MIX_Bool jump, save;
-  
-  
-  F= READ_F;
-  jump= save= MIX_FALSE;
-  switch ( F )
-    {
-      
-      /* JMP */
-    case 0:
-      jump= MIX_TRUE;
-      break;
-      
-      /* JSJ */
-    case 1:
-      jump= save= MIX_TRUE;
-      break;
-      
-      /* JOV */
-    case 2:
-      if ( _overflow == ON )
-        {
-          jump= MIX_TRUE;
-          _overflow= MIX_FALSE;
-        }
-      break;
-      
-      /* JNOV */
-    case 3:
-      if ( _overflow == OFF )
-        jump= MIX_TRUE;
-      else _overflow= OFF;
-      break;
-      
-      /* JL */
-    case 4:
-      if ( _cmp == LESS ) jump= MIX_TRUE;
-      break;
-      
-      /* JE */
-    case 5:
-      if ( _cmp == EQUAL ) jump= MIX_TRUE;
-      break;
-      
-      /* JG */
-    case 6:
-      if ( _cmp == GREATER ) jump= MIX_TRUE;
-      break;
-      
-      /* JGE */
-    case 7:
-      if ( _cmp == GREATER || _cmp == EQUAL )
-        jump= MIX_TRUE;
-      break;
-      
-      /* JNE */
-    case 8:
-      if ( _cmp != EQUAL ) jump= MIX_TRUE;
-      break;
-      
-      /* JLE */
-    case 9:
-      if ( _cmp == LESS || _cmp == EQUAL )
-        jump= MIX_TRUE;
-      break;
-      
-    default:
-      _warning ( _udata, "operació C=39 F=%d no vàlida", F );
-      
-    }
-  
-  if ( jump )
-    {
-      if ( !save ) _regs.J= (MIXu32) _regs.PC;
-      calc_M ();
-      _regs.PC= _vars.M;
-    }
-  
-  return 1;
+  st ( m, m->regs.A );
+  return 2;
   
-} /* end JOP */
+} /* end STA */
 
 
 static unsigned int
-JA ()
+STX (
+     MIX_Machine *m
+     )
 {
   
-  jreg ( _regs.A );
-  return 1;
+  st ( m, m->regs.X );
+  return 2;
   
-} /* end JA */
+} /* end STX */
 
 
 static unsigned int
-JX ()
+ST1 (
+     MIX_Machine *m
+     )
 {
   
-  jreg ( _regs.X );
-  return 1;
+  st ( m, m->regs.I[0] );
+  return 2;
   
-} /* end JX */
+} /* end ST1 */
 
 
 static unsigned int
-J1 ()
+ST2 (
+     MIX_Machine *m
+     )
 {
   
-  jreg ( _regs.I[0] );
-  return 1;
+  st ( m, m->regs.I[1] );
+  return 2;
   
-} /* end J1 */
+} /* end ST2 */
 
 
 static unsigned int
-J2 ()
+ST3 (
+     MIX_Machine *m
+     )
 {
   
-  jreg ( _regs.I[1] );
-  return 1;
+  st ( m, m->regs.I[2] );
+  return 2;
   
-} /* end J2 */
+} /* end ST3 */
 
 
 static unsigned int
-J3 ()
+ST4 (
+     MIX_Machine *m
+     )
 {
   
-  jreg ( _regs.I[2] );
-  return 1;
+  st ( m, m->regs.I[3] );
+  return 2;
   
-} /* end J3 */
+} /* end ST4 */
 
 
 static unsigned int
-J4 ()
+ST5 (
+     MIX_Machine *m
+     )
 {
   
-  jreg ( _regs.I[3] );
-  return 1;
+  st ( m, m->regs.I[4] );
+  return 2;
   
-} /* end J4 */
+} /* end ST5 */
 
 
 static unsigned int
-J5 ()
+ST6 (
+     MIX_Machine *m
+     )
 {
   
-  jreg ( _regs.I[4] );
-  return 1;
+  st ( m, m->regs.I[5] );
+  return 2;
   
-} /* end J5 */
+} /* end ST6 */
 
 
 static unsigned int
-J6 ()
+STJ (
+     MIX_Machine *m
+     )
 {
   
-  jreg ( _regs.I[5] );
-  return 1;
+  st ( m, m->regs.J );
+  return 2;
   
-} /* end J6 */
+} /* end STJ */
 
 
 static unsigned int
-SHIFT ()
+STZ (
+     MIX_Machine *m
+     )
 {
   
-  int F;
-  MIXu32 signA, signX, aux;
-  
+  st ( m, 0 );
+  return 2;
   
-  F= READ_F;
-  calc_M_val ();
-  if ( _vars.M < 0 )
-    {
-      _warning ( _udata, "el valor de M és engatiu"
-        	 " en una operació  'shift'"  );
-      goto ret;
-    }
-  else if ( F < 4 )
-    {
-      if ( _vars.M > 10 ) _vars.M= 10;
-      _vars.M*= 6;
-    }
-  else _vars.M= (_vars.M%10)*6;
-  switch ( F )
-    {
-      
-      /* SLA */
-    case 0:
-      signA= _regs.A&NMASK;
-      _regs.A= ((_regs.A<<_vars.M)&INMASK)|signA;
-      break;
-      
-      /* SRA */
-    case 1:
-      signA= _regs.A&NMASK;
-      _regs.A= ((_regs.A&INMASK)>>_vars.M)|signA;
-      break;
-      
-      /* SLAX */
-    case 2:
-      signA= _regs.A&NMASK;
-      signX= _regs.X&NMASK;
-      if ( _vars.M < 30 )
-        {
-          _regs.A= (((_regs.A<<_vars.M)|
-        	     ((_regs.X&INMASK)>>(30-_vars.M)))
-        	    &INMASK)|signA;
-          _regs.X= ((_regs.X<<_vars.M)&INMASK)|signX;
-        }
-      else
-        {
-          _regs.A= ((_regs.X<<(_vars.M-30))&INMASK)|signA;
-          _regs.X= signX;
-        }
-      break;
-      
-      /* SRAX */
-    case 3:
-      signA= _regs.A&NMASK;
-      signX= _regs.X&NMASK;
-      if ( _vars.M < 30 )
-        {
-          _regs.X= ((((_regs.X&INMASK)>>_vars.M)|
-        	     (_regs.A<<(30-_vars.M)))
-        	    &INMASK)|signX;
-          _regs.A= ((_regs.A&INMASK)>>_vars.M)|signA;
-        }
-      else
-        {
-          _regs.X= ((_regs.A&INMASK)>>(_vars.M-30))|signX;
-          _regs.A= signA;
-        }
-      break;
-      
-      /* SLC */
-    case 4:
-      aux= _regs.A;
-      signA= _regs.A&NMASK;
-      signX= _regs.X&NMASK;
-      if ( _vars.M < 30 )
-        {
-          _regs.A= (((_regs.A<<_vars.M)|
-        	     ((_regs.X&INMASK)>>(30-_vars.M)))
-        	    &INMASK)|signA;
-          _regs.X= (((_regs.X<<_vars.M)|
-        	     ((aux&INMASK)>>(30-_vars.M)))
-        	    &INMASK)|signX;
-        }
-      else
-        {
-          _vars.M-= 30;
-          _regs.A= (((_regs.X<<_vars.M)|
-        	     ((_regs.A&INMASK)>>(30-_vars.M)))
-        	    &INMASK)|signA;
-          _regs.X= (((aux<<_vars.M)|
-        	     ((_regs.X&INMASK)>>(30-_vars.M)))
-        	    &INMASK)|signX;
-        }
-      break;
-      
-      /* SRC */
-    case 5:
-      aux= _regs.X;
-      signA= _regs.A&NMASK;
-      signX= _regs.X&NMASK;
-      if ( _vars.M < 30 )
-        {
-          _regs.X= ((((_regs.X&INMASK)>>_vars.M)|
-        	     (_regs.A<<(30-_vars.M)))
-        	    &INMASK)|signX;
-          _regs.A= ((((_regs.A&INMASK)>>_vars.M)|
-        	     (aux<<(30-_vars.M)))
-        	    &INMASK)|signA;
-        }
-      else
-        {
-          _vars.M-= 30;
-          _regs.X= ((((_regs.A&INMASK)>>_vars.M)|
-        	     (_regs.X<<(30-_vars.M)))
-        	    &INMASK)|signX;
-          _regs.A= ((((aux&INMASK)>>_vars.M)|
-        	     (_regs.A<<(30-_vars.M)))
-        	    &INMASK)|signA;
-        }
-      break;
-      
-    default:
-      _warning ( _udata, "operació C=6 F=%d no vàlida", F );
-      
-    }
+} /* end STZ */
+
+
+static unsigned int
+ADD (
+     MIX_Machine *m
+     )
+{
+  
+  MIXs32 op1, op2;
   
- ret:
+  
+  ADD_ ( +=, op1, op2 );
   
   return 2;
   
-} /* end SHIFT */
+} /* end ADD */
 
 
-/* Esta instrucció es tan costosa que podria executar-se de manera no
-   atòmica a al vegada que es fan operacions d'entrada eixida. Però
-   com manipula memòria interna (s'enten que anirà molt ràpid), el
-   màxim són 63 paraules i a més normlament sol ser 1, aleshores, ho
-   faré de manera atòmica. */
 static unsigned int
-MOVE ()
+SUB (
+     MIX_Machine *m
+     )
 {
   
-  int F, I1, f;
+  MIXs32 op1, op2;
   
   
-  F= READ_F;
-  if ( F == 0 ) return 1;
-  calc_M ();
-  I1= _regs.I[0];
-  if ( IS_NEG ( I1 ) )
-    {
-      _warning ( _udata, "el valor de I1 és negatiu,"
-        	 " s'interpretarà com positiu per a"
-        	 " executar MOVE" );
-      I1&= INMASK;
-    }
-  if ( I1 > 3999 )
+  ADD_ ( -=, op1, op2 );
+  
+  return 2;
+  
+} /* end SUB */
+
+
+static unsigned int
+MUL (
+     MIX_Machine *m
+     )
+{
+
+#ifdef _MIX_64
+  MIXs32 op1, op2;
+  MIXs64 res;
+  
+  
+  CALC_OP1_OP2 ( op1, op2 );
+  res= (MIXs64) op1 * (MIXs64) op2;
+  if ( res < 0 )
     {
-      _warning ( _udata, "valor de I1=%d no vàlid per a MOVE", I1 );
-      I1= 3999;
+      m->regs.A= m->regs.X= NMASK;
+      res= -res;
     }
-  for ( f= 0; f < F; ++f )
+  else m->regs.A= m->regs.X= 0;
+  m->regs.X|= (MIXu32) (res&INMASK);
+  m->regs.A|= (MIXu32) ((res>>30)&INMASK);
+#else
+  WARNING ( MIX_WARN_OP, "l'operació MUL no està implementada" );
+#endif
+  
+  return 10;
+  
+} /* end MUL */
+
+
+static unsigned int
+DIV (
+     MIX_Machine *m
+     )
+{
+  
+#ifdef _MIX_64
+  MIXs32 op1, op2, aop1, aop2;
+  MIXs64 op;
+  
+  
+  op1= (MIXs32) m->regs.A; aop1= ABS ( op1 );
+  CALC_OP2 ( op2 ); aop2= ABS ( op2 );
+  if ( aop1 >= aop2 || aop2 == 0 )
+    m->overflow= ON;
+  /* Es supossa que en aquest cas tant el resultat com la resta caben
+     en 30 bits cadascuna. */
+  else
     {
-      _mem[I1]= _mem[_vars.M];
-      if ( ++I1 == 4000 ) I1= 0;
-      if ( ++_vars.M == 4000 ) _vars.M= 0;
+      op= ((MIXs32) aop1)<<30;
+      op|= (MIXs32) (m->regs.X&INMASK);
+      m->regs.A= (MIXu32) (op/aop2);
+      m->regs.X= (MIXu32) (op%aop2);
+      if ( (op1&NMASK) != (op2&NMASK) )
+        {
+          m->regs.A|= NMASK;
+          m->regs.X|= NMASK;
+        }
     }
-  _regs.I[0]= (MIXu32) I1;
+#else
+  WARNING ( MIX_WARN_OP, "la operació DIV no està implementada" );
+#endif
+
+  return 12;
   
-  return (unsigned int) ((F<<1)|0x1);
+} /* end DIV */
+
+
+static unsigned int
+MOPA (
+      MIX_Machine *m
+      )
+{
   
-} /* end MOVE */
+  m->regs.A= mop ( m, m->regs.A, READ_F );
+  return 1;
+  
+} /* end MOPA */
+
+
+static unsigned int
+MOPX (
+      MIX_Machine *m
+      )
+{
+  
+  m->regs.X= mop ( m, m->regs.X, READ_F );
+  return 1;
+  
+} /* end MOPX */
 
 
 static unsigned int
-NOP ()
+MOP1 (
+      MIX_Machine *m
+      )
 {
+  
+  m->regs.I[0]= MOPI ( m->regs.I[0] );
   return 1;
-} /* end NOP */
+  
+} /* end MOP1 */
 
 
 static unsigned int
-IN ()
+MOP2 (
+      MIX_Machine *m
+      )
 {
-  inout ( MIX_IN );
+  
+  m->regs.I[1]= MOPI ( m->regs.I[1] );
   return 1;
-} /* end IN */
+  
+} /* end MOP2 */
 
 
 static unsigned int
-OUT ()
+MOP3 (
+      MIX_Machine *m
+      )
 {
-  inout ( MIX_OUT );
+  
+  m->regs.I[2]= MOPI ( m->regs.I[2] );
   return 1;
-} /* end OUT */
+  
+} /* end MOP3 */
 
 
 static unsigned int
-JRED ()
+MOP4 (
+      MIX_Machine *m
+      )
 {
-  jbusy ( MIX_FALSE );
+  
+  m->regs.I[3]= MOPI ( m->regs.I[3] );
   return 1;
-} /* end JRED */
+  
+} /* end MOP4 */
 
 
 static unsigned int
-JBUS ()
+MOP5 (
+      MIX_Machine *m
+      )
 {
-  jbusy ( MIX_TRUE );
+  
+  m->regs.I[4]= MOPI ( m->regs.I[4] );
   return 1;
-} /* end JBUS */
+  
+} /* end MOP5 */
+
+
+static unsigned int
+MOP6 (
+      MIX_Machine *m
+      )
+{
+  
+  m->regs.I[5]= MOPI ( m->regs.I[5] );
+  return 1;
+  
+} /* end MOP6 */
+
+
+static unsigned int
+CMPA (
+      MIX_Machine *m
+      )
+{
+  
+  cmp ( m, m->regs.A );
+  return 2;
+  
+} /* end CMPA */
+
+
+static unsigned int
+CMPX (
+      MIX_Machine *m
+      )
+{
+  
+  cmp ( m, m->regs.X );
+  return 2;
+  
+} /* end CMPX */
+
+
+static unsigned int
+CMP1 (
+      MIX_Machine *m
+      )
+{
+  
+  cmp ( m, m->regs.I[0] );
+  return 2;
+  
+} /* end CMP1 */
+
+
+static unsigned int
+CMP2 (
+      MIX_Machine *m
+      )
+{
+  
+  cmp ( m, m->regs.I[1] );
+  return 2;
+  
+} /* end CMP2 */
+
+
+static unsigned int
+CMP3 (
+      MIX_Machine *m
+      )
+{
+  
+  cmp ( m, m->regs.I[2] );
+  return 2;
+  
+} /* end CMP3 */
+
+
+static unsigned int
+CMP4 (
+      MIX_Machine *m
+      )
+{
+  
+  cmp ( m, m->regs.I[3] );
+  return 2;
+  
+} /* end CMP4 */
 
 
 static unsigned int
-IOC ()
+CMP5 (
+      MIX_Machine *m
+      )
+{
+  
+  cmp ( m, m->regs.I[4] );
+  return 2;
+  
+} /* end CMP5 */
+
+
+static unsigned int
+CMP6 (
+      MIX_Machine *m
+      )
+{
+  
+  cmp ( m, m->regs.I[5] );
+  return 2;
+  
+} /* end CMP6 */
+
+
+/* NOTA: És precís que PC s'incremente abans de cridar a les
+   instruccions. */
+static inline unsigned int
+jop (
+     MIX_Machine *m,
+     const int    F
+     )
+{
+  
+  MIX_Bool jump, save;
+  
+  
+  jump= save= MIX_FALSE;
+  switch ( F )
+    {
+      
+      /* JMP */
+    case 0:
+      jump= MIX_TRUE;
+      break;
+      
+      /* JSJ */
+    case 1:
+      jump= save= MIX_TRUE;
+      break;
+      
+      /* JOV */
+    case 2:
+      if ( m->overflow == ON )
+        {
+          jump= MIX_TRUE;
+          m->overflow= OFF;
+        }
+      break;
+      
+      /* JNOV */
+    case 3:
+      if ( m->overflow == OFF )
+        jump= MIX_TRUE;
+      else m->overflow= OFF;
+      break;
+      
+      /* JL */
+    case 4:
+      if ( m->cmp == LESS ) jump= MIX_TRUE;
+      break;
+      
+      /* JE */
+    case 5:
+      if ( m->cmp == EQUAL ) jump= MIX_TRUE;
+      break;
+      
+      /* JG */
+    case 6:
+      if ( m->cmp == GREATER ) jump= MIX_TRUE;
+      break;
+      
+      /* JGE */
+    case 7:
+      if ( m->cmp == GREATER || m->cmp == EQUAL )
+        jump= MIX_TRUE;
+      break;
+      
+      /* JNE */
+    case 8:
+      if ( m->cmp != EQUAL ) jump= MIX_TRUE;
+      break;
+      
+      /* JLE */
+    case 9:
+      if ( m->cmp == LESS || m->cmp == EQUAL )
+        jump= MIX_TRUE;
+      break;
+      
+    default:
+      WARNING ( MIX_WARN_OP, "operació C=39 F=%d no vàlida", F );
+      
+    }
+  
+  if ( jump )
+    {
+      if ( !save ) m->regs.J= (MIXu32) m->regs.PC;
+      calc_M ( m );
+      m->regs.PC= m->vars.M;
+    }
+  
+  return 1;
+  
+} /* end jop */
+
+
+static unsigned int
+JOP (
+     MIX_Machine *m
+     )
+{
+  return jop ( m, READ_F );
+} /* end JOP */
+
+
+static unsigned int
+JA (
+    MIX_Machine *m
+    )
+{
+  
+  jreg ( m, m->regs.A, READ_F );
+  return 1;
+  
+} /* end JA */
+
+
+static unsigned int
+JX (
+    MIX_Machine *m
+    )
+{
+  
+  jreg ( m, m->regs.X, READ_F );
+  return 1;
+  
+} /* end JX */
+
+
+static unsigned int
+J1 (
+    MIX_Machine *m
+    )
+{
+  
+  jreg ( m, m->regs.I[0], READ_F );
+  return 1;
+  
+} /* end J1 */
+
+
+static unsigned int
+J2 (
+    MIX_Machine *m
+    )
+{
+  
+  jreg ( m, m->regs.I[1], READ_F );
+  return 1;
+  
+} /* end J2 */
+
+
+static unsigned int
+J3 (
+    MIX_Machine *m
+    )
+{
+  
+  jreg ( m, m->regs.I[2], READ_F );
+  return 1;
+  
+} /* end J3 */
+
+
+static unsigned int
+J4 (
+    MIX_Machine *m
+    )
+{
+  
+  jreg ( m, m->regs.I[3], READ_F );
+  return 1;
+  
+} /* end J4 */
+
+
+static unsigned int
+J5 (
+    MIX_Machine *m
+    )
+{
+  
+  jreg ( m, m->regs.I[4], READ_F );
+  return 1;
+  
+} /* end J5 */
+
+
+static unsigned int
+J6 (
+    MIX_Machine *m
+    )
+{
+  
+  jreg ( m, m->regs.I[5], READ_F );
+  return 1;
+  
+} /* end J6 */
+
+
+static inline unsigned int
+shift (
+       MIX_Machine *m,
+       const int    F
+       )
+{
+  
+  MIXu32 signA, signX, aux;
+  
+  
+  calc_M_val ( m );
+  if ( m->vars.M < 0 )
+    {
+      WARNING ( MIX_WARN_ADDRESS, "el valor de M és engatiu"
+                " en una operació  'shift'"  );
+      goto ret;
+    }
+  else if ( F < 4 )
+    {
+      if ( m->vars.M > 10 ) m->vars.M= 10;
+      m->vars.M*= 6;
+    }
+  else m->vars.M= (m->vars.M%10)*6;
+  switch ( F )
+    {
+      
+      /* SLA */
+    case 0:
+      signA= m->regs.A&NMASK;
+      m->regs.A= ((m->regs.A<<m->vars.M)&INMASK)|signA;
+      break;
+      
+      /* SRA */
+    case 1:
+      signA= m->regs.A&NMASK;
+      m->regs.A= ((m->regs.A&INMASK)>>m->vars.M)|signA;
+      break;
+      
+      /* SLAX */
+    case 2:
+      signA= m->regs.A&NMASK;
+      signX= m->regs.X&NMASK;
+      if ( m->vars.M < 30 )
+        {
+          m->regs.A= (((m->regs.A<<m->vars.M)|
+        	     ((m->regs.X&INMASK)>>(30-m->vars.M)))
+        	    &INMASK)|signA;
+          m->regs.X= ((m->regs.X<<m->vars.M)&INMASK)|signX;
+        }
+      else
+        {
+          m->regs.A= ((m->regs.X<<(m->vars.M-30))&INMASK)|signA;
+          m->regs.X= signX;
+        }
+      break;
+      
+      /* SRAX */
+    case 3:
+      signA= m->regs.A&NMASK;
+      signX= m->regs.X&NMASK;
+      if ( m->vars.M < 30 )
+        {
+          m->regs.X= ((((m->regs.X&INMASK)>>m->vars.M)|
+        	     (m->regs.A<<(30-m->vars.M)))
+        	    &INMASK)|signX;
+          m->regs.A= ((m->regs.A&INMASK)>>m->vars.M)|signA;
+        }
+      else
+        {
+          m->regs.X= ((m->regs.A&INMASK)>>(m->vars.M-30))|signX;
+          m->regs.A= signA;
+        }
+      break;
+      
+      /* SLC */
+    case 4:
+      aux= m->regs.A;
+      signA= m->regs.A&NMASK;
+      signX= m->regs.X&NMASK;
+      if ( m->vars.M < 30 )
+        {
+          m->regs.A= (((m->regs.A<<m->vars.M)|
+        	     ((m->regs.X&INMASK)>>(30-m->vars.M)))
+        	    &INMASK)|signA;
+          m->regs.X= (((m->regs.X<<m->vars.M)|
+        	     ((aux&INMASK)>>(30-m->vars.M)))
+        	    &INMASK)|signX;
+        }
+      else
+        {
+          m->vars.M-= 30;
+          m->regs.A= (((m->regs.X<<m->vars.M)|
+        	     ((m->regs.A&INMASK)>>(30-m->vars.M)))
+        	    &INMASK)|signA;
+          m->regs.X= (((aux<<m->vars.M)|
+        	     ((m->regs.X&INMASK)>>(30-m->vars.M)))
+        	    &INMASK)|signX;
+        }
+      break;
+      
+      /* SRC */
+    case 5:
+      aux= m->regs.X;
+      signA= m->regs.A&NMASK;
+      signX= m->regs.X&NMASK;
+      if ( m->vars.M < 30 )
+        {
+          m->regs.X= ((((m->regs.X&INMASK)>>m->vars.M)|
+        	     (m->regs.A<<(30-m->vars.M)))
+        	    &INMASK)|signX;
+          m->regs.A= ((((m->regs.A&INMASK)>>m->vars.M)|
+        	     (aux<<(30-m->vars.M)))
+        	    &INMASK)|signA;
+        }
+      else
+        {
+          m->vars.M-= 30;
+          m->regs.X= ((((m->regs.A&INMASK)>>m->vars.M)|
+        	     (m->regs.X<<(30-m->vars.M)))
+        	    &INMASK)|signX;
+          m->regs.A= ((((aux&INMASK)>>m->vars.M)|
+        	     (m->regs.A<<(30-m->vars.M)))
+        	    &INMASK)|signA;
+        }
+      break;
+      
+    default:
+      WARNING ( MIX_WARN_OP, "operació C=6 F=%d no vàlida", F );
+      
+    }
+  
+ ret:
+  
+  return 2;
+  
+} /* end shift */
+
+
+static unsigned int
+SHIFT (
+       MIX_Machine *m
+       )
+{
+  return shift ( m, READ_F );
+} /* end SHIFT */
+
+
+/* Esta instrucció es tan costosa que podria executar-se de manera no
+   atòmica a al vegada que es fan operacions d'entrada eixida. Però
+   com manipula memòria interna (s'enten que anirà molt ràpid), el
+   màxim són 63 paraules i a més normlament sol ser 1, aleshores, ho
+   faré de manera atòmica. */
+static unsigned int
+MOVE (
+      MIX_Machine *m
+      )
+{
+  
+  int F, I1, f;
+  
+  
+  F= READ_F;
+  if ( F == 0 ) return 1;
+  calc_M ( m );
+  I1= m->regs.I[0];
+  if ( IS_NEG ( I1 ) )
+    {
+      WARNING ( MIX_WARN_ADDRESS, "el valor de I1 és negatiu,"
+                " s'interpretarà com positiu per a"
+                " executar MOVE" );
+      I1&= INMASK;
+    }
+  if ( I1 > 3999 )
+    {
+      WARNING ( MIX_WARN_ADDRESS,
+                "valor de I1=%d no vàlid per a MOVE", I1 );
+      I1= 3999;
+    }
+  for ( f= 0; f < F; ++f )
+    {
+      m->mem[I1]= m->mem[m->vars.M];
+      ST_WRITTEN ( I1 );
+      if ( ++I1 == 4000 ) I1= 0;
+      if ( ++m->vars.M == 4000 ) m->vars.M= 0;
+    }
+  m->regs.I[0]= (MIXu32) I1;
+  
+  return (unsigned int) ((F<<1)|0x1);
+  
+} /* end MOVE */
+
+
+static unsigned int
+NOP (
+     MIX_Machine *m
+     )
+{
+  
+  (void) m;
+  
+  return 1;
+  
+} /* end NOP */
+
+
+static unsigned int
+IN (
+    MIX_Machine *m
+    )
+{
+  inout ( m, MIX_IN );
+  return 1;
+} /* end IN */
+
+
+static unsigned int
+OUT (
+     MIX_Machine *m
+     )
+{
+  inout ( m, MIX_OUT );
+  return 1;
+} /* end OUT */
+
+
+static unsigned int
+JRED (
+      MIX_Machine *m
+      )
+{
+  jbusy ( m, MIX_FALSE );
+  return 1;
+} /* end JRED */
+
+
+static unsigned int
+JBUS (
+      MIX_Machine *m
+      )
+{
+  jbusy ( m, MIX_TRUE );
+  return 1;
+} /* end JBUS */
+
+
+static unsigned int
+IOC (
+     MIX_Machine *m
+     )
+{
+  
+  int dev;
+  
+  
+  dev= READ_F;
+  CHECK_DEV_BASE ( dev, return 0 );
+    if ( dev_busy ( m, dev ) )
+    {
+      m->regs.PC= m->regs.old_PC;
+      m->run_state.v= WAIT_DEVICE;
+      m->run_state.dev= dev;
+      m->run_state.busy= MIX_TRUE;
+      m->run_state.spin= -1;
+      m->run_state.spinning= false;
+      m->notify_waiting_device ( m->udata, dev, true );
+      --m->insts; // Es tornarà a executar
+      if ( m->counting ) --m->ctr.ops[35];
+      return 0;
+    }
+  calc_M_val ( m );
+  if ( m->timeline != NULL )
+    timeline_io ( m, dev, TL_IOC, m->vars.M,
+                  dev >= MIX_DISKORDRUMUNIT1 && dev < MIX_CARDREADER ?
+                  (long) (m->regs.X&INMASK) : 0 );
+  switch ( dev )
+    {
+    case MIX_TAPEUNIT1:
+    case MIX_TAPEUNIT2:
+    case MIX_TAPEUNIT3:
+    case MIX_TAPEUNIT4:
+    case MIX_TAPEUNIT5:
+    case MIX_TAPEUNIT6:
+    case MIX_TAPEUNIT7:
+    case MIX_TAPEUNIT8:
+      if ( m->vars.M == 0 )
+        {
+          m->io_control ( m->udata, MIX_MT_REWOUND, dev );
+          sched_start ( m, dev, 0, m->sched.pos[dev] );
+          m->sched.pos[dev]= 0;
+        }
+      else
+        {
+          if ( m->vars.M < 0 )
+            m->io_control ( m->udata, MIX_MT_SKIPBACKWARD, dev,
+                            -m->vars.M*100 );
+          else
+            m->io_control ( m->udata, MIX_MT_SKIPFORWARD, dev,
+                            m->vars.M*100 );
+          sched_start ( m, dev, 0, abs ( m->vars.M ) );
+          m->sched.pos[dev]+= m->vars.M;
+          if ( m->sched.pos[dev] < 0 ) m->sched.pos[dev]= 0;
+        }
+      break;
+    case MIX_DISKORDRUMUNIT1:
+    case MIX_DISKORDRUMUNIT2:
+    case MIX_DISKORDRUMUNIT3:
+    case MIX_DISKORDRUMUNIT4:
+    case MIX_DISKORDRUMUNIT5:
+    case MIX_DISKORDRUMUNIT6:
+    case MIX_DISKORDRUMUNIT7:
+    case MIX_DISKORDRUMUNIT8:
+      if ( m->vars.M != 0 )
+        WARNING ( MIX_WARN_DEVICE, "operació de control (M:%d) no"
+                  " suportada pels discs", m->vars.M );
+      else
+        {
+          m->io_control ( m->udata, MIX_DK_SEEK, dev,
+                          (long) (m->regs.X&INMASK) );
+          if ( m->sched.disk.on )
+            disk_request ( m, dev, (long) (m->regs.X&INMASK), true );
+          else sched_start ( m, dev, 0, 0 );
+        }
+      break;
+    case MIX_LINEPRINTER:
+      if ( m->vars.M != 0 )
+        WARNING ( MIX_WARN_DEVICE, "operació de control (M:%d) no"
+                  " suportada per l'impresora", m->vars.M );
+      else
+        {
+          m->io_control ( m->udata, MIX_LP_SKIPTOFOLLOWINGPAGE );
+          sched_start ( m, dev, 0, 0 );
+        }
+      break;
+    default: WARNING ( MIX_WARN_DEVICE, "el dispositiu %d no suporta"
+                       " operacions de control", dev );
+    }
+  
+  return 1;
+  
+} /* end IOC */
+
+
+static unsigned int
+SPECIAL (
+         MIX_Machine *m
+         )
+{
+  
+  int F;
+  
+  
+  F= READ_F;
+  switch ( F )
+    {
+      
+    case 0: /* NUM */
+      num ( m );
+      break;
+      
+    case 1: /* CHAR */
+      char_op ( m );
+      break;
+      
+    case 2:
+      m->run_state.v= HALT;
+      break;
+      
+    default:
+      WARNING ( MIX_WARN_OP,
+                "operació C=%d F=%d no vàlida",
+                m->vars.d->inst&0x3F, F );
+      
+    }
+  
+  return 10;
+  
+} /* end SPECIAL */
+
+
+static unsigned int (*_insts[64]) (MIX_Machine *)=
+{
+  NOP,
+  ADD,
+  SUB,
+  MUL,
+  DIV,
+  SPECIAL,
+  SHIFT,
+  MOVE,
+  LDA,
+  LD1,
+  LD2,
+  LD3,
+  LD4,
+  LD5,
+  LD6,
+  LDX,
+  LDAN,
+  LD1N,
+  LD2N,
+  LD3N,
+  LD4N,
+  LD5N,
+  LD6N,
+  LDXN,
+  STA,
+  ST1,
+  ST2,
+  ST3,
+  ST4,
+  ST5,
+  ST6,
+  STX,
+  STJ,
+  STZ,
+  JBUS,
+  IOC,
+  IN,
+  OUT,
+  JRED,
+  JOP,
+  JA,
+  J1,
+  J2,
+  J3,
+  J4,
+  J5,
+  J6,
+  JX,
+  MOPA,
+  MOP1,
+  MOP2,
+  MOP3,
+  MOP4,
+  MOP5,
+  MOP6,
+  MOPX,
+  CMPA,
+  CMP1,
+  CMP2,
+  CMP3,
+  CMP4,
+  CMP5,
+  CMP6,
+  CMPX
+};
+
+
+/*********************************/
+/* INSTRUCCIONS ESPECIALITZADES */
+/*********************************/
+
+/* Per a les instruccions on F té un significat fix (camp (L:R),
+ * condició de salt, tipus de desplaçament, etc.) es genera una
+ * implementació per a cada valor vàlid de F, de manera que tota la
+ * lògica que depén de F es resol en temps de compilació. Les
+ * implementacions s'indexen amb els 12 bits de menys pes de la
+ * instrucció (F*64+C) en '_insts_cf'.
+ */
+
+/* Màscara dels bytes d'un camp (L:R) desplaçat a la posició 5. */
+#define FMASK(L,R) (~(0xFFFFFFFF<<(6*((R)-((L)?(L):1)+1))))
+
+/* Camps (L:R) vàlids. */
+#define FIELDS(X,OP,ARG)        					\
+  X(OP,ARG,0) X(OP,ARG,1) X(OP,ARG,2) X(OP,ARG,3) X(OP,ARG,4)        	\
+  X(OP,ARG,5) X(OP,ARG,9) X(OP,ARG,10) X(OP,ARG,11) X(OP,ARG,12)        \
+  X(OP,ARG,13) X(OP,ARG,18) X(OP,ARG,19) X(OP,ARG,20) X(OP,ARG,21)      \
+  X(OP,ARG,27) X(OP,ARG,28) X(OP,ARG,29) X(OP,ARG,36) X(OP,ARG,37)      \
+  X(OP,ARG,45)
+
+/* Valors vàlids de F en INC/DEC/ENT/ENN. */
+#define MOPS(X,OP,ARG)        						\
+  X(OP,ARG,0) X(OP,ARG,1) X(OP,ARG,2) X(OP,ARG,3)
+
+/* Valors vàlids de F en J_N/J_Z/J_P/J_NN/J_NZ/J_NP i en els
+   desplaçaments. */
+#define CONDS(X,OP,ARG)        						\
+  X(OP,ARG,0) X(OP,ARG,1) X(OP,ARG,2) X(OP,ARG,3) X(OP,ARG,4)        	\
+  X(OP,ARG,5)
+
+/* Valors vàlids de F en JMP/JSJ/JOV/JNOV/JL/JE/JG/JGE/JNE/JLE. */
+#define JOPS(X,OP,ARG)        						\
+  CONDS(X,OP,ARG) X(OP,ARG,6) X(OP,ARG,7) X(OP,ARG,8) X(OP,ARG,9)
+
+
+static inline MIXu32
+ld_f (
+      MIX_Machine *m,
+      const int    F
+      )
+{
+  
+  const int L= F>>3, R= F&0x7;
+  MIXu32 data, ret;
+  
+  
+  calc_M ( m );
+  data= GET_DATA;
+  if ( F == 5 ) return data;
+  ret= L == 0 ? data&NMASK : 0;
+  if ( R != 0 ) ret|= (data>>(6*(5-R)))&FMASK ( L, R );
+  
+  return ret;
+  
+} /* end ld_f */
+
+
+static inline void
+st_f (
+      MIX_Machine *m,
+      MIXu32       value,
+      const int    F
+      )
+{
+  
+  const int L= F>>3, R= F&0x7;
+  MIXu32 data, mask;
+  
+  
+  calc_M ( m );
+  if ( F == 5 ) data= value&(NMASK|INMASK);
+  else
+    {
+      data= GET_DATA;
+      if ( L == 0 ) data= (data&INMASK) | (value&NMASK);
+      if ( R != 0 )
+        {
+          mask= FMASK ( L, R )<<(6*(5-R));
+          data= (data&(~mask)) | ((value<<(6*(5-R)))&mask);
+        }
+    }
+  m->mem[m->vars.M]= data;
+  ST_WRITTEN ( m->vars.M );
+  
+} /* end st_f */
+
+
+static inline void
+cmp_f (
+       MIX_Machine *m,
+       MIXu32       value,
+       const int    F
+       )
+{
+  
+  const int L= F>>3, R= F&0x7;
+  MIXu32 data;
+  MIXs32 op1, op2;
+  
+  
+  calc_M ( m );
+  data= GET_DATA;
+  op1= (MIXs32) ((value>>(6*(5-R)))&FMASK ( L, R ));
+  op2= (MIXs32) ((data>>(6*(5-R)))&FMASK ( L, R ));
+  if ( R == 0 ) op1= op2= 0;
+  else if ( L == 0 )
+    {
+      if ( value&NMASK ) op1= -op1;
+      if ( data&NMASK ) op2= -op2;
+    }
+  if ( op1 == op2 ) m->cmp= EQUAL;
+  else if ( op1 < op2 ) m->cmp= LESS;
+  else m->cmp= GREATER;
+  
+} /* end cmp_f */
+
+
+static inline void
+add_f (
+       MIX_Machine *m,
+       const bool   sub,
+       const int    F
+       )
+{
+  
+  MIXs32 op1, op2;
+  
+  
+  op2= (MIXs32) ld_f ( m, F );
+  WORDTOS32 ( op2 );
+  op1= (MIXs32) m->regs.A;
+  WORDTOS32 ( op1 );
+  if ( sub ) op1-= op2;
+  else       op1+= op2;
+  m->regs.A= add_aux ( m, m->regs.A, op1 );
+  
+} /* end add_f */
+
+
+/* Generadors de les implementacions. */
+#define DEF(NAME,F,BODY,CC)        					\
+  static unsigned int NAME##_##F ( MIX_Machine *m )        		\
+  { BODY; return (CC); }
+#define DEF_ADD(OP,SUB,F) DEF ( OP, F, add_f ( m, SUB, F ), 2 )
+#define DEF_LD(OP,REG,F) DEF ( OP, F, (REG)= ld_f ( m, F ), 2 )
+#define DEF_LDI(OP,REG,F) DEF ( OP, F, (REG)= ld_f ( m, F )&IMASK, 2 )
+#define DEF_LDN(OP,REG,F) DEF ( OP, F, (REG)= ld_f ( m, F )^NMASK, 2 )
+#define DEF_LDIN(OP,REG,F)        					\
+  DEF ( OP, F, (REG)= (ld_f ( m, F )^NMASK)&IMASK, 2 )
+#define DEF_ST(OP,VAL,F) DEF ( OP, F, st_f ( m, (VAL), F ), 2 )
+#define DEF_CMP(OP,VAL,F) DEF ( OP, F, cmp_f ( m, (VAL), F ), 2 )
+#define DEF_MOP(OP,REG,F) DEF ( OP, F, (REG)= mop ( m, (REG), F ), 1 )
+#define DEF_MOPI(OP,REG,F)        					\
+  DEF ( OP, F, (REG)= mop ( m, (REG), F )&IMASK, 1 )
+#define DEF_JREG(OP,REG,F) DEF ( OP, F, jreg ( m, (REG), F ), 1 )
+#define DEF_JOP(OP,ARG,F) DEF ( OP, F, (void) 0, jop ( m, F ) )
+#define DEF_SHIFT(OP,ARG,F) DEF ( OP, F, (void) 0, shift ( m, F ) )
+
+FIELDS ( DEF_ADD, ADD, false )
+FIELDS ( DEF_ADD, SUB, true )
+FIELDS ( DEF_LD, LDA, m->regs.A )
+FIELDS ( DEF_LDI, LD1, m->regs.I[0] )
+FIELDS ( DEF_LDI, LD2, m->regs.I[1] )
+FIELDS ( DEF_LDI, LD3, m->regs.I[2] )
+FIELDS ( DEF_LDI, LD4, m->regs.I[3] )
+FIELDS ( DEF_LDI, LD5, m->regs.I[4] )
+FIELDS ( DEF_LDI, LD6, m->regs.I[5] )
+FIELDS ( DEF_LD, LDX, m->regs.X )
+FIELDS ( DEF_LDN, LDAN, m->regs.A )
+FIELDS ( DEF_LDIN, LD1N, m->regs.I[0] )
+FIELDS ( DEF_LDIN, LD2N, m->regs.I[1] )
+FIELDS ( DEF_LDIN, LD3N, m->regs.I[2] )
+FIELDS ( DEF_LDIN, LD4N, m->regs.I[3] )
+FIELDS ( DEF_LDIN, LD5N, m->regs.I[4] )
+FIELDS ( DEF_LDIN, LD6N, m->regs.I[5] )
+FIELDS ( DEF_LDN, LDXN, m->regs.X )
+FIELDS ( DEF_ST, STA, m->regs.A )
+FIELDS ( DEF_ST, ST1, m->regs.I[0] )
+FIELDS ( DEF_ST, ST2, m->regs.I[1] )
+FIELDS ( DEF_ST, ST3, m->regs.I[2] )
+FIELDS ( DEF_ST, ST4, m->regs.I[3] )
+FIELDS ( DEF_ST, ST5, m->regs.I[4] )
+FIELDS ( DEF_ST, ST6, m->regs.I[5] )
+FIELDS ( DEF_ST, STX, m->regs.X )
+FIELDS ( DEF_ST, STJ, m->regs.J )
+FIELDS ( DEF_ST, STZ, 0 )
+JOPS ( DEF_JOP, JOP, 0 )
+CONDS ( DEF_JREG, JA, m->regs.A )
+CONDS ( DEF_JREG, J1, m->regs.I[0] )
+CONDS ( DEF_JREG, J2, m->regs.I[1] )
+CONDS ( DEF_JREG, J3, m->regs.I[2] )
+CONDS ( DEF_JREG, J4, m->regs.I[3] )
+CONDS ( DEF_JREG, J5, m->regs.I[4] )
+CONDS ( DEF_JREG, J6, m->regs.I[5] )
+CONDS ( DEF_JREG, JX, m->regs.X )
+MOPS ( DEF_MOP, MOPA, m->regs.A )
+MOPS ( DEF_MOPI, MOP1, m->regs.I[0] )
+MOPS ( DEF_MOPI, MOP2, m->regs.I[1] )
+MOPS ( DEF_MOPI, MOP3, m->regs.I[2] )
+MOPS ( DEF_MOPI, MOP4, m->regs.I[3] )
+MOPS ( DEF_MOPI, MOP5, m->regs.I[4] )
+MOPS ( DEF_MOPI, MOP6, m->regs.I[5] )
+MOPS ( DEF_MOP, MOPX, m->regs.X )
+FIELDS ( DEF_CMP, CMPA, m->regs.A )
+FIELDS ( DEF_CMP, CMP1, m->regs.I[0] )
+FIELDS ( DEF_CMP, CMP2, m->regs.I[1] )
+FIELDS ( DEF_CMP, CMP3, m->regs.I[2] )
+FIELDS ( DEF_CMP, CMP4, m->regs.I[3] )
+FIELDS ( DEF_CMP, CMP5, m->regs.I[4] )
+FIELDS ( DEF_CMP, CMP6, m->regs.I[5] )
+FIELDS ( DEF_CMP, CMPX, m->regs.X )
+CONDS ( DEF_SHIFT, SHIFT, 0 )
+DEF ( SPECIAL, 0, num ( m ), 10 )
+DEF ( SPECIAL, 1, char_op ( m ), 10 )
+DEF ( SPECIAL, 2, m->run_state.v= HALT, 10 )
+
+
+/* Implementació de totes les combinacions de C i F no vàlides. Totes
+   generen un avís, però l'efecte concret depén de la instrucció (per
+   exemple un camp (L:R) no vàlid s'interpreta com (0:5)), per això es
+   delega en la implementació general. */
+static unsigned int
+INVALID_F (
+           MIX_Machine *m
+           )
+{
+  return _insts[m->vars.d->inst&0x3F] ( m );
+} /* end INVALID_F */
+
+
+static unsigned int (*_insts_cf[64*64]) (MIX_Machine *);
+
+
+static void
+init_insts_cf (void)
+{
+  
+  int C, F;
+  
+  
+  for ( F= 0; F < 64; ++F )
+    for ( C= 0; C < 64; ++C )
+      _insts_cf[(F<<6)|C]= INVALID_F;
+  
+  /* Instruccions que no depenen de F o que no s'especialitzen. */
+  for ( F= 0; F < 64; ++F )
+    {
+      _insts_cf[(F<<6)|0]= NOP;
+      _insts_cf[(F<<6)|7]= MOVE;
+    }
+  for ( F= 0; F <= MIX_PAPERTAPE; ++F )
+    for ( C= 34; C <= 38; ++C )
+      _insts_cf[(F<<6)|C]= _insts[C];
+  
+#define SET_CF(OP,C,F) _insts_cf[((F)<<6)|(C)]= OP##_##F;
+#define SET_GEN(OP,C,F) _insts_cf[((F)<<6)|(C)]= OP;
+  FIELDS ( SET_CF, ADD, 1 )
+  FIELDS ( SET_CF, SUB, 2 )
+  FIELDS ( SET_GEN, MUL, 3 )
+  FIELDS ( SET_GEN, DIV, 4 )
+  SET_CF ( SPECIAL, 5, 0 )
+  SET_CF ( SPECIAL, 5, 1 )
+  SET_CF ( SPECIAL, 5, 2 )
+  CONDS ( SET_CF, SHIFT, 6 )
+  FIELDS ( SET_CF, LDA, 8 )
+  FIELDS ( SET_CF, LD1, 9 )
+  FIELDS ( SET_CF, LD2, 10 )
+  FIELDS ( SET_CF, LD3, 11 )
+  FIELDS ( SET_CF, LD4, 12 )
+  FIELDS ( SET_CF, LD5, 13 )
+  FIELDS ( SET_CF, LD6, 14 )
+  FIELDS ( SET_CF, LDX, 15 )
+  FIELDS ( SET_CF, LDAN, 16 )
+  FIELDS ( SET_CF, LD1N, 17 )
+  FIELDS ( SET_CF, LD2N, 18 )
+  FIELDS ( SET_CF, LD3N, 19 )
+  FIELDS ( SET_CF, LD4N, 20 )
+  FIELDS ( SET_CF, LD5N, 21 )
+  FIELDS ( SET_CF, LD6N, 22 )
+  FIELDS ( SET_CF, LDXN, 23 )
+  FIELDS ( SET_CF, STA, 24 )
+  FIELDS ( SET_CF, ST1, 25 )
+  FIELDS ( SET_CF, ST2, 26 )
+  FIELDS ( SET_CF, ST3, 27 )
+  FIELDS ( SET_CF, ST4, 28 )
+  FIELDS ( SET_CF, ST5, 29 )
+  FIELDS ( SET_CF, ST6, 30 )
+  FIELDS ( SET_CF, STX, 31 )
+  FIELDS ( SET_CF, STJ, 32 )
+  FIELDS ( SET_CF, STZ, 33 )
+  JOPS ( SET_CF, JOP, 39 )
+  CONDS ( SET_CF, JA, 40 )
+  CONDS ( SET_CF, J1, 41 )
+  CONDS ( SET_CF, J2, 42 )
+  CONDS ( SET_CF, J3, 43 )
+  CONDS ( SET_CF, J4, 44 )
+  CONDS ( SET_CF, J5, 45 )
+  CONDS ( SET_CF, J6, 46 )
+  CONDS ( SET_CF, JX, 47 )
+  MOPS ( SET_CF, MOPA, 48 )
+  MOPS ( SET_CF, MOP1, 49 )
+  MOPS ( SET_CF, MOP2, 50 )
+  MOPS ( SET_CF, MOP3, 51 )
+  MOPS ( SET_CF, MOP4, 52 )
+  MOPS ( SET_CF, MOP5, 53 )
+  MOPS ( SET_CF, MOP6, 54 )
+  MOPS ( SET_CF, MOPX, 55 )
+  FIELDS ( SET_CF, CMPA, 56 )
+  FIELDS ( SET_CF, CMP1, 57 )
+  FIELDS ( SET_CF, CMP2, 58 )
+  FIELDS ( SET_CF, CMP3, 59 )
+  FIELDS ( SET_CF, CMP4, 60 )
+  FIELDS ( SET_CF, CMP5, 61 )
+  FIELDS ( SET_CF, CMP6, 62 )
+  FIELDS ( SET_CF, CMPX, 63 )
+#undef SET_CF
+#undef SET_GEN
+  
+} /* end init_insts_cf */
+
+
+/* Descodifica la instrucció de l'adreça indicada. */
+static void
+decode (
+        MIX_Machine *m,
+        int          addr
+        )
+{
+  
+  decoded_t *d;
+  MIXu32 inst;
+  int I, L, R;
+  
+  
+  d= &(m->dec[addr]);
+  inst= m->mem[addr];
+  d->inst= inst;
+  d->op= _insts_cf[inst&0xFFF];
+  d->F= (inst>>6)&0x3F;
+  I= (inst>>12)&0x3F;
+  d->bad_I= (I > 6);
+  d->I= d->bad_I ? 6 : I;
+  CALC_ADDR ( inst, d->addr );
+  L= d->F>>3;
+  R= d->F&0x7;
+  d->bad_F= ( L > 5 || R > 5 || L > R );
+  if ( d->bad_F ) { L= 0; R= 5; }
+  d->sign= (L == 0);
+  if ( L == 0 ) L= 1;
+  d->shift= 6*(5-R);
+  d->mask= R != 0 ? ~(0xFFFFFFFF<<(6*(R-L+1))) : 0;
+  m->code[addr]|= CODE_DECODED;
+  
+} /* end decode */
+
+
+/* Anota en els comptadors una execució de D que ha costat CC
+   cicles. */
+static inline void
+count_inst (
+            MIX_Machine     *m,
+            const decoded_t *d,
+            const int        cc
+            )
+{
+  
+  int C;
+  
+  
+  if ( !m->counting ) return;
+  C= d->inst&0x3F;
+  ++m->ctr.ops[C];
+  m->ctr.cycles[C]+= (unsigned long long) cc;
+  if ( C == 5 || C == 6 ) ++m->ctr.ops_f[C-5][d->F];
+  else if ( C == 39 ) ++m->ctr.ops_f[2][d->F];
+  
+} /* end count_inst */
+
+
+/* Anota en els comptadors els CC cicles que s'acaben de consumir en
+   un bucle d'espera (vore spin_wait i prof_spin). */
+static void
+count_spin (
+            MIX_Machine *m,
+            const int    cc
+            )
+{
+  
+  int jmp, loop, first, n, C;
+  
+  
+  if ( !m->counting ) return;
+  if ( m->run_state.spin == -1 ) // JBUS/JRED que salta a ell mateix
+    {
+      C= m->mem[m->regs.PC]&0x3F;
+      m->ctr.ops[C]+= (unsigned long long) cc;
+      m->ctr.cycles[C]+= (unsigned long long) cc;
+      return;
+    }
+  
+  // JBUS/JRED en 'loop' que no salta i JMP en 'jmp'.
+  jmp= m->run_state.spin;
+  loop= (m->mem[jmp]>>18)&0xFFF;
+  if ( cc%2 ) first= m->regs.PC == jmp ? loop : jmp;
+  else        first= m->regs.PC;
+  n= first == loop ? (cc+1)/2 : cc/2;
+  C= m->mem[loop]&0x3F;
+  m->ctr.ops[C]+= (unsigned long long) n;
+  m->ctr.cycles[C]+= (unsigned long long) n;
+  m->ctr.ops[39]+= (unsigned long long) (cc-n);
+  m->ctr.ops_f[2][0]+= (unsigned long long) (cc-n);
+  m->ctr.cycles[39]+= (unsigned long long) (cc-n);
+  
+} /* end count_spin */
+
+
+/* Executa la instrucció de PC. Torna els cicles. */
+static unsigned int
+step (
+      MIX_Machine *m
+      )
+{
+  
+  const decoded_t *d;
+  unsigned int cc;
+  
+  
+  m->regs.old_PC= m->regs.PC;
+  if ( !(m->code[m->regs.PC]&CODE_DECODED) )
+    decode ( m, m->regs.PC );
+  d= &(m->dec[m->regs.PC]);
+  m->vars.d= d;
+  if ( ++m->regs.PC == 4000 ) m->regs.PC= 0;
+  ++m->insts;
+  cc= d->op ( m );
+  count_inst ( m, d, (int) cc );
+  
+  return cc;
+  
+} /* end step */
+
+
+#ifdef THREADED_DISPATCH
+
+/* Motor d'execució amb 'threaded dispatch'. Cada instrucció
+ * descodificada guarda l'adreça de l'etiqueta que l'implementa i
+ * salta directament a la següent sense tornar al bucle de
+ * MIX_machine_iter. Els registres es mantenen en variables locals
+ * mentre s'executa, només es bolquen a la màquina per a cridar a les
+ * implementacions generals de les instruccions menys freqüents o que
+ * tenen efectes sobre el simulador (i/o, HLT, avisos, etc.).
+ *
+ * Es pot desactivar definint MIX_NO_THREADED_DISPATCH, en eixe cas
+ * s'executa una instrucció per iteració del bucle de
+ * MIX_machine_iter.
+ */
+
+/* Valor amb signe d'un registre índex. */
+#define IVAL(REG)        					\
+  (IS_NEG ( REG ) ? -(int) ((REG)&0xFFF) : (int) ((REG)&0xFFF))
+
+
+/* Superinstruccions. Les etiquetes van després de la implementació
+   general en la taula del motor 'threaded'. */
+#define FUSE_MOP_JREG 65 // INCr/DECr + Jr, r= A,1-6,X
+#define FUSE_LD_CMP_JOP (FUSE_MOP_JREG+8) // LDr + CMPr + JL-JLE, r= A,X
+#define FUSE_ST_MOP_JREG (FUSE_LD_CMP_JOP+2) // ST + INCi/DECi + Ji
+#define FUSE_LABELS (FUSE_ST_MOP_JREG+6)
+
+/* Etiquetes per on passen les instruccions mentre es traça, després
+   de les superinstruccions: una per cada TRACE_* i l'última per a les
+   que no es traça. */
+#define TRACE_LABEL FUSE_LABELS
+#define NUM_LABELS (TRACE_LABEL+TRACE_NONE+2)
+
+
+/* Torna la instrucció de l'adreça indicada descodificada. */
+static const decoded_t *
+get_decoded (
+             MIX_Machine *m,
+             const int    addr
+             )
+{
+  
+  if ( !(m->code[addr]&CODE_DECODED) )
+    decode ( m, addr );
+  
+  return &(m->dec[addr]);
+  
+} /* end get_decoded */
+
+
+/* Indica si la instrucció té una implementació específica en el motor
+   'threaded'. */
+static bool
+is_fast (
+         const decoded_t *d
+         )
+{
+  
+  int C;
+  bool slow;
+  
+  
+  C= d->inst&0x3F;
+  if ( (C >= 1 && C <= 4) || (C >= 8 && C <= 33) || C >= 56 )
+    slow= d->bad_F;
+  else if ( C == 39 ) slow= (d->F > 9);
+  else if ( C >= 40 && C <= 47 ) slow= (d->F > 5);
+  else if ( C >= 48 && C <= 55 ) slow= (d->F > 3);
+  else slow= false;
+  
+  return !slow && !d->bad_I && C != 3 && C != 4 && (C < 5 || C > 7) &&
+    (C < 34 || C > 38);
+  
+} /* end is_fast */
+
+
+/* Busca una superinstrucció que comence en ADDR. Torna l'índex de
+   l'etiqueta o -1. */
+static int
+find_fusion (
+             MIX_Machine     *m,
+             const int        addr,
+             const decoded_t *d
+             )
+{
+  
+  const decoded_t *d2, *d3;
+  int C, C2, C3, r;
+  
+  
+  if ( addr > 3997 ) return -1;
+  C= d->inst&0x3F;
+  if ( !(C >= 48 && C <= 55 && d->F < 2) &&
+       !(C == 8 || C == 15) &&
+       !(C >= 24 && C <= 33) )
+    return -1;
+  d2= get_decoded ( m, addr+1 );
+  if ( !is_fast ( d2 ) ) return -1;
+  C2= d2->inst&0x3F;
+  
+  /* INCr/DECr + Jr. */
+  if ( C >= 48 )
+    return C2 == C-8 ? FUSE_MOP_JREG + C-48 : -1;
+  
+  d3= get_decoded ( m, addr+2 );
+  if ( !is_fast ( d3 ) ) return -1;
+  C3= d3->inst&0x3F;
+  
+  /* LDr + CMPr + JL-JLE. */
+  if ( C <= 15 )
+    return (C2 == C+48 && C3 == 39 && d3->F >= 4) ?
+      FUSE_LD_CMP_JOP + (C == 15) : -1;
+  
+  /* ST + INCi/DECi + Ji. */
+  r= C2-48;
+  if ( r >= 1 && r <= 6 && d2->F < 2 && C3 == 40+r )
+    return FUSE_ST_MOP_JREG + r-1;
+  
+  return -1;
+  
+} /* end find_fusion */
+
+
+#ifdef LOOP_ACCEL
+
+/* Bucles comptats. Són les superinstruccions INCr/DECr + Jr i ST +
+ * INCi/DECi + Ji on el salt torna a la primera instrucció, el
+ * increment és constant i, en el segon cas, l'adreça de
+ * l'emmagatzematge està indexada per i i el valor no canvia. El
+ * número d'iteracions es calcula directament i s'executen totes de
+ * colp, amb els mateixos cicles que una a una.
+ */
+
+/* Valor gran per a intervals no fitats. */
+#define LOOP_INF (1LL<<40)
+
+
+/* Indica si la superinstrucció FUSE que comença en ADDR és un bucle
+   comptat. */
+static bool
+is_counted_loop (
+        	 MIX_Machine *m,
+        	 const int    addr,
+        	 const int    fuse
+        	 )
+{
+  
+  const decoded_t *st, *mop, *jmp;
+  int C;
+  
+  
+  if ( fuse >= FUSE_ST_MOP_JREG )
+    {
+      st= &(m->dec[addr]);
+      mop= &(m->dec[addr+1]);
+      jmp= &(m->dec[addr+2]);
+      C= st->inst&0x3F;
+      if ( st->I != (int) (mop->inst&0x3F)-48 || C == 24+st->I || C == 32 )
+        return false;
+    }
+  else if ( fuse < FUSE_LD_CMP_JOP )
+    {
+      mop= &(m->dec[addr]);
+      jmp= &(m->dec[addr+1]);
+    }
+  else return false;
+  
+  return mop->I == 0 && mop->addr != 0 && jmp->I == 0 && jmp->addr == addr;
+  
+} /* end is_counted_loop */
+
+
+/* Torna el número d'iteracions i >= 0 consecutives amb
+   V0+i*DELTA dins de [LO,HI]. */
+static long long
+loop_span (
+           const long long v0,
+           const long long delta,
+           const long long lo,
+           const long long hi
+           )
+{
+  
+  if ( v0 < lo || v0 > hi ) return 0;
+  
+  return delta > 0 ? (hi-v0)/delta + 1 : (v0-lo)/(-delta) + 1;
+  
+} /* end loop_span */
+
+
+/* Executa de colp les iteracions del bucle comptat que comença en
+ * HEAD que es farien amb CC cicles, sense contar l'última (la que no
+ * salta), que s'executa normalment. REG és el valor del registre del
+ * bucle i VALUE el valor que s'emmagatzema. Torna el nou valor de REG
+ * i en ITERS el número d'iteracions executades (pot ser 0).
+ */
+static MIXu32
+counted_loop (
+              MIX_Machine  *m,
+              const int     head,
+              const MIXu32  reg,
+              const MIXu32  value,
+              const int     cc,
+              int          *iters
+              )
+{
+  
+  const decoded_t *st, *mop, *jmp;
+  long long v0, w1, w, delta, n, tmp, max, a0, lo, hi;
+  MIXu32 data, mask;
+  int C, a, i, cc_iter;
+  
+  
+  /* Instruccions. */
+  if ( (m->dec[head].inst&0x3F) < 48 )
+    {
+      st= &(m->dec[head]);
+      mop= &(m->dec[head+1]);
+      jmp= &(m->dec[head+2]);
+      cc_iter= 4;
+    }
+  else
+    {
+      st= NULL;
+      mop= &(m->dec[head]);
+      jmp= &(m->dec[head+1]);
+      cc_iter= 2;
+    }
+  C= mop->inst&0x3F;
+  max= (C == 48 || C == 55) ? INMASK : 0xFFF;
+  
+  /* Iteracions que salten. */
+  v0= (long long) (reg&INMASK);
+  if ( IS_NEG ( reg ) ) v0= -v0;
+  delta= mop->F ? -mop->addr : mop->addr;
+  w1= v0 + delta;
+  switch ( jmp->F )
+    {
+    case 0: n= loop_span ( w1, delta, -LOOP_INF, -1 ); break; // JrN
+    case 1: n= loop_span ( w1, delta, 0, 0 ); break; // JrZ
+    case 2: n= loop_span ( w1, delta, 1, LOOP_INF ); break; // JrP
+    case 3: n= loop_span ( w1, delta, 0, LOOP_INF ); break; // JrNN
+    case 4: // JrNZ
+      if ( w1 != 0 && (w1 < 0) == (delta > 0) && w1%delta == 0 )
+        n= -w1/delta;
+      else n= w1 == 0 ? 0 : LOOP_INF;
+      break;
+    default: n= loop_span ( w1, delta, -LOOP_INF, 0 ); break; // JrNP
+    }
+  
+  /* Límits: cicles, rang del registre i adreces fora del codi del
+     bucle. */
+  if ( n > cc/cc_iter ) n= cc/cc_iter;
+  tmp= loop_span ( v0, delta, -max, max ) - 1;
+  if ( n > tmp ) n= tmp;
+  if ( st != NULL )
+    {
+      a0= st->addr + v0;
+      if ( a0 < head ) { lo= 0; hi= head-1; }
+      else { lo= head+3; hi= 3999; }
+      tmp= loop_span ( a0, delta, lo, hi );
+      if ( n > tmp ) n= tmp;
+    }
+  if ( n <= 0 ) { *iters= 0; return reg; }
+  
+  /* Emmagatzematges. */
+  if ( st != NULL )
+    {
+      mask= st->mask<<st->shift;
+      for ( i= 0, a= (int) a0; i < n; ++i, a+= (int) delta )
+        {
+          data= m->mem[a];
+          if ( st->sign ) data= (data&INMASK) | (value&NMASK);
+          m->mem[a]= (data&(~mask)) | ((value<<st->shift)&mask);
+          ST_WRITTEN ( a );
+        }
+    }
+  *iters= (int) n;
+  
+  /* Valor final. Si és 0 el signe és el de l'anterior, -DELTA. */
+  w= v0 + n*delta;
+  if ( w == 0 ) return delta > 0 ? NMASK : 0;
+  else if ( w < 0 ) return NMASK | (MIXu32) (-w);
+  else return (MIXu32) w;
+  
+} /* end counted_loop */
+
+#endif /* LOOP_ACCEL */
+
+
+/* Prepara la instrucció de l'adreça indicada per a ser executada pel
+   motor 'threaded'. LABELS té NUM_LABELS entrades, la 64 és la
+   implementació general, després van les superinstruccions i les de
+   la traça. Mentre es traça no es fusionen instruccions, la
+   instrucció salta a l'etiqueta de la traça del seu TRACE_* i la
+   seua pròpia es guarda en la traça. */
+static void
+prepare_threaded (
+        	  MIX_Machine       *m,
+        	  const int          addr,
+        	  const void *const *labels
+        	  )
+{
+  
+  decoded_t *d;
+  int fuse, k;
+  
+  
+  d= (decoded_t *) get_decoded ( m, addr );
+  d->loop= false;
+  if ( !is_fast ( d ) )
+    d->label= labels[64];
+  else if ( m->trace == NULL && (fuse= find_fusion ( m, addr, d )) != -1 )
+    {
+      d->label= labels[fuse];
+      m->code[addr+1]|= CODE_FUSED;
+      if ( fuse >= FUSE_LD_CMP_JOP ) m->code[addr+2]|= CODE_FUSED;
+#ifdef LOOP_ACCEL
+      d->loop= is_counted_loop ( m, addr, fuse );
+#endif
+    }
+  else d->label= labels[d->inst&0x3F];
+  if ( m->trace != NULL )
+    {
+      m->trace->label[addr]= d->label;
+      trace_select ( m, addr );
+      k= m->trace->sel[addr];
+      d->label= labels[TRACE_LABEL+(k == TRACE_OFF ? TRACE_NONE+1 : k)];
+    }
+  m->code[addr]|= CODE_THREADED;
+  
+} /* end prepare_threaded */
+
+
+/* Evita que GCC fusione tots els salts indirectes en un de sol. */
+#if defined(__GNUC__) && !defined(__clang__)
+__attribute__((optimize("no-crossjumping","no-gcse")))
+#endif
+static int
+run_threaded (
+              MIX_Machine *m,
+              const int    cc
+              )
+{
+
+  static const void *const labels[NUM_LABELS]=
+    {
+      &&l_NOP, &&l_ADD, &&l_SUB, &&l_slow,
+      &&l_slow, &&l_slow, &&l_slow, &&l_slow,
+      &&l_LDA, &&l_LD1, &&l_LD2, &&l_LD3,
+      &&l_LD4, &&l_LD5, &&l_LD6, &&l_LDX,
+      &&l_LDAN, &&l_LD1N, &&l_LD2N, &&l_LD3N,
+      &&l_LD4N, &&l_LD5N, &&l_LD6N, &&l_LDXN,
+      &&l_STA, &&l_ST1, &&l_ST2, &&l_ST3,
+      &&l_ST4, &&l_ST5, &&l_ST6, &&l_STX,
+      &&l_STJ, &&l_STZ, &&l_slow, &&l_slow,
+      &&l_slow, &&l_slow, &&l_slow, &&l_JOP,
+      &&l_JA, &&l_J1, &&l_J2, &&l_J3,
+      &&l_J4, &&l_J5, &&l_J6, &&l_JX,
+      &&l_MOPA, &&l_MOP1, &&l_MOP2, &&l_MOP3,
+      &&l_MOP4, &&l_MOP5, &&l_MOP6, &&l_MOPX,
+      &&l_CMPA, &&l_CMP1, &&l_CMP2, &&l_CMP3,
+      &&l_CMP4, &&l_CMP5, &&l_CMP6, &&l_CMPX,
+      &&l_slow,
+      &&l_MOPA_JA, &&l_MOP1_J1, &&l_MOP2_J2, &&l_MOP3_J3,
+      &&l_MOP4_J4, &&l_MOP5_J5, &&l_MOP6_J6, &&l_MOPX_JX,
+      &&l_LDA_CMPA_JOP, &&l_LDX_CMPX_JOP,
+      &&l_ST_MOP1_J1, &&l_ST_MOP2_J2, &&l_ST_MOP3_J3,
+      &&l_ST_MOP4_J4, &&l_ST_MOP5_J5, &&l_ST_MOP6_J6,
+      &&l_trace_A, &&l_trace_I1, &&l_trace_I2, &&l_trace_I3,
+      &&l_trace_I4, &&l_trace_I5, &&l_trace_I6, &&l_trace_X,
+      &&l_trace_J, &&l_trace_MEM, &&l_trace_NONE, &&l_trace_CMP,
+      &&l_trace_NONE, &&l_trace_off
+    };
+  
+  const decoded_t *d;
+  MIXu32 A, X, J, I[7], data, value, mask;
+  MIXs32 op1, op2;
+  int PC, old_PC, M, cc_remain;
+  bool jump;
+  uint64_t insts;
+  trace_t *t;
+  MIX_TraceRecord *r;
+  MIXu32 t_old;
+  overflow_t t_ov;
+  int t_k, t_cc;
+  uint64_t t_end;
+#ifdef LOOP_ACCEL
+  int iters;
+#endif
+  
+  
+  /* Registres. I[0] sempre val 0 i s'utilitza per a les instruccions
+     sense índex. */
+#define LOAD_REGS        						\
+  A= m->regs.A; X= m->regs.X; J= m->regs.J; PC= m->regs.PC;        	\
+  I[1]= m->regs.I[0]; I[2]= m->regs.I[1]; I[3]= m->regs.I[2];        	\
+  I[4]= m->regs.I[3]; I[5]= m->regs.I[4]; I[6]= m->regs.I[5]
+#define SAVE_REGS        						\
+  m->regs.A= A; m->regs.X= X; m->regs.J= J; m->regs.PC= PC;        	\
+  m->regs.old_PC= old_PC;        					\
+  m->regs.I[0]= I[1]; m->regs.I[1]= I[2]; m->regs.I[2]= I[3];        	\
+  m->regs.I[3]= I[4]; m->regs.I[4]= I[5]; m->regs.I[5]= I[6]
+  
+  /* Control. */
+#define DISPATCH        						\
+  old_PC= PC;        							\
+  if ( !(m->code[PC]&CODE_THREADED) )        				\
+    prepare_threaded ( m, PC, labels );        				\
+  d= &(m->dec[PC]);        						\
+  if ( ++PC == 4000 ) PC= 0;        					\
+  goto *d->label
+#define NEXT(CC)        						\
+  ++insts;        							\
+  cc_remain-= (CC);        						\
+  if ( cc_remain <= 0 ) goto out;        				\
+  DISPATCH
+  
+  /* Pas a la següent instrucció d'una superinstrucció. Com que ja està
+     preparada no cal consultar 'code' ni saltar. */
+#define NEXT_FUSED(CC)        						\
+  ++insts;        							\
+  cc_remain-= (CC);        						\
+  if ( cc_remain <= 0 ) goto out;        				\
+  old_PC= PC;        							\
+  d= &(m->dec[PC]);        						\
+  if ( ++PC == 4000 ) PC= 0
+  
+  /* Operands. Si M està fora de rang s'executa la implementació
+     general, que és la que genera l'avís. Per tant T_CALC_M s'ha de
+     fer abans de modificar cap registre. */
+#define T_CALC_M_VAL        						\
+  M= d->addr + IVAL ( I[d->I] )
+#define T_CALC_M        						\
+  T_CALC_M_VAL;        							\
+  if ( M < 0 || M > 3999 ) goto l_slow
+#define T_LD(VAR)        						\
+  T_CALC_M;        							\
+  data= m->mem[M];        						\
+  (VAR)= ((d->sign ? data&NMASK : 0) | ((data>>d->shift)&d->mask))
+  
+  /* Instruccions. */
+#define T_ADD(OP)        						\
+  T_LD ( value );        						\
+  op2= (MIXs32) value; WORDTOS32 ( op2 );        			\
+  op1= (MIXs32) A; WORDTOS32 ( op1 );        				\
+  op1 OP op2;        							\
+  A= add_aux ( m, A, op1 );        					\
+  NEXT ( 2 )
+#define T_LDR(REG)        						\
+  T_LD ( REG ); NEXT ( 2 )
+#define T_LDI(REG)        						\
+  T_LD ( REG ); (REG)&= IMASK; NEXT ( 2 )
+#define T_LDRN(REG)        						\
+  T_LD ( REG ); (REG)^= NMASK; NEXT ( 2 )
+#define T_LDIN(REG)        						\
+  T_LD ( REG ); (REG)= ((REG)^NMASK)&IMASK; NEXT ( 2 )
+#define T_ST_BODY(VAL)        						\
+  T_CALC_M;        							\
+  value= (VAL);        							\
+  data= m->mem[M];        						\
+  if ( d->sign ) data= (data&INMASK) | (value&NMASK);        		\
+  mask= d->mask<<d->shift;        					\
+  m->mem[M]= (data&(~mask)) | ((value<<d->shift)&mask);        		\
+  ST_WRITTEN ( M )
+#define T_ST(VAL)        						\
+  T_ST_BODY ( VAL ); NEXT ( 2 )
+#define T_JREG_BODY(REG)        					\
+  T_CALC_M;        							\
+  op1= (MIXs32) (REG); WORDTOS32 ( op1 );        			\
+  switch ( d->F )        						\
+    {        								\
+    case 0: jump= (op1 < 0); break;        				\
+    case 1: jump= (op1 == 0); break;        				\
+    case 2: jump= (op1 > 0); break;        				\
+    case 3: jump= (op1 >= 0); break;        				\
+    case 4: jump= (op1 != 0); break;        				\
+    default: jump= (op1 <= 0); break;        				\
+    }        								\
+  if ( jump )        							\
+    {        								\
+      J= (MIXu32) PC;        						\
+      PC= M;        							\
+    }
+#define T_JREG(REG)        						\
+  T_JREG_BODY ( REG ); NEXT ( 1 )
+#define T_MOP_BODY(REG,MASK)        					\
+  T_CALC_M_VAL;        							\
+  switch ( d->F )        						\
+    {        								\
+    case 0:        							\
+    case 1:        							\
+      op1= (MIXs32) (REG); WORDTOS32 ( op1 );        			\
+      (REG)= add_aux ( m, (REG), op1 + (d->F ? -M : M) );        	\
+      break;        							\
+    default:        							\
+      if ( M == 0 ) (REG)= d->inst&NMASK;        			\
+      else if ( M < 0 ) (REG)= NMASK|(MIXu32) (-M);        		\
+      else (REG)= (MIXu32) M;        					\
+      if ( d->F == 3 ) (REG)^= NMASK;        				\
+      break;        							\
+    }        								\
+  (REG)&= (MASK)
+#define T_MOP(REG,MASK)        						\
+  T_MOP_BODY ( REG, MASK ); NEXT ( 1 )
+#define T_CMP_BODY(REG)        						\
+  T_CALC_M;        							\
+  data= m->mem[M];        						\
+  op1= ((REG)>>d->shift)&d->mask;        				\
+  op2= (data>>d->shift)&d->mask;        				\
+  if ( d->sign )        						\
+    {        								\
+      if ( (REG)&NMASK ) op1= -op1;        				\
+      if ( data&NMASK ) op2= -op2;        				\
+    }        								\
+  m->cmp= op1 == op2 ? EQUAL : (op1 < op2 ? LESS : GREATER)
+#define T_CMP(REG)        						\
+  T_CMP_BODY ( REG ); NEXT ( 2 )
+#define T_JOP_BODY        						\
+  T_CALC_M;        							\
+  switch ( d->F )        						\
+    {        								\
+    case 0: jump= true; break; /* JMP */        			\
+    case 1: jump= true; break; /* JSJ */        			\
+    case 2: /* JOV */        						\
+      jump= (m->overflow == ON);        				\
+      if ( jump ) m->overflow= OFF;        				\
+      break;        							\
+    case 3: /* JNOV */        						\
+      jump= (m->overflow == OFF);        				\
+      if ( !jump ) m->overflow= OFF;        				\
+      break;        							\
+    case 4: jump= (m->cmp == LESS); break; /* JL */        		\
+    case 5: jump= (m->cmp == EQUAL); break; /* JE */        		\
+    case 6: jump= (m->cmp == GREATER); break; /* JG */        		\
+    case 7: jump= (m->cmp != LESS); break; /* JGE */        		\
+    case 8: jump= (m->cmp != EQUAL); break; /* JNE */        		\
+    default: jump= (m->cmp != GREATER); break; /* JLE */        	\
+    }        								\
+  if ( jump )        							\
+    {        								\
+      if ( d->F != 1 ) J= (MIXu32) PC;        				\
+      PC= M;        							\
+    }
+  
+  /* Bucle comptat de LEN instruccions i CC cicles per iteració. Es
+     continua en la primera instrucció del bucle. */
+#ifdef LOOP_ACCEL
+#define T_LOOP(REG,VALUE,LEN,CC)        				\
+  if ( d->loop )        						\
+    {        								\
+      (REG)= counted_loop ( m, old_PC, (REG), (VALUE),        		\
+        		    cc_remain, &iters );        		\
+      if ( iters > 0 )        						\
+        {        							\
+          J= (MIXu32) (old_PC+(LEN) == 4000 ? 0 : old_PC+(LEN));        \
+          PC= old_PC;        						\
+          old_PC+= (LEN)-1;        					\
+          insts+= (uint64_t) iters*(LEN) - 1;        			\
+          NEXT ( iters*(CC) );        					\
+        }        							\
+    }
+#else
+#define T_LOOP(REG,VALUE,LEN,CC)
+#endif
+  
+  /* Superinstruccions. Cada part es comporta igual que la instrucció
+     sola, inclosos els cicles i el pas a la implementació general. */
+#define T_MOP_JREG(REG,MASK)        					\
+  ++m->fusion_hits[MIX_FUSION_MOP_JREG];        			\
+  T_LOOP ( REG, 0, 2, 2 );        					\
+  T_MOP_BODY ( REG, MASK );        					\
+  NEXT_FUSED ( 1 );        						\
+  T_JREG ( REG )
+#define T_LD_CMP_JOP(REG)        					\
+  ++m->fusion_hits[MIX_FUSION_LD_CMP_JOP];        			\
+  T_LD ( REG );        							\
+  NEXT_FUSED ( 2 );        						\
+  T_CMP_BODY ( REG );        						\
+  NEXT_FUSED ( 2 );        						\
+  T_JOP_BODY;        							\
+  NEXT ( 1 )
+  /* L'emmagatzematge pot modificar la mateixa superinstrucció. */
+#define T_ST_MOP_JREG(REG)        					\
+  ++m->fusion_hits[MIX_FUSION_ST_MOP_JREG];        			\
+  switch ( d->inst&0x3F )        					\
+    {        								\
+    case 24: value= A; break;        					\
+    case 31: value= X; break;        					\
+    case 32: value= J; break;        					\
+    case 33: value= 0; break;        					\
+    default: value= I[(d->inst&0x3F)-24]; break;        		\
+    }        								\
+  T_LOOP ( REG, value, 3, 4 );        					\
+  T_ST_BODY ( value );        						\
+  if ( !(m->code[old_PC]&CODE_THREADED) ) { NEXT ( 2 ); }        	\
+  NEXT_FUSED ( 2 );        						\
+  T_MOP_BODY ( REG, IMASK );        					\
+  NEXT_FUSED ( 1 );        						\
+  T_JREG ( REG )
+  
+  /* Traça. Mentre es traça totes les instruccions passen per una
+     etiqueta l_trace_*, que completa el registre de l'anterior,
+     comença el de la que toca i salta a la seua implementació. Hi ha
+     una etiqueta per cada TRACE_* perquè el destí d'esta instrucció
+     es conega sense consultar-lo; el de l'anterior està en t_k. M és
+     l'adreça de l'última ST, també si l'ha feta l_slow. */
+#define T_TRACE_GET(VAR)        						\
+  switch ( t_k )        						\
+    {        								\
+    case 0: (VAR)= A; break;        					\
+    case 1: case 2: case 3: case 4: case 5: case 6:        		\
+      (VAR)= I[t_k]; break;        					\
+    case 7: (VAR)= X; break;        					\
+    case TRACE_J: (VAR)= J; break;        				\
+    case TRACE_MEM: (VAR)= (unsigned) M < 4000 ? m->mem[M] : 0; break; \
+    case TRACE_CMP: (VAR)= (MIXu32) m->cmp; break;        		\
+    default: (VAR)= 0;        						\
+    }
+#define T_TRACE_CLOSE        						\
+  if ( r != NULL )        						\
+    {        								\
+      T_TRACE_GET ( value );        					\
+      trace_close ( m, t, r, t_k, t_old, value, t_ov, M,        	\
+        	    t_cc-cc_remain );        				\
+    }
+#define T_TRACE(K,OLD)        						\
+  T_TRACE_CLOSE;        						\
+  r= trace_next ( t );        						\
+  r->clock= t_end - (uint64_t) cc_remain;        			\
+  r->inst= m->mem[old_PC];        					\
+  r->pc= (uint16_t) old_PC;        					\
+  t_k= (K);        							\
+  t_old= (OLD);        							\
+  t_ov= m->overflow;        						\
+  t_cc= cc_remain;        						\
+  goto *t->label[old_PC]
+  
+  
+  LOAD_REGS;
+  old_PC= m->regs.old_PC;
+  I[0]= 0;
+  cc_remain= cc;
+  insts= 0;
+  t= m->trace;
+  r= NULL;
+  t_old= 0; t_ov= OFF; t_k= t_cc= M= 0;
+  t_end= m->sched.base + (uint64_t) m->sched.budget; // Rellotge amb 0 cicles
+  DISPATCH;
+  
+ l_NOP: NEXT ( 1 );
+ l_ADD: T_ADD ( += );
+ l_SUB: T_ADD ( -= );
+  
+ l_LDA: T_LDR ( A );
+ l_LD1: T_LDI ( I[1] );
+ l_LD2: T_LDI ( I[2] );
+ l_LD3: T_LDI ( I[3] );
+ l_LD4: T_LDI ( I[4] );
+ l_LD5: T_LDI ( I[5] );
+ l_LD6: T_LDI ( I[6] );
+ l_LDX: T_LDR ( X );
+ l_LDAN: T_LDRN ( A );
+ l_LD1N: T_LDIN ( I[1] );
+ l_LD2N: T_LDIN ( I[2] );
+ l_LD3N: T_LDIN ( I[3] );
+ l_LD4N: T_LDIN ( I[4] );
+ l_LD5N: T_LDIN ( I[5] );
+ l_LD6N: T_LDIN ( I[6] );
+ l_LDXN: T_LDRN ( X );
+  
+ l_STA: T_ST ( A );
+ l_ST1: T_ST ( I[1] );
+ l_ST2: T_ST ( I[2] );
+ l_ST3: T_ST ( I[3] );
+ l_ST4: T_ST ( I[4] );
+ l_ST5: T_ST ( I[5] );
+ l_ST6: T_ST ( I[6] );
+ l_STX: T_ST ( X );
+ l_STJ: T_ST ( J );
+ l_STZ: T_ST ( 0 );
+  
+ l_JOP: T_JOP_BODY; NEXT ( 1 );
+ l_JA: T_JREG ( A );
+ l_J1: T_JREG ( I[1] );
+ l_J2: T_JREG ( I[2] );
+ l_J3: T_JREG ( I[3] );
+ l_J4: T_JREG ( I[4] );
+ l_J5: T_JREG ( I[5] );
+ l_J6: T_JREG ( I[6] );
+ l_JX: T_JREG ( X );
+  
+ l_MOPA: T_MOP ( A, 0xFFFFFFFF );
+ l_MOP1: T_MOP ( I[1], IMASK );
+ l_MOP2: T_MOP ( I[2], IMASK );
+ l_MOP3: T_MOP ( I[3], IMASK );
+ l_MOP4: T_MOP ( I[4], IMASK );
+ l_MOP5: T_MOP ( I[5], IMASK );
+ l_MOP6: T_MOP ( I[6], IMASK );
+ l_MOPX: T_MOP ( X, 0xFFFFFFFF );
+  
+ l_CMPA: T_CMP ( A );
+ l_CMP1: T_CMP ( I[1] );
+ l_CMP2: T_CMP ( I[2] );
+ l_CMP3: T_CMP ( I[3] );
+ l_CMP4: T_CMP ( I[4] );
+ l_CMP5: T_CMP ( I[5] );
+ l_CMP6: T_CMP ( I[6] );
+ l_CMPX: T_CMP ( X );
+  
+ l_MOPA_JA: T_MOP_JREG ( A, 0xFFFFFFFF );
+ l_MOP1_J1: T_MOP_JREG ( I[1], IMASK );
+ l_MOP2_J2: T_MOP_JREG ( I[2], IMASK );
+ l_MOP3_J3: T_MOP_JREG ( I[3], IMASK );
+ l_MOP4_J4: T_MOP_JREG ( I[4], IMASK );
+ l_MOP5_J5: T_MOP_JREG ( I[5], IMASK );
+ l_MOP6_J6: T_MOP_JREG ( I[6], IMASK );
+ l_MOPX_JX: T_MOP_JREG ( X, 0xFFFFFFFF );
+  
+ l_LDA_CMPA_JOP: T_LD_CMP_JOP ( A );
+ l_LDX_CMPX_JOP: T_LD_CMP_JOP ( X );
+  
+ l_ST_MOP1_J1: T_ST_MOP_JREG ( I[1] );
+ l_ST_MOP2_J2: T_ST_MOP_JREG ( I[2] );
+ l_ST_MOP3_J3: T_ST_MOP_JREG ( I[3] );
+ l_ST_MOP4_J4: T_ST_MOP_JREG ( I[4] );
+ l_ST_MOP5_J5: T_ST_MOP_JREG ( I[5] );
+ l_ST_MOP6_J6: T_ST_MOP_JREG ( I[6] );
+  
+  /* Implementació general. */
+ l_slow:
+  SAVE_REGS;
+  m->vars.d= d;
+  m->sched.left= cc_remain;
+  cc_remain-= d->op ( m );
+  LOAD_REGS;
+  M= m->vars.M;
+  if ( m->run_state.v != RUNNING ) { ++insts; goto out; }
+  NEXT ( 0 );
+  
+ l_trace_A: T_TRACE ( 0, A );
+ l_trace_I1: T_TRACE ( 1, I[1] );
+ l_trace_I2: T_TRACE ( 2, I[2] );
+ l_trace_I3: T_TRACE ( 3, I[3] );
+ l_trace_I4: T_TRACE ( 4, I[4] );
+ l_trace_I5: T_TRACE ( 5, I[5] );
+ l_trace_I6: T_TRACE ( 6, I[6] );
+ l_trace_X: T_TRACE ( 7, X );
+ l_trace_J: T_TRACE ( TRACE_J, J );
+ l_trace_MEM: T_TRACE ( TRACE_MEM, 0 );
+ l_trace_CMP: T_TRACE ( TRACE_CMP, (MIXu32) m->cmp );
+ l_trace_NONE: T_TRACE ( TRACE_NONE, 0 );
+ l_trace_off:
+  T_TRACE_CLOSE;
+  r= NULL;
+  goto *t->label[old_PC];
+  
+ out:
+  // Una instrucció d'i/o que ha d'esperar un dispositiu no compta.
+  if ( r != NULL )
+    {
+      if ( m->run_state.v == WAIT_DEVICE && !m->run_state.spinning )
+        r= NULL;
+      T_TRACE_CLOSE;
+    }
+  if ( t != NULL ) trace_publish ( t );
+  SAVE_REGS;
+  m->insts+= insts;
+  
+  return cc-cc_remain;
+  
+#undef LOAD_REGS
+#undef SAVE_REGS
+#undef DISPATCH
+#undef NEXT
+#undef NEXT_FUSED
+#undef T_CALC_M_VAL
+#undef T_CALC_M
+#undef T_LD
+#undef T_ADD
+#undef T_LDR
+#undef T_LDI
+#undef T_LDRN
+#undef T_LDIN
+#undef T_ST_BODY
+#undef T_ST
+#undef T_JREG_BODY
+#undef T_JREG
+#undef T_MOP_BODY
+#undef T_MOP
+#undef T_CMP_BODY
+#undef T_CMP
+#undef T_JOP_BODY
+#undef T_MOP_JREG
+#undef T_LD_CMP_JOP
+#undef T_ST_MOP_JREG
+#undef T_LOOP
+#undef T_TRACE_GET
+#undef T_TRACE_CLOSE
+#undef T_TRACE
+  
+} /* end run_threaded */
+
+#endif /* THREADED_DISPATCH */
+
+
+#ifdef JIT_X86_64
+
+/* Compilador JIT a x86-64. Els blocs bàsics que s'executen més de
+ * JIT_HOT vegades es tradueixen a codi natiu. Mentre s'executa el codi
+ * natiu els registres de MIX es mantenen en registres de la CPU:
+ *
+ *   rdi: MIX_Machine  r8d: A  r9d: X  r10d-r15d: I1-I6  ebp: J
+ *   esi: overflow     ebx: cmp
+ *
+ * rax, rcx i rdx són temporals. Un bloc descompta tots els seus
+ * cicles en entrar, sempre que queden prou cicles per a executar-lo
+ * sencer (l'intèrpret executa instruccions mentre queden cicles), si
+ * no torna a l'intèrpret. Els salts entre blocs es fan a través de
+ * 'entry', que per a les adreces sense traduir apunta a un codi que
+ * torna a l'intèrpret. Les instruccions de i/o i HLT no es tradueixen,
+ * i MUL, DIV, SHIFT, MOVE, NUM i CHAR es tradueixen com a crides a la
+ * implementació general.
+ *
+ * L'última instrucció d'un bloc (el salt) no es marca com a traduïda,
+ * perquè és habitual que el programa li modifique l'adreça (STJ per a
+ * tornar de les subrutines). En el seu lloc el codi natiu comprova la
+ * paraula en memòria abans d'executar-la. La resta d'instruccions es
+ * marquen amb CODE_JIT, i escriure en elles invalida els blocs que
+ * les contenen.
+ */
+
+/* Execucions d'una adreça abans de traduir el bloc que comença en
+   ella. */
+#define JIT_HOT 32
+
+/* Grandària de la memòria per al codi natiu. Quan s'ompli es
+   descarten tots els blocs. */
+#define JIT_BUF_SIZE (1024*1024)
+
+/* Grandària de pàgina per a canviar els permisos del buffer. */
+#define JIT_PAGE 4096
+
+/* Instruccions màximes per bloc i bytes màxims per instrucció. */
+#define JIT_MAX_INSTS 128
+#define JIT_MAX_INST_SIZE 320
+
+/* Motius pels quals el codi natiu torna a l'intèrpret. */
+#define JIT_NEXT 0 // Continuar en PC
+#define JIT_STEP 1 // L'intèrpret ha d'executar la instrucció de PC
+
+/* Registres de la CPU. */
+enum
+  {
+    H_RAX= 0, H_RCX, H_RDX, H_RBX, H_RSP, H_RBP, H_RSI, H_RDI,
+    H_R8, H_R9, H_R10, H_R11, H_R12, H_R13, H_R14, H_R15
+  };
+#define H_A H_R8
+#define H_X H_R9
+#define H_I(I) (H_R10+(I)-1)
+#define H_J H_RBP
+#define H_OV H_RSI
+#define H_CMP H_RBX
+
+/* Condicions. */
+enum
+  {
+    CC_B= 0x2, CC_AE= 0x3, CC_E= 0x4, CC_NE= 0x5, CC_BE= 0x6,
+    CC_A= 0x7, CC_L= 0xC, CC_GE= 0xD, CC_LE= 0xE, CC_G= 0xF
+  };
+
+/* Operacions (codi de l'opció 'op r/m32, r32' i extensió de l'opció
+   '81 /ext'). */
+#define OP_ADD 0x01
+#define OP_OR 0x09
+#define OP_AND 0x21
+#define OP_SUB 0x29
+#define OP_XOR 0x31
+#define OP_CMP 0x39
+#define OP_STORE 0x89
+#define OP_LOAD 0x8B
+#define EXT_ADD 0
+#define EXT_OR 1
+#define EXT_AND 4
+#define EXT_SUB 5
+#define EXT_XOR 6
+#define EXT_CMP 7
+#define EXT_SHL 4
+#define EXT_SHR 5
+#define EXT_SAR 7
+
+#define OFF(FIELD) ((int) offsetof ( MIX_Machine, FIELD ))
+
+
+typedef struct
+{
+  uint8_t *p;
+  int      end; // Final del bloc (sense tornar a 0), -1 en el pròleg
+} emit_t;
+
+
+static void
+e8 (
+    emit_t     *e,
+    const int   b
+    )
+{
+  *(e->p++)= (uint8_t) b;
+} /* end e8 */
+
+
+static void
+e32 (
+     emit_t         *e,
+     const uint32_t  v
+     )
+{
+  memcpy ( e->p, &v, 4 );
+  e->p+= 4;
+} /* end e32 */
+
+
+static void
+e64 (
+     emit_t         *e,
+     const uint64_t  v
+     )
+{
+  memcpy ( e->p, &v, 8 );
+  e->p+= 8;
+} /* end e64 */
+
+
+static void
+e_rex (
+       emit_t    *e,
+       const int  w,
+       const int  reg,
+       const int  base
+       )
+{
+  
+  int rex;
+  
+  
+  rex= 0x40 | (w<<3) | ((reg>>3)<<2) | (base>>3);
+  if ( rex != 0x40 ) e8 ( e, rex );
+  
+} /* end e_rex */
+
+
+/* OP REG_DST, REG_SRC on OP és de la forma 'op r/m32, r32'. */
+static void
+e_rr (
+      emit_t    *e,
+      const int  op,
+      const int  dst,
+      const int  src
+      )
+{
+  
+  e_rex ( e, 0, src, dst );
+  e8 ( e, op );
+  e8 ( e, 0xC0 | ((src&7)<<3) | (dst&7) );
+  
+} /* end e_rr */
+
+
+/* OP REG, [rdi+DISP]. */
+static void
+e_mem (
+       emit_t    *e,
+       const int  op,
+       const int  reg,
+       const int  disp
+       )
+{
+  
+  e_rex ( e, 0, reg, H_RDI );
+  e8 ( e, op );
+  e8 ( e, 0x80 | ((reg&7)<<3) | H_RDI );
+  e32 ( e, (uint32_t) disp );
+  
+} /* end e_mem */
+
+
+/* OP REG, [rdi+rax*4+DISP]. */
+static void
+e_memx (
+        emit_t    *e,
+        const int  op,
+        const int  reg,
+        const int  disp
+        )
+{
+  
+  e_rex ( e, 0, reg, H_RDI );
+  e8 ( e, op );
+  e8 ( e, 0x84 | ((reg&7)<<3) );
+  e8 ( e, 0x87 );
+  e32 ( e, (uint32_t) disp );
+  
+} /* end e_memx */
+
+
+/* OP REG, IMM amb OP de la forma '81 /ext'. */
+static void
+e_ri (
+      emit_t         *e,
+      const int       ext,
+      const int       reg,
+      const uint32_t  imm
+      )
+{
+  
+  e_rex ( e, 0, 0, reg );
+  e8 ( e, 0x81 );
+  e8 ( e, 0xC0 | (ext<<3) | (reg&7) );
+  e32 ( e, imm );
+  
+} /* end e_ri */
+
+
+/* OP dword [rdi+DISP], IMM amb OP de la forma '81 /ext'. */
+static void
+e_mi (
+      emit_t         *e,
+      const int       ext,
+      const int       disp,
+      const uint32_t  imm
+      )
+{
+  
+  e8 ( e, 0x81 );
+  e8 ( e, 0x80 | (ext<<3) | H_RDI );
+  e32 ( e, (uint32_t) disp );
+  e32 ( e, imm );
+  
+} /* end e_mi */
+
+
+/* Igual que e_mi però amb operand de 64 bits. */
+static void
+e_mi64 (
+        emit_t         *e,
+        const int       ext,
+        const int       disp,
+        const uint32_t  imm
+        )
+{
+  
+  e8 ( e, 0x48 );
+  e_mi ( e, ext, disp, imm );
+  
+} /* end e_mi64 */
+
+
+static void
+e_mov_ri (
+          emit_t         *e,
+          const int       reg,
+          const uint32_t  imm
+          )
+{
+  
+  e_rex ( e, 0, 0, reg );
+  e8 ( e, 0xB8 + (reg&7) );
+  e32 ( e, imm );
+  
+} /* end e_mov_ri */
+
+
+static void
+e_mov_ri64 (
+            emit_t         *e,
+            const int       reg,
+            const uint64_t  imm
+            )
+{
+  
+  e_rex ( e, 1, 0, reg );
+  e8 ( e, 0xB8 + (reg&7) );
+  e64 ( e, imm );
+  
+} /* end e_mov_ri64 */
+
+
+/* Desplaçaments amb EXT de la forma 'C1 /ext'. */
+static void
+e_shift (
+         emit_t    *e,
+         const int  ext,
+         const int  reg,
+         const int  n
+         )
+{
+  
+  e_rex ( e, 0, 0, reg );
+  e8 ( e, 0xC1 );
+  e8 ( e, 0xC0 | (ext<<3) | (reg&7) );
+  e8 ( e, n );
+  
+} /* end e_shift */
+
+
+static void
+e_test_ri (
+           emit_t         *e,
+           const int       reg,
+           const uint32_t  imm
+           )
+{
+  
+  e_rex ( e, 0, 0, reg );
+  e8 ( e, 0xF7 );
+  e8 ( e, 0xC0 | (reg&7) );
+  e32 ( e, imm );
+  
+} /* end e_test_ri */
+
+
+/* cmp byte [rdi+DISP(+rax)], 0. */
+static void
+e_cmp_byte0 (
+             emit_t     *e,
+             const int   disp,
+             const bool  index
+             )
+{
+  
+  e8 ( e, 0x80 );
+  if ( index ) { e8 ( e, 0xBC ); e8 ( e, 0x07 ); }
+  else e8 ( e, 0xBF );
+  e32 ( e, (uint32_t) disp );
+  e8 ( e, 0x00 );
+  
+} /* end e_cmp_byte0 */
+
+
+/* Salt condicional cap avant, cal completar-lo amb e_patch. */
+static uint8_t *
+e_jcc (
+       emit_t    *e,
+       const int  cc
+       )
+{
+  
+  uint8_t *ret;
+  
+  
+  e8 ( e, 0x0F );
+  e8 ( e, 0x80 | cc );
+  ret= e->p;
+  e32 ( e, 0 );
+  
+  return ret;
+  
+} /* end e_jcc */
+
+
+static uint8_t *
+e_jmp (
+       emit_t *e
+       )
+{
+  
+  uint8_t *ret;
+  
+  
+  e8 ( e, 0xE9 );
+  ret= e->p;
+  e32 ( e, 0 );
+  
+  return ret;
+  
+} /* end e_jmp */
+
+
+/* Fa que el salt REL32 vaja a la posició actual. */
+static void
+e_patch (
+         emit_t  *e,
+         uint8_t *rel32
+         )
+{
+  
+  int32_t rel;
+  
+  
+  rel= (int32_t) (e->p - (rel32+4));
+  memcpy ( rel32, &rel, 4 );
+  
+} /* end e_patch */
+
+
+static void
+e_jmp_to (
+          emit_t        *e,
+          const uint8_t *to
+          )
+{
+  
+  int32_t rel;
+  
+  
+  e8 ( e, 0xE9 );
+  rel= (int32_t) (to - (e->p+4));
+  e32 ( e, (uint32_t) rel );
+  
+} /* end e_jmp_to */
+
+
+/* mov eax, PC; jmp [rdi+rax*8+entry]. */
+static void
+e_goto (
+        emit_t    *e,
+        const int  pc
+        )
+{
+  
+  if ( pc >= 0 ) e_mov_ri ( e, H_RAX, (uint32_t) pc );
+  e8 ( e, 0xFF );
+  e8 ( e, 0xA4 );
+  e8 ( e, 0xC7 );
+  e32 ( e, (uint32_t) OFF ( jit.entry ) );
+  
+} /* end e_goto */
+
+
+/* Bolca (OP_STORE) o carrega (OP_LOAD) els registres de la màquina. */
+static void
+jit_regs (
+          emit_t    *e,
+          const int  op
+          )
+{
+  
+  int i;
+  
+  
+  e_mem ( e, op, H_A, OFF ( regs.A ) );
+  e_mem ( e, op, H_X, OFF ( regs.X ) );
+  for ( i= 1; i <= 6; ++i )
+    e_mem ( e, op, H_I ( i ), OFF ( regs.I ) + 4*(i-1) );
+  e_mem ( e, op, H_J, OFF ( regs.J ) );
+  e_mem ( e, op, H_OV, OFF ( overflow ) );
+  e_mem ( e, op, H_CMP, OFF ( cmp ) );
+  
+} /* end jit_regs */
+
+
+/* Torna a l'intèrpret en PC retornant els cicles REFUND que no s'han
+   executat. */
+static void
+jit_exit (
+          MIX_Machine *m,
+          emit_t      *e,
+          const int    pc,
+          const int    refund,
+          const int    reason
+          )
+{
+  
+  int insts;
+  
+  
+  if ( refund != 0 )
+    e_mi ( e, EXT_ADD, OFF ( jit.cc ), (uint32_t) refund );
+  insts= e->end == -1 || (pc == 0 && e->end == 4000) ? 0 : e->end-pc;
+  if ( insts != 0 )
+    e_mi64 ( e, EXT_SUB, OFF ( insts ), (uint32_t) insts );
+  e_mov_ri ( e, H_RAX, (uint32_t) pc );
+  e_mov_ri ( e, H_RCX, (uint32_t) reason );
+  e_jmp_to ( e, m->jit.exit );
+  
+} /* end jit_exit */
+
+
+/* DST= valor amb signe de SRC. Fa servir ecx. */
+static void
+jit_signed (
+            emit_t    *e,
+            const int  dst,
+            const int  src
+            )
+{
+  
+  e_rr ( e, OP_STORE, H_RCX, src );
+  if ( dst != src ) e_rr ( e, OP_STORE, dst, src );
+  e_ri ( e, EXT_AND, dst, INMASK );
+  e_shift ( e, EXT_SAR, H_RCX, 31 );
+  e_rr ( e, OP_XOR, dst, H_RCX );
+  e_rr ( e, OP_SUB, dst, H_RCX );
+  
+} /* end jit_signed */
+
+
+/* eax= M. Si CHECK i M està fora de rang torna a l'intèrpret per a
+   que execute la instrucció (i genere l'avís). Fa servir ecx. */
+static void
+jit_calc_M (
+            MIX_Machine     *m,
+            emit_t          *e,
+            const decoded_t *d,
+            const int        pc,
+            const int        refund,
+            const bool       check
+            )
+{
+  
+  uint8_t *ok;
+  
+  
+  if ( d->I == 0 )
+    {
+      e_mov_ri ( e, H_RAX, (uint32_t) d->addr );
+      return;
+    }
+  e_rr ( e, OP_STORE, H_RAX, H_I ( d->I ) );
+  e_rr ( e, OP_STORE, H_RCX, H_I ( d->I ) );
+  e_ri ( e, EXT_AND, H_RAX, 0xFFF );
+  e_shift ( e, EXT_SAR, H_RCX, 31 );
+  e_rr ( e, OP_XOR, H_RAX, H_RCX );
+  e_rr ( e, OP_SUB, H_RAX, H_RCX );
+  if ( d->addr != 0 ) e_ri ( e, EXT_ADD, H_RAX, (uint32_t) d->addr );
+  if ( check )
+    {
+      e_ri ( e, EXT_CMP, H_RAX, 3999 );
+      ok= e_jcc ( e, CC_BE );
+      jit_exit ( m, e, pc, refund, JIT_STEP );
+      e_patch ( e, ok );
+    }
+  
+} /* end jit_calc_M */
+
+
+/* edx= camp (L:R) de mem[eax]. Fa servir ecx. */
+static void
+jit_ld (
+        emit_t          *e,
+        const decoded_t *d
+        )
+{
+  
+  e_memx ( e, OP_LOAD, H_RDX, OFF ( mem ) );
+  if ( d->F == 5 ) return;
+  e_rr ( e, OP_STORE, H_RCX, H_RDX );
+  if ( d->shift != 0 ) e_shift ( e, EXT_SHR, H_RDX, d->shift );
+  e_ri ( e, EXT_AND, H_RDX, d->mask );
+  if ( d->sign )
+    {
+      e_ri ( e, EXT_AND, H_RCX, NMASK );
+      e_rr ( e, OP_OR, H_RDX, H_RCX );
+    }
+  
+} /* end jit_ld */
+
+
+/* REG= add_aux ( REG, eax ). Fa servir ecx. */
+static void
+jit_add_aux (
+             emit_t    *e,
+             const int  reg
+             )
+{
+  
+  uint8_t *nz, *end, *noov;
+  
+  
+  e_rr ( e, 0x85, H_RAX, H_RAX );
+  nz= e_jcc ( e, CC_NE );
+  e_ri ( e, EXT_AND, reg, NMASK );
+  end= e_jmp ( e );
+  e_patch ( e, nz );
+  e_rr ( e, OP_STORE, H_RCX, H_RAX );
+  e_shift ( e, EXT_SAR, H_RCX, 31 );
+  e_rr ( e, OP_XOR, H_RAX, H_RCX );
+  e_rr ( e, OP_SUB, H_RAX, H_RCX );
+  e_test_ri ( e, H_RAX, 0xC0000000 );
+  noov= e_jcc ( e, CC_E );
+  e_mov_ri ( e, H_OV, ON );
+  e_patch ( e, noov );
+  e_ri ( e, EXT_AND, H_RAX, INMASK );
+  e_ri ( e, EXT_AND, H_RCX, NMASK );
+  e_rr ( e, OP_OR, H_RAX, H_RCX );
+  e_rr ( e, OP_STORE, reg, H_RAX );
+  e_patch ( e, end );
+  
+} /* end jit_add_aux */
+
+
+/* Crida a la implementació general de la instrucció de l'adreça PC. */
+static void
+jit_call (
+          MIX_Machine *m,
+          emit_t      *e,
+          const int    pc,
+          const int    next
+          )
+{
+  
+  jit_regs ( e, OP_STORE );
+  e8 ( e, 0xC7 ); e8 ( e, 0x87 ); // mov dword [rdi+PC], next
+  e32 ( e, (uint32_t) OFF ( regs.PC ) );
+  e32 ( e, (uint32_t) next );
+  e_mov_ri64 ( e, H_RAX, (uint64_t) (uintptr_t) &(m->dec[pc]) );
+  e8 ( e, 0x48 ); e_mem ( e, OP_STORE, H_RAX, OFF ( vars.d ) );
+  e_mov_ri64 ( e, H_RAX, (uint64_t) (uintptr_t) m->dec[pc].op );
+  e8 ( e, 0xFF ); e8 ( e, 0xD0 ); // call rax
+  e8 ( e, 0x48 ); e8 ( e, 0x8B ); e8 ( e, 0x3C ); e8 ( e, 0x24 ); // mov rdi, [rsp]
+  jit_regs ( e, OP_LOAD );
+  
+} /* end jit_call */
+
+
+/* Torna els cicles de la instrucció si es pot traduir, 0 si no. */
+static int
+jit_cost (
+          const decoded_t *d,
+          bool            *jump
+          )
+{
+  
+  int C;
+  bool static_M;
+  
+  
+  *jump= false;
+  if ( d->bad_I || d->op == INVALID_F ) return 0;
+  static_M= d->I != 0 || (d->addr >= 0 && d->addr <= 3999);
+  C= d->inst&0x3F;
+  switch ( C )
+    {
+    case 0: return 1;
+    case 1:
+    case 2: return static_M ? 2 : 0;
+    case 3: return 10;
+    case 4: return 12;
+    case 5: return d->F == 2 ? 0 : 10;
+    case 6: return 2;
+    case 7: return 2*d->F + 1;
+    case 34:
+    case 35:
+    case 36:
+    case 37:
+    case 38: return 0;
+    default:
+      if ( C >= 39 && C <= 47 )
+        {
+          *jump= true;
+          return static_M ? 1 : 0;
+        }
+      else if ( C >= 48 && C <= 55 ) return 1;
+      else return static_M ? 2 : 0;
+    }
+  
+} /* end jit_cost */
+
+
+/* Registre de la CPU que conté el registre de MIX de la instrucció C
+   (A=0, I1-I6=1-6, X=7, J=8). -1 per a STZ. */
+static int
+jit_reg (
+         const int r
+         )
+{
+  
+  switch ( r )
+    {
+    case 0: return H_A;
+    case 7: return H_X;
+    case 8: return H_J;
+    case 9: return -1;
+    default: return H_I ( r );
+    }
+  
+} /* end jit_reg */
+
+
+static void
+jit_st (
+        emit_t          *e,
+        const decoded_t *d,
+        const int        reg
+        )
+{
+  
+  MIXu32 mask;
+  
+  
+  if ( d->F == 5 )
+    {
+      if ( reg == -1 ) e_rr ( e, OP_XOR, H_RDX, H_RDX );
+      else
+        {
+          e_rr ( e, OP_STORE, H_RDX, reg );
+          e_ri ( e, EXT_AND, H_RDX, NMASK|INMASK );
+        }
+      e_memx ( e, OP_STORE, H_RDX, OFF ( mem ) );
+      return;
+    }
+  e_memx ( e, OP_LOAD, H_RDX, OFF ( mem ) );
+  if ( d->sign )
+    {
+      e_ri ( e, EXT_AND, H_RDX, INMASK );
+      if ( reg != -1 )
+        {
+          e_rr ( e, OP_STORE, H_RCX, reg );
+          e_ri ( e, EXT_AND, H_RCX, NMASK );
+          e_rr ( e, OP_OR, H_RDX, H_RCX );
+        }
+    }
+  mask= d->mask<<d->shift;
+  if ( mask != 0 )
+    {
+      e_ri ( e, EXT_AND, H_RDX, ~mask );
+      if ( reg != -1 )
+        {
+          e_rr ( e, OP_STORE, H_RCX, reg );
+          if ( d->shift != 0 ) e_shift ( e, EXT_SHL, H_RCX, d->shift );
+          e_ri ( e, EXT_AND, H_RCX, mask );
+          e_rr ( e, OP_OR, H_RDX, H_RCX );
+        }
+    }
+  e_memx ( e, OP_STORE, H_RDX, OFF ( mem ) );
+  
+} /* end jit_st */
+
+
+static void
+jit_cmp (
+         emit_t          *e,
+         const decoded_t *d,
+         const int        reg
+         )
+{
+  
+  if ( d->mask == 0 )
+    {
+      e_rr ( e, OP_XOR, H_CMP, H_CMP );
+      return;
+    }
+  
+  /* op2 (edx). */
+  e_memx ( e, OP_LOAD, H_RDX, OFF ( mem ) );
+  e_rr ( e, OP_STORE, H_RAX, H_RDX );
+  if ( d->shift != 0 ) e_shift ( e, EXT_SHR, H_RDX, d->shift );
+  e_ri ( e, EXT_AND, H_RDX, d->mask );
+  if ( d->sign )
+    {
+      e_shift ( e, EXT_SAR, H_RAX, 31 );
+      e_rr ( e, OP_XOR, H_RDX, H_RAX );
+      e_rr ( e, OP_SUB, H_RDX, H_RAX );
+    }
+  
+  /* op1 (eax). */
+  e_rr ( e, OP_STORE, H_RAX, reg );
+  if ( d->shift != 0 ) e_shift ( e, EXT_SHR, H_RAX, d->shift );
+  e_ri ( e, EXT_AND, H_RAX, d->mask );
+  if ( d->sign )
+    {
+      e_rr ( e, OP_STORE, H_RCX, reg );
+      e_shift ( e, EXT_SAR, H_RCX, 31 );
+      e_rr ( e, OP_XOR, H_RAX, H_RCX );
+      e_rr ( e, OP_SUB, H_RAX, H_RCX );
+    }
+  
+  /* cmp= (op1<op2) + 2*(op1>op2). */
+  e_rr ( e, OP_CMP, H_RAX, H_RDX );
+  e8 ( e, 0x0F ); e8 ( e, 0x9C ); e8 ( e, 0xC1 ); // setl cl
+  e8 ( e, 0x0F ); e8 ( e, 0x9F ); e8 ( e, 0xC2 ); // setg dl
+  e8 ( e, 0x0F ); e8 ( e, 0xB6 ); e8 ( e, 0xC9 ); // movzx ecx, cl
+  e8 ( e, 0x0F ); e8 ( e, 0xB6 ); e8 ( e, 0xD2 ); // movzx edx, dl
+  e8 ( e, 0x8D ); e8 ( e, 0x1C ); e8 ( e, 0x51 ); // lea ebx, [rcx+rdx*2]
+  
+} /* end jit_cmp */
+
+
+static void
+jit_mop (
+         MIX_Machine     *m,
+         emit_t          *e,
+         const decoded_t *d,
+         const int        reg,
+         const bool       index,
+         const int        pc
+         )
+{
+  
+  uint8_t *nz, *end;
+  int M;
+  MIXu32 val;
+  
+  
+  /* INC i DEC. */
+  if ( d->F < 2 )
+    {
+      jit_calc_M ( m, e, d, pc, 0, false );
+      e_rr ( e, OP_STORE, H_RDX, H_RAX );
+      jit_signed ( e, H_RAX, reg );
+      e_rr ( e, d->F ? OP_SUB : OP_ADD, H_RAX, H_RDX );
+      jit_add_aux ( e, reg );
+    }
+  
+  /* ENT i ENN amb M constant. */
+  else if ( d->I == 0 )
+    {
+      M= d->addr;
+      if ( M == 0 ) val= d->inst&NMASK;
+      else if ( M < 0 ) val= NMASK | (MIXu32) (-M);
+      else val= (MIXu32) M;
+      if ( d->F == 3 ) val^= NMASK;
+      if ( index ) val&= IMASK;
+      e_mov_ri ( e, reg, val );
+      return;
+    }
+  
+  /* ENT i ENN. */
+  else
+    {
+      jit_calc_M ( m, e, d, pc, 0, false );
+      e_rr ( e, 0x85, H_RAX, H_RAX );
+      nz= e_jcc ( e, CC_NE );
+      e_mov_ri ( e, reg, d->inst&NMASK );
+      end= e_jmp ( e );
+      e_patch ( e, nz );
+      e_rr ( e, OP_STORE, H_RCX, H_RAX );
+      e_shift ( e, EXT_SAR, H_RCX, 31 );
+      e_rr ( e, OP_XOR, H_RAX, H_RCX );
+      e_rr ( e, OP_SUB, H_RAX, H_RCX );
+      e_ri ( e, EXT_AND, H_RCX, NMASK );
+      e_rr ( e, OP_OR, H_RAX, H_RCX );
+      e_rr ( e, OP_STORE, reg, H_RAX );
+      e_patch ( e, end );
+      if ( d->F == 3 ) e_ri ( e, EXT_XOR, reg, NMASK );
+    }
+  if ( index ) e_ri ( e, EXT_AND, reg, IMASK );
+  
+} /* end jit_mop */
+
+
+/* Salt final del bloc. */
+static void
+jit_jump (
+          MIX_Machine     *m,
+          emit_t          *e,
+          const decoded_t *d,
+          const int        pc,
+          const int        next
+          )
+{
+  
+  uint8_t *same, *bad, *ok, *no_jump, *jump;
+  int C, cc;
+  
+  
+  C= d->inst&0x3F;
+  
+  /* Si la paraula ha canviat però no C, F ni I, s'agafa la nova
+     adreça. */
+  e_mi ( e, EXT_CMP, OFF ( mem ) + 4*pc, d->inst );
+  e_mov_ri ( e, H_RAX, (uint32_t) d->addr );
+  same= e_jcc ( e, CC_E );
+  e_mem ( e, OP_LOAD, H_RAX, OFF ( mem ) + 4*pc );
+  e_rr ( e, OP_STORE, H_RCX, H_RAX );
+  e_ri ( e, EXT_XOR, H_RCX, d->inst );
+  e_test_ri ( e, H_RCX, 0x4003FFFF );
+  bad= e_jcc ( e, CC_NE );
+  e_rr ( e, OP_STORE, H_RCX, H_RAX );
+  e_shift ( e, EXT_SHR, H_RAX, 18 );
+  e_ri ( e, EXT_AND, H_RAX, 0xFFF );
+  e_shift ( e, EXT_SAR, H_RCX, 31 );
+  e_rr ( e, OP_XOR, H_RAX, H_RCX );
+  e_rr ( e, OP_SUB, H_RAX, H_RCX );
+  e_patch ( e, same );
+  
+  /* M. */
+  if ( d->I != 0 )
+    {
+      e_rr ( e, OP_STORE, H_RDX, H_I ( d->I ) );
+      e_rr ( e, OP_STORE, H_RCX, H_I ( d->I ) );
+      e_ri ( e, EXT_AND, H_RDX, 0xFFF );
+      e_shift ( e, EXT_SAR, H_RCX, 31 );
+      e_rr ( e, OP_XOR, H_RDX, H_RCX );
+      e_rr ( e, OP_SUB, H_RDX, H_RCX );
+      e_rr ( e, OP_ADD, H_RAX, H_RDX );
+    }
+  e_ri ( e, EXT_CMP, H_RAX, 3999 );
+  ok= e_jcc ( e, CC_BE );
+  e_patch ( e, bad );
+  jit_exit ( m, e, pc, 1, JIT_STEP );
+  e_patch ( e, ok );
+  
+  /* Condició. */
+  jump= no_jump= NULL;
+  if ( C == 39 )
+    switch ( d->F )
+      {
+      case 0: // JMP
+      case 1: // JSJ
+        break;
+      case 2: // JOV
+        e_rr ( e, 0x85, H_OV, H_OV );
+        no_jump= e_jcc ( e, CC_E );
+        e_rr ( e, OP_XOR, H_OV, H_OV );
+        break;
+      case 3: // JNOV
+        e_rr ( e, 0x85, H_OV, H_OV );
+        jump= e_jcc ( e, CC_E );
+        e_rr ( e, OP_XOR, H_OV, H_OV );
+        no_jump= e_jmp ( e );
+        break;
+      default: // JL, JE, JG, JGE, JNE, JLE
+        e_ri ( e, EXT_CMP, H_CMP, (uint32_t) "\1\0\2\1\0\2"[d->F-4] );
+        no_jump= e_jcc ( e, d->F < 7 ? CC_NE : CC_E );
+      }
+  else
+    {
+      jit_signed ( e, H_RDX, jit_reg ( C-40 ) );
+      e_rr ( e, 0x85, H_RDX, H_RDX );
+      switch ( d->F )
+        {
+        case 0: cc= CC_GE; break; // J_N
+        case 1: cc= CC_NE; break; // J_Z
+        case 2: cc= CC_LE; break; // J_P
+        case 3: cc= CC_L; break;  // J_NN
+        case 4: cc= CC_E; break;  // J_NZ
+        default: cc= CC_G; break; // J_NP
+        }
+      no_jump= e_jcc ( e, cc );
+    }
+  
+  /* Salta. */
+  if ( jump != NULL ) e_patch ( e, jump );
+  if ( C != 39 || d->F != 1 ) e_mov_ri ( e, H_J, (uint32_t) next );
+  e_goto ( e, -1 );
+  
+  /* No salta. */
+  if ( no_jump != NULL )
+    {
+      e_patch ( e, no_jump );
+      e_goto ( e, next );
+    }
+  
+} /* end jit_jump */
+
+
+/* Tradueix la instrucció de l'adreça PC. REFUND són els cicles de la
+   instrucció i les següents del bloc. */
+static void
+jit_inst (
+          MIX_Machine *m,
+          emit_t      *e,
+          const int    pc,
+          const int    refund,
+          const int    cost
+          )
+{
+  
+  const decoded_t *d;
+  int C, next;
+  uint8_t *ok;
+  
+  
+  d= &(m->dec[pc]);
+  C= d->inst&0x3F;
+  next= pc == 3999 ? 0 : pc+1;
+  if ( C == 0 ) return;
+  else if ( C <= 2 ) // ADD, SUB
+    {
+      jit_calc_M ( m, e, d, pc, refund, true );
+      jit_ld ( e, d );
+      jit_signed ( e, H_RDX, H_RDX );
+      jit_signed ( e, H_RAX, H_A );
+      e_rr ( e, C == 1 ? OP_ADD : OP_SUB, H_RAX, H_RDX );
+      jit_add_aux ( e, H_A );
+    }
+  else if ( C <= 7 ) // MUL, DIV, NUM, CHAR, SHIFT, MOVE
+    {
+      jit_call ( m, e, pc, next );
+      if ( C == 7 )
+        {
+          e_cmp_byte0 ( e, OFF ( jit.killed ), false );
+          ok= e_jcc ( e, CC_E );
+          jit_exit ( m, e, next, refund-cost, JIT_NEXT );
+          e_patch ( e, ok );
+        }
+    }
+  else if ( C <= 23 ) // LD, LDN
+    {
+      jit_calc_M ( m, e, d, pc, refund, true );
+      jit_ld ( e, d );
+      if ( C >= 16 ) e_ri ( e, EXT_XOR, H_RDX, NMASK );
+      if ( (C&0x7) != 0 && (C&0x7) != 7 ) e_ri ( e, EXT_AND, H_RDX, IMASK );
+      e_rr ( e, OP_STORE, jit_reg ( C&0x7 ), H_RDX );
+    }
+  else if ( C <= 33 ) // ST
+    {
+      jit_calc_M ( m, e, d, pc, refund, true );
+      jit_st ( e, d, jit_reg ( C-24 ) );
+      e_cmp_byte0 ( e, OFF ( code ), true );
+      ok= e_jcc ( e, CC_E );
+      e_mem ( e, OP_STORE, H_RAX, OFF ( jit.written ) );
+      jit_exit ( m, e, next, refund-cost, JIT_NEXT );
+      e_patch ( e, ok );
+    }
+  else if ( C <= 47 ) // Salts
+    jit_jump ( m, e, d, pc, next );
+  else if ( C <= 55 ) // MOP
+    jit_mop ( m, e, d, jit_reg ( C-48 ), C != 48 && C != 55, pc );
+  else // CMP
+    {
+      jit_calc_M ( m, e, d, pc, refund, true );
+      jit_cmp ( e, d, jit_reg ( C-56 ) );
+    }
+  
+} /* end jit_inst */
+
+
+/* Descarta tots els blocs traduïts. */
+static void
+jit_flush (
+           MIX_Machine *m
+           )
+{
+  
+  int i;
+  
+  
+  for ( i= 0; i < 4000; ++i )
+    {
+      m->jit.entry[i]= m->jit.exit0;
+      m->code[i]&= ~CODE_JIT;
+    }
+  m->jit.nblocks= 0;
+  m->jit.used= m->jit.stubs_size;
+  m->jit.written= -1;
+  
+} /* end jit_flush */
+
+
+/* Allibera el codi natiu. */
+static void
+jit_close (
+           MIX_Machine *m
+           )
+{
+  
+  int i;
+  
+  
+  if ( m->jit.buf != NULL )
+    {
+      munmap ( m->jit.buf, JIT_BUF_SIZE );
+      m->jit.buf= NULL;
+      memset ( m->jit.count, 0, sizeof(m->jit.count) );
+      for ( i= 0; i < 4000; ++i )
+        m->code[i]&= ~CODE_JIT;
+    }
+  
+} /* end jit_close */
+
+
+/* Canvia les pàgines del buffer del codi natiu amb bytes en
+   [BEGIN,END) a lectura i execució (EXEC) o a lectura i escriptura.
+   Mai tenen els dos permisos alhora (W^X). */
+static bool
+jit_protect (
+             MIX_Machine  *m,
+             const size_t  begin,
+             const size_t  end,
+             const bool    exec
+             )
+{
+  
+  size_t first, last;
+  
+  
+  first= begin&~((size_t) (JIT_PAGE-1));
+  last= (end+JIT_PAGE-1)&~((size_t) (JIT_PAGE-1));
+  if ( last > JIT_BUF_SIZE ) last= JIT_BUF_SIZE;
+  
+  return mprotect ( m->jit.buf + first, last-first,
+        	    exec ? PROT_READ|PROT_EXEC : PROT_READ|PROT_WRITE ) == 0;
+  
+} /* end jit_protect */
+
+
+/* Tradueix el bloc que comença en PC. Torna el punt d'entrada, o
+   'exit0' si no es pot traduir. Si el sistema no permet canviar els
+   permisos del buffer tanca el JIT i la màquina torna a l'intèrpret. */
+static const void *
+jit_compile (
+             MIX_Machine *m,
+             const int    pc
+             )
+{
+  
+  int costs[JIT_MAX_INSTS], n, total, refund, i, a, last;
+  size_t begin;
+  bool jump, is_jump;
+  jit_block_t *b;
+  emit_t e;
+  uint8_t *ok;
+  const void *ret;
+  
+  
+  /* Delimita el bloc. */
+  n= total= 0;
+  jump= false;
+  for ( a= pc; n < JIT_MAX_INSTS && !jump; ++a )
+    {
+      if ( !(m->code[a]&CODE_DECODED) )
+        decode ( m, a );
+      costs[n]= jit_cost ( &(m->dec[a]), &is_jump );
+      if ( costs[n] == 0 ) break;
+      jump= is_jump;
+      total+= costs[n++];
+      if ( a == 3999 ) break;
+    }
+  if ( n == 0 ) return m->jit.exit0;
+  last= pc+n-1;
+  
+  /* Espai. */
+  if ( m->jit.nblocks == JIT_MAX_BLOCKS ||
+       JIT_BUF_SIZE - m->jit.used < (size_t) (n+1)*JIT_MAX_INST_SIZE )
+    jit_flush ( m );
+  
+  /* Pròleg: si no queden cicles per a executar el bloc sencer torna a
+     l'intèrpret. */
+  begin= m->jit.used;
+  if ( !jit_protect ( m, begin, begin + (size_t) (n+1)*JIT_MAX_INST_SIZE,
+        	      false ) )
+    goto error;
+  e.p= m->jit.buf + m->jit.used;
+  e.end= -1;
+  ret= e.p;
+  e_mi ( &e, EXT_CMP, OFF ( jit.cc ), (uint32_t) (total-costs[n-1]) );
+  ok= e_jcc ( &e, CC_G );
+  jit_exit ( m, &e, pc, 0, JIT_STEP );
+  e_patch ( &e, ok );
+  e_mi ( &e, EXT_SUB, OFF ( jit.cc ), (uint32_t) total );
+  e_mi64 ( &e, EXT_ADD, OFF ( insts ), (uint32_t) n );
+  e.end= pc+n;
+  
+  /* Instruccions. */
+  refund= total;
+  for ( i= 0; i < n; ++i )
+    {
+      jit_inst ( m, &e, pc+i, refund, costs[i] );
+      refund-= costs[i];
+    }
+  if ( !jump ) e_goto ( &e, last == 3999 ? 0 : last+1 );
+  m->jit.used= (size_t) (e.p - m->jit.buf);
+  if ( !jit_protect ( m, begin, begin + (size_t) (n+1)*JIT_MAX_INST_SIZE,
+        	      true ) )
+    goto error;
+  
+  /* Registra el bloc. */
+  b= &(m->jit.blocks[m->jit.nblocks++]);
+  b->start= pc;
+  b->end= jump ? last : last+1;
+  for ( a= b->start; a < b->end; ++a )
+    m->code[a]|= CODE_JIT;
+  m->jit.entry[pc]= ret;
+  
+  return ret;
+  
+ error:
+  ret= m->jit.exit0;
+  jit_close ( m );
+  return ret;
+  
+} /* end jit_compile */
+
+
+/* Descarta els blocs que contenen l'adreça ADDR. */
+static void
+jit_invalidate (
+        	MIX_Machine *m,
+        	const int    addr
+        	)
+{
+  
+  int i;
+  jit_block_t *b;
+  
+  
+  for ( i= 0; i < m->jit.nblocks; ++i )
+    {
+      b= &(m->jit.blocks[i]);
+      if ( addr >= b->start && addr < b->end )
+        {
+          m->jit.entry[b->start]= m->jit.exit0;
+          *b= m->jit.blocks[--m->jit.nblocks];
+          --i;
+        }
+    }
+  m->jit.killed= true;
+  
+} /* end jit_invalidate */
+
+
+/* Reserva la memòria per al codi natiu i genera el codi d'entrada i
+   eixida. Falla si el sistema no permet memòria executable. */
+static bool
+jit_init (
+          MIX_Machine *m
+          )
+{
+  
+  emit_t e;
+  uint8_t *ex;
+  
+  
+  m->jit.buf= mmap ( NULL, JIT_BUF_SIZE, PROT_READ|PROT_WRITE,
+        	     MAP_PRIVATE|MAP_ANONYMOUS, -1, 0 );
+  if ( m->jit.buf == MAP_FAILED )
+    {
+      m->jit.buf= NULL;
+      return false;
+    }
+  e.p= m->jit.buf;
+  e.end= -1;
+  
+  /* Eixida (eax=PC, ecx=motiu). */
+  ex= e.p;
+  e_mem ( &e, OP_STORE, H_RAX, OFF ( regs.PC ) );
+  jit_regs ( &e, OP_STORE );
+  e_rr ( &e, OP_STORE, H_RAX, H_RCX );
+  e8 ( &e, 0x48 ); e8 ( &e, 0x83 ); e8 ( &e, 0xC4 ); e8 ( &e, 0x08 ); // add rsp, 8
+  e8 ( &e, 0x41 ); e8 ( &e, 0x5F ); // pop r15
+  e8 ( &e, 0x41 ); e8 ( &e, 0x5E ); // pop r14
+  e8 ( &e, 0x41 ); e8 ( &e, 0x5D ); // pop r13
+  e8 ( &e, 0x41 ); e8 ( &e, 0x5C ); // pop r12
+  e8 ( &e, 0x5D ); // pop rbp
+  e8 ( &e, 0x5B ); // pop rbx
+  e8 ( &e, 0xC3 ); // ret
+  m->jit.exit= ex;
+  
+  /* Adreça sense traduir (eax=PC). */
+  m->jit.exit0= e.p;
+  e_rr ( &e, OP_XOR, H_RCX, H_RCX );
+  e_jmp_to ( &e, ex );
+  
+  /* Entrada: int enter (MIX_Machine *m, const void *code). */
+  m->jit.enter= (int (*) (MIX_Machine *, const void *)) e.p;
+  e8 ( &e, 0x53 ); // push rbx
+  e8 ( &e, 0x55 ); // push rbp
+  e8 ( &e, 0x41 ); e8 ( &e, 0x54 ); // push r12
+  e8 ( &e, 0x41 ); e8 ( &e, 0x55 ); // push r13
+  e8 ( &e, 0x41 ); e8 ( &e, 0x56 ); // push r14
+  e8 ( &e, 0x41 ); e8 ( &e, 0x57 ); // push r15
+  e8 ( &e, 0x48 ); e8 ( &e, 0x83 ); e8 ( &e, 0xEC ); e8 ( &e, 0x08 ); // sub rsp, 8
+  e8 ( &e, 0x48 ); e8 ( &e, 0x89 ); e8 ( &e, 0x3C ); e8 ( &e, 0x24 ); // mov [rsp], rdi
+  e8 ( &e, 0x48 ); e8 ( &e, 0x89 ); e8 ( &e, 0xF0 ); // mov rax, rsi
+  jit_regs ( &e, OP_LOAD );
+  e8 ( &e, 0xFF ); e8 ( &e, 0xE0 ); // jmp rax
+  
+  m->jit.stubs_size= (size_t) (e.p - m->jit.buf);
+  jit_flush ( m );
+  if ( !jit_protect ( m, 0, JIT_BUF_SIZE, true ) )
+    {
+      munmap ( m->jit.buf, JIT_BUF_SIZE );
+      m->jit.buf= NULL;
+      return false;
+    }
+  
+  return true;
+  
+} /* end jit_init */
+
+
+/* Executa almenys CC cicles amb el motor JIT. */
+static int
+run_jit (
+         MIX_Machine *m,
+         const int    cc
+         )
+{
+  
+  const void *code;
+  int pc, reason;
+  uint64_t insts;
+  
+  
+  m->jit.cc= cc;
+  while ( m->jit.cc > 0 && m->run_state.v == RUNNING &&
+          m->jit.buf != NULL )
+    {
+      pc= m->regs.PC;
+      code= m->jit.entry[pc];
+      if ( code == m->jit.exit0 && ++m->jit.count[pc] >= JIT_HOT )
+        {
+          m->jit.count[pc]= 0;
+          code= jit_compile ( m, pc );
+        }
+      if ( code != m->jit.exit0 )
+        {
+          m->jit.killed= false;
+          insts= m->insts;
+          reason= m->jit.enter ( m, code );
+          if ( m->counting ) m->ctr.untracked+= m->insts - insts;
+          if ( m->jit.written != -1 )
+            {
+              if ( m->code[m->jit.written]&~CODE_MARKS ) ++m->ctr.smc;
+              invalidate ( m, m->jit.written );
+              m->jit.written= -1;
+            }
+          if ( reason == JIT_NEXT || m->jit.cc <= 0 ) continue;
+        }
+      m->sched.left= m->jit.cc;
+      m->jit.cc-= step ( m );
+    }
+  
+  return cc - m->jit.cc;
+  
+} /* end run_jit */
+
+#endif /* JIT_X86_64 */
+
+
+/* AOT ***********************************************************************/
+/* Els blocs del mòdul registrat sols s'executen si la memòria en
+ * [inici,final) coincidix amb la imatge traduïda. La comparació es fa
+ * la primera vegada i es repetix després d'escriure en el bloc.
+ */
+
+static bool
+aot_check (
+           MIX_Machine *m,
+           const int    pc
+           )
+{
+  
+  const MIX_AOTModule *mod;
+  int a, end;
+  
+  
+  if ( m->aot.ok[pc] == AOT_UNKNOWN )
+    {
+      mod= m->aot.mod;
+      end= mod->end[pc];
+      m->aot.ok[pc]= memcmp ( &(m->mem[pc]), &(mod->image[pc]),
+        		      (end-pc)*sizeof(MIXu32) ) ?
+        AOT_DIFF : AOT_OK;
+      for ( a= pc; a < end; ++a )
+        m->code[a]|= CODE_AOT;
+    }
+  
+  return m->aot.ok[pc] == AOT_OK;
+  
+} /* end aot_check */
+
+
+static void
+aot_load_state (
+        	MIX_Machine *m
+        	)
+{
+  
+  MIX_AOTState *s;
+  
+  
+  s= &(m->aot.s);
+  s->A= m->regs.A;
+  s->X= m->regs.X;
+  memcpy ( s->I, m->regs.I, sizeof(s->I) );
+  s->J= m->regs.J;
+  s->overflow= m->overflow;
+  s->cmp= m->cmp;
+  
+} /* end aot_load_state */
+
+
+static void
+aot_save_state (
+        	MIX_Machine *m
+        	)
+{
+  
+  const MIX_AOTState *s;
+  
+  
+  s= &(m->aot.s);
+  m->regs.A= s->A;
+  m->regs.X= s->X;
+  memcpy ( m->regs.I, s->I, sizeof(s->I) );
+  m->regs.J= s->J;
+  m->overflow= s->overflow ? ON : OFF;
+  m->cmp= (cmp_t) s->cmp;
+  
+} /* end aot_save_state */
+
+
+/* Marca com a escrites les pàgines on els blocs han escrit paraules
+   que sols tenien CODE_SNAP. */
+static void
+aot_dirty (
+           MIX_Machine *m
+           )
+{
+  
+  MIX_AOTState *s;
+  int p;
+  
+  
+  s= &(m->aot.s);
+  for ( p= 0; p < NPAGES; ++p )
+    if ( (s->dirty>>p)&0x1 )
+      snap_dirty ( m, p*PAGE_SIZE );
+  s->dirty= 0;
+  
+} /* end aot_dirty */
+
+
+/* Executa almenys CC cicles amb el motor AOT. */
+static int
+run_aot (
+         MIX_Machine *m,
+         const int    cc
+         )
+{
+  
+  MIX_AOTState *s;
+  MIX_AOTBlock *block;
+  int pc, ret;
+  
+  
+  s= &(m->aot.s);
+  s->cc= cc;
+  s->written= -1;
+  s->dirty= 0;
+  s->insts= 0;
+  s->mem= m->mem;
+  s->code= m->code;
+  aot_load_state ( m );
+  while ( s->cc > 0 && m->run_state.v == RUNNING )
+    {
+      pc= m->regs.PC;
+      block= m->aot.mod->table[pc];
+      if ( block != NULL && aot_check ( m, pc ) )
+        {
+          ret= block ( s );
+          if ( s->dirty ) aot_dirty ( m );
+          if ( s->written != -1 )
+            {
+              if ( m->code[s->written]&~CODE_MARKS ) ++m->ctr.smc;
+              invalidate ( m, s->written );
+              s->written= -1;
+            }
+          if ( ret >= 0 )
+            {
+              m->regs.PC= ret;
+              continue;
+            }
+          m->regs.PC= -1-ret;
+          if ( s->cc <= 0 ) break;
+        }
+      aot_save_state ( m );
+      m->sched.left= s->cc;
+      s->cc-= step ( m );
+      aot_load_state ( m );
+    }
+  aot_save_state ( m );
+  m->insts+= s->insts;
+  if ( m->counting ) m->ctr.untracked+= s->insts;
+  
+  return cc - s->cc;
+  
+} /* end run_aot */
+
+
+
+
+/* PERFIL ********************************************************************/
+/* El motor MIX_ENGINE_PROFILE és l'intèrpret amb comptadors per
+ * adreça. És un motor a banda perquè els altres no paguen res quan no
+ * s'usa.
+ */
+
+/* Torna cert si l'instrucció amb codi C és un salt. */
+#define IS_JUMP(C) ((C) == 34 || ((C) >= 38 && (C) <= 47))
+
+
+/* Atribuïx al perfil els CC cicles que s'acaben de consumir en un
+   bucle d'espera (vore spin_wait). Cada cicle és una execució. */
+static void
+prof_spin (
+           MIX_Machine *m,
+           const int    cc
+           )
+{
+  
+  MIX_ProfileEntry *e;
+  int jmp, loop, first, n;
+  
+  
+  if ( m->run_state.spin == -1 ) // JBUS/JRED que salta a ell mateix
+    {
+      e= &(m->prof.v[m->regs.PC]);
+      e->count+= cc;
+      e->cycles+= cc;
+      e->taken+= cc;
+      return;
+    }
+  
+  // JBUS/JRED en 'loop' que no salta i JMP en 'jmp'.
+  jmp= m->run_state.spin;
+  loop= (m->mem[jmp]>>18)&0xFFF;
+  if ( cc%2 ) first= m->regs.PC == jmp ? loop : jmp;
+  else        first= m->regs.PC;
+  n= first == loop ? (cc+1)/2 : cc/2;
+  e= &(m->prof.v[loop]);
+  e->count+= n;
+  e->cycles+= n;
+  e->not_taken+= n;
+  e= &(m->prof.v[jmp]);
+  e->count+= cc-n;
+  e->cycles+= cc-n;
+  e->taken+= cc-n;
+  
+} /* end prof_spin */
+
+
+/* Executa almenys CC cicles amb l'intèrpret anotant en el perfil les
+   execucions, els cicles i els salts de cada adreça. Una instrucció
+   d'i/o que ha d'esperar un dispositiu no compta com a executada,
+   igual que en 'insts', però sí els cicles que ha costat. */
+static int
+run_profile (
+             MIX_Machine *m,
+             const int    cc
+             )
+{
+  
+  MIX_ProfileEntry *e;
+  int cc_remain, pc, next, tmp, C;
+  
+  
+  cc_remain= cc;
+  while ( cc_remain > 0 && m->run_state.v == RUNNING )
+    {
+      pc= m->regs.PC;
+      m->sched.left= cc_remain;
+      tmp= step ( m );
+      cc_remain-= tmp;
+      e= &(m->prof.v[pc]);
+      e->cycles+= tmp;
+      if ( m->run_state.v == WAIT_DEVICE && !m->run_state.spinning )
+        continue;
+      ++e->count;
+      C= m->vars.d->inst&0x3F;
+      if ( IS_JUMP ( C ) )
+        {
+          next= pc == 3999 ? 0 : pc+1;
+          if ( m->regs.PC != next ) ++e->taken;
+          else                      ++e->not_taken;
+        }
+    }
+  
+  return cc - cc_remain;
+  
+} /* end run_profile */
+
+
+/* Llig en BUF el següent registre d'un mapa de mixala (vore
+   MIX_MAP_MAGIC), la resta d'una línia massa llarga es descarta. Torna
+   1 si l'ha llegit, 0 al final i -1 si hi ha un error. */
+static int
+map_read (
+          FILE    *map,
+          char    *buf,
+          int      size,
+          int     *line,
+          int     *addr,
+          char   **text
+          )
+{
+  
+  size_t len;
+  int c, n;
+  
+  
+  if ( fgets ( buf, size, map ) == NULL ) return ferror ( map ) ? -1 : 0;
+  len= strlen ( buf );
+  if ( len > 0 && buf[len-1] == '\n' ) buf[--len]= '\0';
+  else
+    while ( (c= fgetc ( map )) != EOF && c != '\n' );
+  if ( sscanf ( buf, "L %d %d%n", line, addr, &n ) != 2 ||
+       *addr < -1 || *addr >= 4000 )
+    return -1;
+  *text= buf[n] == ' ' ? &(buf[n+1]) : &(buf[n]);
+  
+  return 1;
+  
+} /* end map_read */
+
+
+
+
+/* TRAÇA *********************************************************************/
+
+/* Fil que escriu els registres en el fitxer. */
+static void *
+trace_writer (
+              void *arg
+              )
+{
+  
+  trace_t *t;
+  size_t head, tail, i, n;
+  bool stop;
+  
+  
+  t= (trace_t *) arg;
+  tail= 0;
+  for (;;)
+    {
+      stop= atomic_load_explicit ( &(t->stop), memory_order_acquire );
+      head= atomic_load_explicit ( &(t->head), memory_order_acquire );
+      if ( head == tail )
+        {
+          if ( stop ) break;
+          nanosleep ( &_trace_wait, NULL );
+          continue;
+        }
+      i= tail&(TRACE_SIZE-1);
+      n= head-tail;
+      if ( n > TRACE_SIZE-i ) n= TRACE_SIZE-i;
+      if ( !t->error &&
+           fwrite ( &(t->buf[i]), sizeof(MIX_TraceRecord), n, t->f ) != n )
+        t->error= true;
+      tail+= n;
+      atomic_store_explicit ( &(t->tail), tail, memory_order_release );
+    }
+  
+  return NULL;
+  
+} /* end trace_writer */
+
+
+/* Executa almenys CC cicles amb l'intèrpret escrivint un registre per
+   cada instrucció seleccionada pel filtre. Igual que en run_profile,
+   una instrucció d'i/o que ha d'esperar un dispositiu no compta. */
+static int
+run_trace (
+           MIX_Machine *m,
+           const int    cc
+           )
+{
+  
+  trace_t *t;
+  MIX_TraceRecord *r;
+  MIXu32 *reg;
+  uint64_t clock;
+  MIXu32 inst, old, value;
+  overflow_t ov;
+  int cc_remain, pc, tmp, k;
+  
+  
+  t= m->trace;
+  cc_remain= cc;
+  while ( cc_remain > 0 && m->run_state.v == RUNNING )
+    {
+      pc= m->regs.PC;
+      m->sched.left= cc_remain;
+      if ( !(m->code[pc]&CODE_TRACE) ) trace_select ( m, pc );
+      k= t->sel[pc];
+      if ( k == TRACE_OFF )
+        {
+          cc_remain-= step ( m );
+          continue;
+        }
+      
+      // Executa.
+      clock= sched_now ( m );
+      inst= m->mem[pc];
+      reg= k <= TRACE_J ? t->regs[k] : NULL;
+      old= reg != NULL ? *reg : (MIXu32) m->cmp;
+      ov= m->overflow;
+      tmp= step ( m );
+      cc_remain-= tmp;
+      if ( m->run_state.v == WAIT_DEVICE && !m->run_state.spinning )
+        continue;
+      
+      // Escriu el registre.
+      if ( reg != NULL ) value= *reg;
+      else if ( k == TRACE_MEM )
+        value= (unsigned) m->vars.M < 4000 ? m->mem[m->vars.M] : 0;
+      else if ( k == TRACE_CMP ) value= (MIXu32) m->cmp;
+      else value= 0;
+      r= trace_next ( t );
+      r->clock= clock;
+      r->inst= inst;
+      r->pc= (uint16_t) pc;
+      trace_close ( m, t, r, k, old, value, ov, m->vars.M, tmp );
+      
+    }
+  trace_publish ( t );
+  
+  return cc - cc_remain;
+  
+} /* end run_trace */
+
+
+
+
+/* MOSTREIG ******************************************************************/
+/* Cada 'period' cicles es guarda la pila de subrutines. MIX no té
+ * pila: per convenció una subrutina comença amb STJ EXIT i acaba amb
+ * EXIT JMP *, així que l'adreça de retorn és el camp d'adreça de la
+ * paraula EXIT (o J si encara no s'ha executat STJ). La pila es
+ * reconstruïx seguint eixa cadena en el moment de la mostra, els
+ * motors no fan res de més.
+ */
+
+/* Torna l'adreça del STJ de la subrutina que conté PC, o -1 si PC no
+   està dins de cap. És el STJ (0:2) més pròxim per davant de PC que
+   apunta a un JMP a partir de PC. */
+static int
+sample_entry (
+              MIX_Machine *m,
+              const int    pc
+              )
+{
+  
+  sampler_t *s;
+  int a, M, ret;
+  MIXu32 w;
+  
+  
+  s= m->sample;
+  if ( m->code[pc]&CODE_SAMPLE ) return s->entry[pc];
+  ret= -1;
+  for ( a= pc; a >= 0; --a )
+    {
+      w= m->mem[a];
+      if ( (w&(NMASK|0x3FFFF)) != ((2<<6)|32) ) continue; // STJ M(0:2)
+      M= (int) ((w>>18)&0xFFF);
+      if ( M < 4000 && (m->mem[M]&0x3FFFF) == 39 ) // JMP M'
+        {
+          if ( M >= pc ) ret= a;
+          break;
+        }
+    }
+  s->entry[pc]= (int16_t) ret;
+  m->code[pc]|= CODE_SAMPLE;
+  
+  return ret;
+  
+} /* end sample_entry */
+
+
+/* Afegix K mostres de la pila FRAMES (DEPTH marcs). */
+static void
+sample_insert (
+               sampler_t      *s,
+               const uint16_t *frames,
+               const int       depth,
+               const uint64_t  k
+               )
+{
+  
+  sample_stack_t *v, *e;
+  size_t size, i, j;
+  uint32_t h;
+  int f;
+  
+  
+  // Creix.
+  if ( 2*(s->n+1) > s->size )
+    {
+      size= s->size == 0 ? 256 : 2*s->size;
+      v= (sample_stack_t *) calloc ( size, sizeof(sample_stack_t) );
+      if ( v != NULL )
+        {
+          for ( i= 0; i < s->size; ++i )
+            if ( s->v[i].depth != 0 )
+              {
+                for ( h= 2166136261u, f= 0; f < s->v[i].depth; ++f )
+                  h= (h^s->v[i].frames[f])*16777619u;
+                for ( j= h&(size-1); v[j].depth != 0; j= (j+1)&(size-1) );
+                v[j]= s->v[i];
+              }
+          free ( s->v );
+          s->v= v;
+          s->size= size;
+        }
+      else if ( s->n+1 >= s->size ) return; // Es perd la mostra
+    }
+  
+  // Busca.
+  for ( h= 2166136261u, f= 0; f < depth; ++f )
+    h= (h^frames[f])*16777619u;
+  for ( i= h&(s->size-1); ; i= (i+1)&(s->size-1) )
+    {
+      e= &(s->v[i]);
+      if ( e->depth == 0 )
+        {
+          e->depth= depth;
+          memcpy ( e->frames, frames, depth*sizeof(uint16_t) );
+          ++s->n;
+          break;
+        }
+      if ( e->depth == depth &&
+           memcmp ( e->frames, frames, depth*sizeof(uint16_t) ) == 0 )
+        break;
+    }
+  e->count+= k;
+  
+} /* end sample_insert */
+
+
+/* Guarda K mostres de la pila actual. Cada marc és l'adreça del STJ
+   d'una subrutina, o el PC amb SAMPLE_ROOT si està fora de totes. Si
+   la cadena és massa llarga (o fa un cicle) es queden els
+   SAMPLE_DEPTH marcs més interns. */
+static void
+sample_take (
+             MIX_Machine    *m,
+             const uint64_t  k
+             )
+{
+  
+  uint16_t frames[SAMPLE_DEPTH], tmp;
+  int pc, entry, ret, n, i;
+  MIXu32 w;
+  
+  
+  pc= m->regs.PC;
+  for ( n= 0; n < SAMPLE_DEPTH; )
+    {
+      entry= sample_entry ( m, pc );
+      if ( entry == -1 )
+        {
+          frames[n++]= (uint16_t) (pc|SAMPLE_ROOT);
+          break;
+        }
+      frames[n++]= (uint16_t) entry;
+      if ( n == 1 && pc == entry ) w= m->regs.J;
+      else w= m->mem[(m->mem[entry]>>18)&0xFFF]>>18;
+      if ( w&(NMASK>>18) ) break;
+      ret= (int) (w&0xFFF);
+      if ( ret >= 4000 ) break;
+      pc= ret == 0 ? 3999 : ret-1; // La crida
+    }
+  for ( i= 0; i < n/2; ++i )
+    {
+      tmp= frames[i];
+      frames[i]= frames[n-1-i];
+      frames[n-1-i]= tmp;
+    }
+  sample_insert ( m->sample, frames, n, k );
+  
+} /* end sample_take */
+
+
+/* Pren les mostres que toquen en el cicle actual (CC_TOTAL cicles
+   després de 'clock') i torna quants dels CC_REMAIN cicles es poden
+   executar abans de la següent. */
+static int
+sample_at (
+           MIX_Machine *m,
+           const int    cc_total,
+           const int    cc_remain
+           )
+{
+  
+  sampler_t *s;
+  uint64_t now, k;
+  
+  
+  s= m->sample;
+  now= m->clock + (uint64_t) cc_total;
+  if ( s->next > now + s->period ) // S'ha restaurat una còpia
+    s->next= now + s->period;
+  if ( now >= s->next )
+    {
+      k= (now - s->next)/s->period + 1;
+      sample_take ( m, k );
+      s->next+= k*s->period;
+    }
+  
+  return s->next - now < (uint64_t) cc_remain ?
+    (int) (s->next - now) : cc_remain;
+  
+} /* end sample_at */
+
+
+/* Nom d'una adreça en la pila: l'etiqueta més pròxima per davant. */
+typedef char sample_name_t[11];
+
+
+/* Llig les etiquetes del mapa MAP en NAMES. Cada adreça es queda amb
+   l'última etiqueta que no és local (dH) fins a ella, o amb la mateixa
+   adreça si no n'hi ha cap. */
+static bool
+sample_names (
+              FILE          *map,
+              sample_name_t  names[4000]
+              )
+{
+  
+  char buf[1024], *text;
+  int line, addr, n, a, len;
+  
+  
+  for ( a= 0; a < 4000; ++a )
+    names[a][0]= '\0';
+  if ( map != NULL )
+    {
+      if ( fgets ( buf, sizeof(buf), map ) == NULL ||
+           strcmp ( buf, MIX_MAP_MAGIC "\n" ) != 0 )
+        return false;
+      while ( (n= map_read ( map, buf, sizeof(buf),
+                             &line, &addr, &text )) == 1 )
+        {
+          if ( addr == -1 || text[0] == '*' ) continue;
+          len= (int) strcspn ( text, " \t" );
+          if ( len == 0 || len > 10 ||
+               (len == 2 && text[0] >= '0' && text[0] <= '9' &&
+                text[1] == 'H') )
+            continue;
+          memcpy ( names[addr], text, len );
+          names[addr][len]= '\0';
+        }
+      if ( n == -1 ) return false;
+    }
+  for ( a= 0; a < 4000; ++a )
+    if ( names[a][0] == '\0' )
+      {
+        if ( a > 0 && map != NULL && names[a-1][0] != '\0' )
+          strcpy ( names[a], names[a-1] );
+        else
+          sprintf ( names[a], "%04d", a );
+      }
+  
+  return true;
+  
+} /* end sample_names */
+
+
+/* Línia del format plegat. */
+typedef struct
+{
+  unsigned long long  count;
+  char               *text;
+} sample_line_t;
+
+
+static int
+sample_line_cmp (
+                 const void *a,
+                 const void *b
+                 )
+{
+  return strcmp ( ((const sample_line_t *) a)->text,
+                  ((const sample_line_t *) b)->text );
+} /* end sample_line_cmp */
+
+
+
+
+/* CRONOLOGIA ****************************************************************/
+/* Els esdeveniments es guarden tal qual durant l'execució i es passen
+ * al format de Chrome (trace event JSON, el que llig Perfetto) quan
+ * s'escriuen. Cada cicle és un microsegon en el visor.
+ */
+
+/* Nom de la pista de cada dispositiu. */
+static const char *_tl_devs[21]=
+  {
+    "Cinta 1", "Cinta 2", "Cinta 3", "Cinta 4",
+    "Cinta 5", "Cinta 6", "Cinta 7", "Cinta 8",
+    "Disc 1", "Disc 2", "Disc 3", "Disc 4",
+    "Disc 5", "Disc 6", "Disc 7", "Disc 8",
+    "Lector de targetes", "Perforadora de targetes", "Impressora",
+    "Terminal", "Cinta de paper"
+  };
+
+
+/* Escriu l'operació E, que acaba en END, i torna la seua durada. */
+static uint64_t
+timeline_write_io (
+                   FILE             *f,
+                   const tl_event_t *e,
+                   const uint64_t    end
+                   )
+{
+  
+  static const char *names[]= { "IN", "OUT", "IOC" };
+  
+  uint64_t dur;
+  
+  
+  dur= end > e->t ? end - e->t : 0;
+  fprintf ( f, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+            "\"ts\":%llu,\"dur\":%llu,\"args\":{\"M\":%d",
+            names[e->kind], e->dev+1, (unsigned long long) e->t,
+            (unsigned long long) dur, e->M );
+  if ( e->dev >= MIX_DISKORDRUMUNIT1 && e->dev < MIX_CARDREADER )
+    fprintf ( f, ",\"bloc\":%ld", (long) e->block );
+  fprintf ( f, "}}" );
+  
+  return dur;
+  
+} /* end timeline_write_io */
+
+
+/* Escriu l'espera de la CPU E, que acaba en END, i torna la seua
+   durada. */
+static uint64_t
+timeline_write_wait (
+                     FILE             *f,
+                     const tl_event_t *e,
+                     const uint64_t    end
+                     )
+{
+  
+  uint64_t dur;
+  
+  
+  dur= end > e->t ? end - e->t : 0;
+  fprintf ( f, ",\n{\"name\":\"espera\",\"ph\":\"X\",\"pid\":1,\"tid\":0,"
+            "\"ts\":%llu,\"dur\":%llu,\"args\":{\"dispositiu\":\"%s\"}}",
+            (unsigned long long) e->t, (unsigned long long) dur,
+            _tl_devs[e->dev] );
+  
+  return dur;
+  
+} /* end timeline_write_wait */
+
+
+/* Escriu en 'otherData' els cicles CC de NAME i el percentatge sobre
+   TOTAL. */
+static void
+timeline_write_use (
+                    FILE           *f,
+                    const char     *name,
+                    const uint64_t  cc,
+                    const uint64_t  total
+                    )
+{
+  fprintf ( f, ",\"%s\":\"%llu (%.1f%%)\"", name, (unsigned long long) cc,
+            total > 0 ? 100.0*(double) cc/(double) total : 0.0 );
+} /* end timeline_write_use */
+
+
+
+
+/* Executa fins a CC cicles. Si IDLE és cert els cicles que queden
+   quan la màquina està parada o esperant un dispositiu es consumixen
+   sense fer res; si no, torna abans sense consumir-los. */
+static int
+run (
+     MIX_Machine *m,
+     const int    cc,
+     const bool   idle,
+     MIX_Bool    *halt
+     )
+{
+  
+  int cc_remain,cc_total,tmp,budget;
+  MIX_IOOPChar *ioop;
+  
+
+  cc_remain= cc;
+  cc_total= 0;
+  *halt= MIX_FALSE;
+  while ( cc_remain > 0 )
+    switch ( m->run_state.v )
+      {
+        
+      case RUNNING: // Executa següent instrucció.
+        if ( m->timeline != NULL )
+          timeline_cpu ( m, m->clock + (uint64_t) cc_total );
+        budget= m->sample != NULL && m->sample->on ?
+          sample_at ( m, cc_total, cc_remain ) : cc_remain;
+        sched_at ( m, cc_total, budget );
+#ifdef THREADED_DISPATCH
+        if ( m->trace != NULL && !m->counting )
+          tmp= run_threaded ( m, budget );
+        else
+#endif
+        if ( m->trace != NULL )
+          tmp= run_trace ( m, budget );
+        else if ( m->prof.on )
+          tmp= run_profile ( m, budget );
+        else if ( m->aot.on )
+          tmp= run_aot ( m, budget );
+        else
+#ifdef JIT_X86_64
+        if ( m->jit.buf != NULL )
+          tmp= run_jit ( m, budget );
+        else
+#endif
+#ifdef THREADED_DISPATCH
+        if ( !m->counting )
+          tmp= run_threaded ( m, budget );
+        else
+#endif
+        tmp= step ( m );
+        cc_remain-= tmp;
+        cc_total+= tmp;
+        break;
+
+      case HALT:
+        if ( m->timeline != NULL )
+          timeline_cpu ( m, m->clock + (uint64_t) cc_total );
+        *halt= MIX_TRUE;
+        if ( idle ) cc_total+= cc_remain;
+        cc_remain= 0;
+        break;
+
+      case WAIT_DEVICE:
+        if ( m->timeline != NULL )
+          timeline_cpu ( m, m->clock + (uint64_t) cc_total );
+        events_clear ( m, m->run_state.dev );
+        sched_at ( m, cc_total, cc_remain );
+        tmp= m->run_state.busy ?
+          sched_wait ( m, m->run_state.dev, cc_remain ) : 0;
+        if ( tmp > 0 &&
+             (m->run_state.spin == -1 || spin_advance ( m, tmp )) )
+          { // La latència simulada sempre consumix cicles.
+            cc_total+= tmp;
+            cc_remain-= tmp;
+            m->ctr.wait[m->run_state.dev]+= (unsigned long long) tmp;
+            if ( m->run_state.spinning )
+              {
+                m->insts+= (uint64_t) tmp;
+                count_spin ( m, tmp );
+                if ( m->prof.on ) prof_spin ( m, tmp );
+              }
+          }
+        else if ( tmp == 0 &&
+                  dev_busy ( m, m->run_state.dev ) == m->run_state.busy &&
+                  (m->run_state.spin == -1 ||
+                   spin_advance ( m, idle ? cc_remain : 0 )) )
+          {
+            if ( idle )
+              {
+                cc_total+= cc_remain;
+                m->ctr.wait[m->run_state.dev]+=
+                  (unsigned long long) cc_remain;
+                if ( m->run_state.spinning )
+                  {
+                    m->insts+= (uint64_t) cc_remain;
+                    count_spin ( m, cc_remain );
+                    if ( m->prof.on ) prof_spin ( m, cc_remain );
+                  }
+              }
+            cc_remain= 0;
+          }
+        else
+          {
+            m->run_state.v= RUNNING;
+            m->notify_waiting_device ( m->udata, m->run_state.dev, false );
+          }
+        break;
+        
+      case RUNNING_GO_STEP0:
+        ++m->ctr.go_steps;
+        events_clear ( m, MIX_CARDREADER );
+        sched_at ( m, cc_total, cc_remain );
+        if ( (tmp= sched_wait ( m, MIX_CARDREADER, cc_remain )) > 0 )
+          {
+            cc_total+= tmp;
+            cc_remain-= tmp;
+          }
+        else if ( m->device_busy ( m->udata, MIX_CARDREADER ) )
+          {
+            if ( idle ) cc_total+= cc_remain;
+            cc_remain= 0;
+            if ( !m->run_state.notify_cr )
+              {
+                m->run_state.notify_cr= true;
+                m->notify_waiting_device ( m->udata, MIX_CARDREADER, true );
+              }
+          }
+        else
+          {
+            if ( m->run_state.notify_cr )
+              {
+                m->notify_waiting_device ( m->udata, MIX_CARDREADER, false );
+                m->run_state.notify_cr= false;
+              }
+            // LLig una targeta en 0.
+            ioop= &(m->go_ioop);
+            ioop->remain= 80; // Vore inout.
+            ioop->_pos= 0;
+            ioop->_addr= 0;
+            ioop->_aux= 0;
+            m->init_ioopchar ( m->udata, MIX_CARDREADER, ioop, MIX_IN );
+            sched_start ( m, MIX_CARDREADER, 16, 0 );
+            if ( m->timeline != NULL )
+              timeline_io ( m, MIX_CARDREADER, TL_IN, 0, 0 );
+            m->run_state.v= RUNNING_GO_STEP1;
+          }
+        break;
+        
+      case RUNNING_GO_STEP1:
+        ++m->ctr.go_steps;
+        events_clear ( m, MIX_CARDREADER );
+        sched_at ( m, cc_total, cc_remain );
+        if ( (tmp= sched_wait ( m, MIX_CARDREADER, cc_remain )) > 0 )
+          {
+            cc_total+= tmp;
+            cc_remain-= tmp;
+          }
+        else if ( m->device_busy ( m->udata, MIX_CARDREADER ) )
+          {
+            if ( idle ) cc_total+= cc_remain;
+            cc_remain= 0;
+            if ( !m->run_state.notify_cr )
+              {
+                m->run_state.notify_cr= true;
+                m->notify_waiting_device ( m->udata, MIX_CARDREADER, true );
+              }
+          }
+        else
+          {
+            if ( m->run_state.notify_cr )
+              {
+                m->notify_waiting_device ( m->udata, MIX_CARDREADER, false );
+                m->run_state.notify_cr= false;
+              }
+            if ( m->timeline != NULL )
+              timeline_done ( m, MIX_CARDREADER );
+            m->regs.PC= 0;
+            m->regs.J= 0;
+            m->run_state.v= RUNNING;
+          }
+        break;
+        
+      }
+  
+  m->clock+= (uint64_t) cc_total;
+  
+  return cc_total;
+  
+} /* end run */
+
+
+/* Crida a check i para la màquina si ho demana. Torna cert si s'ha
+   parat. */
+static bool
+check_signals (
+               MIX_Machine *m
+               )
+{
+  
+  MIX_Bool stop;
+  
+  
+  if ( m->check == NULL ) return false;
+  m->check ( m->udata, &stop );
+  if ( !stop ) return false;
+  if ( m->run_state.v == WAIT_DEVICE )
+    m->notify_waiting_device ( m->udata, m->run_state.dev, false );
+  else if ( m->run_state.notify_cr )
+    {
+      m->notify_waiting_device ( m->udata, MIX_CARDREADER, false );
+      m->run_state.notify_cr= false;
+    }
+  m->run_state.v= HALT;
+  
+  return true;
+  
+} /* end check_signals */
+
+
+
+/* CARÀCTERS *****************************************************************/
+/* Conversió de paraules senceres entre la memòria i vectors de
+ * MIX_Char. Amb SSE2 es processen 4 paraules alhora: els caràcters
+ * 0-3 de cada paraula es transposen com una matriu de 4x4 i el
+ * caràcter 4 es fa a part.
+ */
+
+/* Desempaqueta N paraules de FROM en 5*N caràcters. */
+static void
+unpack_chars (
+              MIX_Char     *to,
+              const MIXu32 *from,
+              size_t        n
+              )
+{
+  
+  size_t i;
+  MIXu32 w;
+#ifdef SIMD_SSE2
+  __m128i v, mask, s0, s1, s2, s3, t0, t1, t2, t3;
+#endif
+  
+  
+  i= 0;
+#ifdef SIMD_SSE2
+  if ( sizeof(MIX_Char) == sizeof(int32_t) )
+    {
+      mask= _mm_set1_epi32 ( 0x3F );
+      for ( ; i+4 <= n; i+= 4, to+= 20 )
+        {
+          v= _mm_loadu_si128 ( (const __m128i *) &(from[i]) );
+          s0= _mm_and_si128 ( _mm_srli_epi32 ( v, 24 ), mask );
+          s1= _mm_and_si128 ( _mm_srli_epi32 ( v, 18 ), mask );
+          s2= _mm_and_si128 ( _mm_srli_epi32 ( v, 12 ), mask );
+          s3= _mm_and_si128 ( _mm_srli_epi32 ( v, 6 ), mask );
+          t0= _mm_unpacklo_epi32 ( s0, s1 );
+          t1= _mm_unpacklo_epi32 ( s2, s3 );
+          t2= _mm_unpackhi_epi32 ( s0, s1 );
+          t3= _mm_unpackhi_epi32 ( s2, s3 );
+          _mm_storeu_si128 ( (__m128i *) &(to[0]),
+                             _mm_unpacklo_epi64 ( t0, t1 ) );
+          _mm_storeu_si128 ( (__m128i *) &(to[5]),
+                             _mm_unpackhi_epi64 ( t0, t1 ) );
+          _mm_storeu_si128 ( (__m128i *) &(to[10]),
+                             _mm_unpacklo_epi64 ( t2, t3 ) );
+          _mm_storeu_si128 ( (__m128i *) &(to[15]),
+                             _mm_unpackhi_epi64 ( t2, t3 ) );
+          to[4]= from[i]&0x3F;
+          to[9]= from[i+1]&0x3F;
+          to[14]= from[i+2]&0x3F;
+          to[19]= from[i+3]&0x3F;
+        }
+    }
+#endif
+  for ( ; i < n; ++i, to+= 5 )
+    {
+      w= from[i];
+      to[0]= (w>>24)&0x3F;
+      to[1]= (w>>18)&0x3F;
+      to[2]= (w>>12)&0x3F;
+      to[3]= (w>>6)&0x3F;
+      to[4]= w&0x3F;
+    }
+  
+} /* end unpack_chars */
+
+
+/* Empaqueta 5*N caràcters de FROM en N paraules positives. */
+static void
+pack_chars (
+            MIXu32         *to,
+            const MIX_Char *from,
+            size_t          n
+            )
+{
+  
+  size_t i;
+#ifdef SIMD_SSE2
+  __m128i v, mask, s0, s1, s2, s3, s4, t0, t1, t2, t3;
+#endif
+  
+  
+  i= 0;
+#ifdef SIMD_SSE2
+  if ( sizeof(MIX_Char) == sizeof(int32_t) )
+    {
+      mask= _mm_set1_epi32 ( 0x3F );
+      for ( ; i+4 <= n; i+= 4, from+= 20 )
+        {
+          s0= _mm_loadu_si128 ( (const __m128i *) &(from[0]) );
+          s1= _mm_loadu_si128 ( (const __m128i *) &(from[5]) );
+          s2= _mm_loadu_si128 ( (const __m128i *) &(from[10]) );
+          s3= _mm_loadu_si128 ( (const __m128i *) &(from[15]) );
+          t0= _mm_unpacklo_epi32 ( s0, s1 );
+          t1= _mm_unpacklo_epi32 ( s2, s3 );
+          t2= _mm_unpackhi_epi32 ( s0, s1 );
+          t3= _mm_unpackhi_epi32 ( s2, s3 );
+          s4= _mm_setr_epi32 ( from[4], from[9], from[14], from[19] );
+          v= _mm_and_si128 ( s4, mask );
+          s0= _mm_and_si128 ( _mm_unpacklo_epi64 ( t0, t1 ), mask );
+          v= _mm_or_si128 ( v, _mm_slli_epi32 ( s0, 24 ) );
+          s1= _mm_and_si128 ( _mm_unpackhi_epi64 ( t0, t1 ), mask );
+          v= _mm_or_si128 ( v, _mm_slli_epi32 ( s1, 18 ) );
+          s2= _mm_and_si128 ( _mm_unpacklo_epi64 ( t2, t3 ), mask );
+          v= _mm_or_si128 ( v, _mm_slli_epi32 ( s2, 12 ) );
+          s3= _mm_and_si128 ( _mm_unpackhi_epi64 ( t2, t3 ), mask );
+          v= _mm_or_si128 ( v, _mm_slli_epi32 ( s3, 6 ) );
+          _mm_storeu_si128 ( (__m128i *) &(to[i]), v );
+        }
+    }
+#endif
+  for ( ; i < n; ++i, from+= 5 )
+    to[i]=
+      (((MIXu32) from[0]&0x3F)<<24) |
+      (((MIXu32) from[1]&0x3F)<<18) |
+      (((MIXu32) from[2]&0x3F)<<12) |
+      (((MIXu32) from[3]&0x3F)<<6) |
+      ((MIXu32) from[4]&0x3F);
+  
+} /* end pack_chars */
+
+
+
+/* Text de cada caràcter. Δ, Σ i Π (0 en la taula) s'escriuen en
+   UTF-8, 0xCE seguit del byte de _text_utf8. */
+static const char _text[64]=
+  " ABCDEFGHI\0JKLMNOPQR\0\0STUVWXYZ0123456789.,()+-*/=$<>@;:'        ";
+
+static const uint8_t _text_utf8[3]= { 0x94, 0xA3, 0xA0 };
+
+/* Caràcter de cada byte ASCII. Els que no estan són espais, i '\0' i
+   '\n' acaben el text (TEXT_END). */
+#define TEXT_END 0xFF
+static const uint8_t _text_chars[128]=
+  {
+    ['\0']= TEXT_END, ['\n']= TEXT_END,
+    ['A']= MIX_A, ['B']= MIX_B, ['C']= MIX_C, ['D']= MIX_D, ['E']= MIX_E,
+    ['F']= MIX_F, ['G']= MIX_G, ['H']= MIX_H, ['I']= MIX_I, ['J']= MIX_J,
+    ['K']= MIX_K, ['L']= MIX_L, ['M']= MIX_M, ['N']= MIX_N, ['O']= MIX_O,
+    ['P']= MIX_P, ['Q']= MIX_Q, ['R']= MIX_R, ['S']= MIX_S, ['T']= MIX_T,
+    ['U']= MIX_U, ['V']= MIX_V, ['W']= MIX_W, ['X']= MIX_X, ['Y']= MIX_Y,
+    ['Z']= MIX_Z, ['0']= MIX_0, ['1']= MIX_1, ['2']= MIX_2, ['3']= MIX_3,
+    ['4']= MIX_4, ['5']= MIX_5, ['6']= MIX_6, ['7']= MIX_7, ['8']= MIX_8,
+    ['9']= MIX_9, ['.']= MIX_DOT, [',']= MIX_COMMA, ['(']= MIX_OPARENTHESE,
+    [')']= MIX_CPARENTHESE, ['+']= MIX_PLUS, ['-']= MIX_MINUS,
+    ['*']= MIX_ASTERISK, ['/']= MIX_SLASH, ['=']= MIX_EQUAL,
+    ['$']= MIX_DOLLAR, ['<']= MIX_LESS, ['>']= MIX_GREATER, ['@']= MIX_AT,
+    [';']= MIX_SEMICOLON, [':']= MIX_COLON, ['\'']= MIX_APOSTROPHE
+  };
+
+
+/* Escriu el text del caràcter C (0-63) en P. Torna la posició
+   següent. */
+static inline uint8_t *
+char_to_text (
+              uint8_t    *p,
+              const int   c,
+              const char *tab
+              )
+{
+  
+  if ( tab[c] != '\0' ) *(p++)= (uint8_t) tab[c];
+  else
+    {
+      *(p++)= 0xCE;
+      *(p++)= _text_utf8[c == MIX_DELTA ? 0 : (c == MIX_SIGMA ? 1 : 2)];
+    }
+  
+  return p;
+  
+} /* end char_to_text */
+
+
+
+/* IMATGES ******************************************************************/
+
+/* Llig un sencer de 32 bits en big-endian. */
+static bool
+read_be32 (
+           FILE     *f,
+           uint32_t *v
+           )
+{
+  
+  uint8_t b[4];
+  
+  
+  if ( fread ( b, 1, 4, f ) != 4 ) return false;
+  *v= (((uint32_t) b[0])<<24) | (((uint32_t) b[1])<<16) |
+    (((uint32_t) b[2])<<8) | ((uint32_t) b[3]);
+  
+  return true;
+  
+} /* end read_be32 */
+
+
+
+
+/* CÒPIES *******************************************************************/
+
+/* Copia en M l'estat de S excepte la memòria. */
+static void
+snap_load_state (
+                 MIX_Machine        *m,
+                 const MIX_Snapshot *s
+                 )
+{
+  
+  m->regs= s->regs;
+  m->vars.d= NULL;
+  m->vars.M= s->M;
+  m->overflow= s->overflow;
+  m->cmp= s->cmp;
+  m->run_state= s->run_state;
+  memcpy ( m->ioopchars, s->ioopchars, sizeof(m->ioopchars) );
+  memcpy ( m->ioopwords, s->ioopwords, sizeof(m->ioopwords) );
+  m->go_ioop= s->go_ioop;
+  memcpy ( m->fusion_hits, s->fusion_hits, sizeof(m->fusion_hits) );
+  m->clock= s->clock;
+  m->insts= s->insts;
+  m->sched= s->sched;
+  
+} /* end snap_load_state */
+
+
+/* Copia la pàgina P de S en la memòria de M, invalidant la
+   informació precalculada de les paraules que canvien. Torna a
+   marcar la pàgina amb CODE_SNAP. */
+static void
+snap_load_page (
+                MIX_Machine        *m,
+                const MIX_Snapshot *s,
+                const int           p
+                )
+{
+  
+  int a, begin, end;
+  
+  
+  begin= p*PAGE_SIZE;
+  end= begin+PAGE_SIZE; if ( end > 4000 ) end= 4000;
+  if ( memcmp ( &(m->mem[begin]), &(s->mem[begin]),
+                (end-begin)*sizeof(MIXu32) ) != 0 )
+    for ( a= begin; a < end; ++a )
+      if ( m->mem[a] != s->mem[a] )
+        {
+          MEM_WRITTEN ( a );
+          m->mem[a]= s->mem[a];
+        }
+  for ( a= begin; a < end; ++a )
+    m->code[a]|= CODE_SNAP;
+  
+} /* end snap_load_page */
+
+
+/* Comença a seguir les pàgines escrites respecte a S. */
+static void
+snap_track (
+            MIX_Machine        *m,
+            const MIX_Snapshot *s
+            )
+{
+  
+  m->snap.base= s;
+  m->snap.gen= s->gen;
+  m->snap.dirty= 0;
+  
+} /* end snap_track */
+
+
+
+
+/**********************/
+/* FUNCIONS PÚBLIQUES */
+/**********************/
+
+MIX_Machine *
+MIX_machine_new (void)
+{
+
+  MIX_Machine *ret;
+  pthread_condattr_t attr;
+  
+
+  // La grandària de MIX_Machine és múltiple de CACHE_LINE.
+  ret= (MIX_Machine *) aligned_alloc ( CACHE_LINE, sizeof(MIX_Machine) );
+  if ( ret == NULL ) return NULL;
+  memset ( ret, 0, sizeof(MIX_Machine) );
+  ret->run_state.v= HALT;
+  pthread_condattr_init ( &attr );
+  pthread_condattr_setclock ( &attr, CLOCK_MONOTONIC );
+  pthread_mutex_init ( &(ret->events.lock), NULL );
+  pthread_cond_init ( &(ret->events.cond), &attr );
+  pthread_condattr_destroy ( &attr );
+  
+  return ret;
+  
+} // end MIX_machine_new
+
+
+void
+MIX_machine_free (
+                  MIX_Machine *m
+                  )
+{
+  
+#ifdef JIT_X86_64
+  jit_close ( m );
+#endif
+  free ( m->prof.v );
+  if ( m->sample != NULL ) free ( m->sample->v );
+  free ( m->sample );
+  if ( m->timeline != NULL ) free ( m->timeline->v );
+  free ( m->timeline );
+  MIX_machine_trace_stop ( m );
+  pthread_mutex_destroy ( &(m->events.lock) );
+  pthread_cond_destroy ( &(m->events.cond) );
+  free ( m );
+  
+} // end MIX_machine_free
+
+
+void
+MIX_machine_go (
+                MIX_Machine *m
+                )
+{
+  m->run_state.v= RUNNING_GO_STEP0;
+} // end MIX_machine_go
+
+
+MIX_Bool
+MIX_load_image (
+                MIX_Machine    *m,
+                const MIX_Word *words,
+                const int       start,
+                const int       count,
+                const int       pc
+                )
+{
+  
+  int i;
+  
+  
+  if ( start < 0 || count < 0 || count > 4000-start || pc >= 4000 )
+    return MIX_FALSE;
+  for ( i= 0; i < count; ++i )
+    m->mem[start+i]= words[i]&(NMASK|INMASK);
+  for ( i= 0; i < count; ++i )
+    MEM_WRITTEN ( start+i );
+  if ( pc >= 0 )
+    {
+      m->regs.PC= pc;
+      m->regs.J= 0;
+      m->run_state.v= RUNNING;
+    }
+  
+  return MIX_TRUE;
+  
+} // end MIX_load_image
+
+
+MIX_Bool
+MIX_load_image_file (
+                     MIX_Machine *m,
+                     const char  *fn
+                     )
+{
+  
+  FILE *f;
+  char magic[8];
+  MIX_Word words[4000];
+  uint32_t pc, nsegs, start, count, i;
+  MIX_Bool ret;
+  
+  
+  f= fopen ( fn, "rb" );
+  if ( f == NULL ) return MIX_FALSE;
+  ret= MIX_FALSE;
+  if ( fread ( magic, 1, 8, f ) != 8 ||
+       memcmp ( magic, MIX_IMAGE_MAGIC, 8 ) != 0 ||
+       !read_be32 ( f, &pc ) || pc >= 4000 ||
+       !read_be32 ( f, &nsegs ) )
+    goto end;
+  for ( ; nsegs > 0; --nsegs )
+    {
+      if ( !read_be32 ( f, &start ) || !read_be32 ( f, &count ) ||
+           start >= 4000 || count > 4000-start )
+        goto end;
+      for ( i= 0; i < count; ++i )
+        if ( !read_be32 ( f, &(words[i]) ) ) goto end;
+      MIX_load_image ( m, words, (int) start, (int) count, -1 );
+    }
+  MIX_load_image ( m, words, 0, 0, (int) pc );
+  ret= MIX_TRUE;
+  
+ end:
+  fclose ( f );
+  
+  return ret;
+  
+} // end MIX_load_image_file
+
+
+MIX_Snapshot *
+MIX_snapshot_new (void)
+{
+  
+  MIX_Snapshot *ret;
+  
+  
+  ret= aligned_alloc ( CACHE_LINE, sizeof(MIX_Snapshot) );
+  if ( ret == NULL ) return NULL;
+  memset ( ret, 0, sizeof(MIX_Snapshot) );
+  
+  return ret;
+  
+} // end MIX_snapshot_new
+
+
+void
+MIX_snapshot_free (
+                   MIX_Snapshot *s
+                   )
+{
+  free ( s );
+} // end MIX_snapshot_free
+
+
+void
+MIX_machine_snapshot (
+                      MIX_Machine  *m,
+                      MIX_Snapshot *s
+                      )
+{
+  
+  int a;
+  
+  
+  s->gen= atomic_fetch_add_explicit ( &_snap_gen, 1,
+                                      memory_order_relaxed ) + 1;
+  s->regs= m->regs;
+  s->M= m->vars.M;
+  s->overflow= m->overflow;
+  s->cmp= m->cmp;
+  s->run_state= m->run_state;
+  memcpy ( s->ioopchars, m->ioopchars, sizeof(s->ioopchars) );
+  memcpy ( s->ioopwords, m->ioopwords, sizeof(s->ioopwords) );
+  s->go_ioop= m->go_ioop;
+  memcpy ( s->fusion_hits, m->fusion_hits, sizeof(s->fusion_hits) );
+  s->clock= m->clock;
+  s->insts= m->insts;
+  s->sched= m->sched;
+  memcpy ( s->mem, m->mem, sizeof(s->mem) );
+  for ( a= 0; a < 4000; ++a )
+    m->code[a]|= CODE_SNAP;
+  snap_track ( m, s );
+  
+} // end MIX_machine_snapshot
+
+
+void
+MIX_machine_restore (
+                     MIX_Machine        *m,
+                     const MIX_Snapshot *s
+                     )
+{
+  
+  int p;
+  
+  
+  for ( p= 0; p < NPAGES; ++p )
+    snap_load_page ( m, s, p );
+  snap_load_state ( m, s );
+  snap_track ( m, s );
+  
+} // end MIX_machine_restore
+
+
+void
+MIX_machine_fork (
+                  MIX_Machine        *m,
+                  const MIX_Snapshot *s
+                  )
+{
+  
+  int p;
+  
+  
+  if ( m->snap.base != s || m->snap.gen != s->gen )
+    {
+      MIX_machine_restore ( m, s );
+      return;
+    }
+  for ( p= 0; p < NPAGES; ++p )
+    if ( m->snap.dirty&(((uint64_t) 1)<<p) )
+      snap_load_page ( m, s, p );
+  m->snap.dirty= 0;
+  snap_load_state ( m, s );
+  
+} // end MIX_machine_fork
+
+
+void
+MIX_machine_init (
+                  MIX_Machine        *m,
+                  const MIX_Frontend *frontend,
+                  void               *udata
+                  )
+{
+  
+  static pthread_once_t once= PTHREAD_ONCE_INIT;
+  int i;
+  
+  
+  pthread_once ( &once, init_insts_cf );
+  
+  m->regs.A= m->regs.X= 0;
+  for ( i= 0; i < 6; ++i )
+    m->regs.I[i]= 0;
+  m->regs.J= 0;
+  m->regs.PC= 0;
+  
+  memset ( &(m->mem[0]), 0, 16000 /* 4000 * 4 */ );
+  memset ( &(m->code[0]), 0, sizeof(m->code) );
+  m->snap.base= NULL;
+#ifdef JIT_X86_64
+  if ( m->jit.buf != NULL )
+    {
+      jit_flush ( m );
+      memset ( m->jit.count, 0, sizeof(m->jit.count) );
+    }
+#endif
+  memset ( m->aot.ok, AOT_UNKNOWN, sizeof(m->aot.ok) );
+  memset ( m->fusion_hits, 0, sizeof(m->fusion_hits) );
+  memset ( &(m->ctr), 0, sizeof(m->ctr) );
+  if ( m->prof.v != NULL )
+    memset ( m->prof.v, 0, 4000*sizeof(MIX_ProfileEntry) );
+  if ( m->sample != NULL )
+    {
+      if ( m->sample->v != NULL )
+        memset ( m->sample->v, 0, m->sample->size*sizeof(sample_stack_t) );
+      m->sample->n= 0;
+      m->sample->next= m->sample->period;
+    }
+  if ( m->timeline != NULL )
+    {
+      m->timeline->n= 0;
+      m->timeline->lost= false;
+      m->timeline->state= RUNNING;
+      m->timeline->t0= 0;
+      memset ( m->timeline->open, 0, sizeof(m->timeline->open) );
+    }
+  m->clock= 0;
+  m->insts= 0;
+  m->check_interval= MIX_CHECK_INTERVAL;
+  memset ( m->sched.busy, 0, sizeof(m->sched.busy) );
+  memset ( m->sched.pos, 0, sizeof(m->sched.pos) );
+  m->sched.n= 0;
+  pthread_mutex_lock ( &(m->events.lock) );
+  m->events.ready= 0;
+  pthread_mutex_unlock ( &(m->events.lock) );
+  m->sched.disk.active= false;
+  m->sched.disk.track= 0;
+  m->sched.disk.dir= 1;
+  m->sched.disk.nqueue= 0;
+  memset ( m->sched.disk.stats, 0, sizeof(m->sched.disk.stats) );
+  
+  m->vars.d= NULL;
+  m->vars.M= 0;
+  
+  m->overflow= OFF;
+  m->cmp= EQUAL;
+  
+  m->init_ioopchar= frontend->init_ioopchar;
+  m->init_ioopword= frontend->init_ioopword;
+  m->device_busy= frontend->device_busy;
+  m->io_control= frontend->io_control;
+  m->notify_waiting_device= frontend->notify_waiting_device;
+  
+  m->warning= frontend->warning;
+  m->udata= udata;
+  
+  m->check= frontend->check;
+  
+  m->run_state.v= HALT;
+  m->run_state.notify_cr= false;
+  
+} // end MIX_machine_init
+
+
+MIX_Bool
+MIX_machine_set_engine (
+                        MIX_Machine      *m,
+                        const MIX_Engine  engine
+                        )
+{
+  
+  if ( engine == MIX_ENGINE_AOT && m->aot.mod == NULL )
+    return MIX_FALSE;
+  if ( engine == MIX_ENGINE_PROFILE && m->prof.v == NULL )
+    {
+      m->prof.v= calloc ( 4000, sizeof(MIX_ProfileEntry) );
+      if ( m->prof.v == NULL ) return MIX_FALSE;
+    }
+#ifdef JIT_X86_64
+  if ( engine == MIX_ENGINE_JIT && (m->jit.buf != NULL || jit_init ( m )) )
+    {
+      m->aot.on= false;
+      m->prof.on= false;
+      return MIX_TRUE;
+    }
+  jit_close ( m );
+#endif
+  m->aot.on= (engine == MIX_ENGINE_AOT);
+  m->prof.on= (engine == MIX_ENGINE_PROFILE);
+  
+  return engine != MIX_ENGINE_JIT ? MIX_TRUE : MIX_FALSE;
+  
+} // end MIX_machine_set_engine
+
+
+MIX_Bool
+MIX_machine_set_aot (
+                     MIX_Machine         *m,
+                     const MIX_AOTModule *mod
+                     )
+{
+  
+  int i;
+  
+  
+  if ( mod != NULL && mod->version != MIX_AOT_VERSION ) return MIX_FALSE;
+  for ( i= 0; i < 4000; ++i )
+    m->code[i]&= ~CODE_AOT;
+  memset ( m->aot.ok, AOT_UNKNOWN, sizeof(m->aot.ok) );
+  m->aot.mod= mod;
+  if ( mod == NULL ) m->aot.on= false;
+  
+  return MIX_TRUE;
+  
+} // end MIX_machine_set_aot
+
+
+int
+MIX_machine_translate (
+                       MIX_Machine *m,
+                       FILE        *f
+                       )
+{
+  return MIX_aot_translate ( m->mem, &(m->regs.PC), 1, f );
+} // end MIX_machine_translate
+
+
+unsigned long long
+MIX_machine_fusion_hits (
+                         MIX_Machine      *m,
+                         const MIX_Fusion  idiom
+                         )
+{
+  return m->fusion_hits[idiom];
+} // end MIX_machine_fusion_hits
+
+
+void
+MIX_machine_counters (
+                      MIX_Machine  *m,
+                      MIX_Counters *counters
+                      )
+{
+  
+  int C;
+  MIX_OpClass c;
+  
+  
+  memcpy ( counters->ops, m->ctr.ops, sizeof(counters->ops) );
+  memcpy ( counters->ops_f, m->ctr.ops_f, sizeof(counters->ops_f) );
+  memset ( counters->cycles, 0, sizeof(counters->cycles) );
+  for ( C= 0; C < 64; ++C )
+    {
+      if ( C >= 1 && C <= 4 ) c= MIX_CLASS_ARITH;
+      else if ( C <= 7 )      c= MIX_CLASS_SPECIAL;
+      else if ( C <= 23 )     c= MIX_CLASS_LOAD;
+      else if ( C <= 33 )     c= MIX_CLASS_STORE;
+      else if ( C <= 38 )     c= MIX_CLASS_IO;
+      else if ( C <= 47 )     c= MIX_CLASS_JUMP;
+      else if ( C <= 55 )     c= MIX_CLASS_MOP;
+      else                    c= MIX_CLASS_CMP;
+      counters->cycles[c]+= m->ctr.cycles[C];
+    }
+  counters->untracked= m->ctr.untracked;
+  memcpy ( counters->wait, m->ctr.wait, sizeof(counters->wait) );
+  counters->go_steps= m->ctr.go_steps;
+  memcpy ( counters->warnings, m->ctr.warnings,
+           sizeof(counters->warnings) );
+  counters->smc= m->ctr.smc;
+  
+} // end MIX_machine_counters
+
+
+void
+MIX_machine_reset_counters (
+                            MIX_Machine *m
+                            )
+{
+  memset ( &(m->ctr), 0, sizeof(m->ctr) );
+} // end MIX_machine_reset_counters
+
+
+void
+MIX_machine_set_counting (
+                          MIX_Machine    *m,
+                          const MIX_Bool  enable
+                          )
+{
+  m->counting= enable ? true : false;
+} // end MIX_machine_set_counting
+
+
+const MIX_ProfileEntry *
+MIX_machine_profile (
+                     MIX_Machine *m
+                     )
+{
+  return m->prof.v;
+} // end MIX_machine_profile
+
+
+MIX_Bool
+MIX_profile_write_csv (
+                       const MIX_ProfileEntry  prof[4000],
+                       FILE                   *f
+                       )
+{
+  
+  int a;
+  
+  
+  if ( fprintf ( f, "addr,count,cycles,taken,not_taken\n" ) < 0 )
+    return MIX_FALSE;
+  for ( a= 0; a < 4000; ++a )
+    if ( prof[a].count != 0 || prof[a].cycles != 0 )
+      if ( fprintf ( f, "%d,%llu,%llu,%llu,%llu\n", a,
+                     prof[a].count, prof[a].cycles,
+                     prof[a].taken, prof[a].not_taken ) < 0 )
+        return MIX_FALSE;
+  
+  return MIX_TRUE;
+  
+} // end MIX_profile_write_csv
+
+
+MIX_Bool
+MIX_profile_write_json (
+                        const MIX_ProfileEntry  prof[4000],
+                        FILE                   *f
+                        )
+{
+  
+  unsigned long long count, cycles;
+  const char *sep;
+  int a;
+  
+  
+  count= cycles= 0;
+  for ( a= 0; a < 4000; ++a )
+    {
+      count+= prof[a].count;
+      cycles+= prof[a].cycles;
+    }
+  if ( fprintf ( f, "{\"count\":%llu,\"cycles\":%llu,\"addrs\":[",
+                 count, cycles ) < 0 )
+    return MIX_FALSE;
+  sep= "";
+  for ( a= 0; a < 4000; ++a )
+    if ( prof[a].count != 0 || prof[a].cycles != 0 )
+      {
+        if ( fprintf ( f, "%s\n{\"addr\":%d,\"count\":%llu,"
+                       "\"cycles\":%llu,\"taken\":%llu,"
+                       "\"not_taken\":%llu}",
+                       sep, a, prof[a].count, prof[a].cycles,
+                       prof[a].taken, prof[a].not_taken ) < 0 )
+          return MIX_FALSE;
+        sep= ",";
+      }
+  if ( fprintf ( f, "\n]}\n" ) < 0 ) return MIX_FALSE;
+  
+  return MIX_TRUE;
+  
+} // end MIX_profile_write_json
+
+
+MIX_Bool
+MIX_profile_write_listing (
+                           const MIX_ProfileEntry  prof[4000],
+                           FILE                   *map,
+                           FILE                   *f
+                           )
+{
+  
+  char buf[1024], *text;
+  const MIX_ProfileEntry *e;
+  unsigned long long count, cycles;
+  int line, addr, n, a;
+  
+  
+  if ( fgets ( buf, sizeof(buf), map ) == NULL ||
+       strcmp ( buf, MIX_MAP_MAGIC "\n" ) != 0 )
+    return MIX_FALSE;
+  if ( fprintf ( f, "   VEGADES     CICLES     PRESOS  NO PRESOS ADR. LÍNIA\n" )
+       < 0 )
+    return MIX_FALSE;
+  while ( (n= map_read ( map, buf, sizeof(buf), &line, &addr, &text )) == 1 )
+    {
+      if ( addr == -1 )
+        n= fprintf ( f, "%*s%5d  %s\n", 49, "", line, text );
+      else
+        {
+          e= &(prof[addr]);
+          if ( e->taken != 0 || e->not_taken != 0 )
+            n= fprintf ( f, "%10llu %10llu %10llu %10llu %04d %5d  %s\n",
+                         e->count, e->cycles, e->taken, e->not_taken,
+                         addr, line, text );
+          else
+            n= fprintf ( f, "%10llu %10llu %21s %04d %5d  %s\n",
+                         e->count, e->cycles, "", addr, line, text );
+        }
+      if ( n < 0 ) return MIX_FALSE;
+    }
+  if ( n == -1 ) return MIX_FALSE;
+  count= cycles= 0;
+  for ( a= 0; a < 4000; ++a )
+    {
+      count+= prof[a].count;
+      cycles+= prof[a].cycles;
+    }
+  if ( fprintf ( f, "%10llu %10llu  TOTAL\n", count, cycles ) < 0 )
+    return MIX_FALSE;
+  
+  return MIX_TRUE;
+  
+} // end MIX_profile_write_listing
+
+
+MIX_Bool
+MIX_machine_trace_start (
+                         MIX_Machine           *m,
+                         const char            *fn,
+                         const MIX_TraceFilter *filter
+                         )
+{
+  
+  trace_t *t;
+  uint32_t header[2];
+  int a;
+  
+  
+  if ( m->trace != NULL ) return MIX_FALSE;
+  t= (trace_t *) aligned_alloc ( CACHE_LINE, sizeof(trace_t) );
+  if ( t == NULL ) return MIX_FALSE;
+  t->f= fopen ( fn, "wb" );
+  if ( t->f == NULL ) goto error;
+  header[0]= sizeof(MIX_TraceRecord);
+  header[1]= 0x01020304;
+  if ( fwrite ( MIX_TRACE_MAGIC, 1, 8, t->f ) != 8 ||
+       fwrite ( header, sizeof(header), 1, t->f ) != 1 )
+    goto error;
+  if ( filter != NULL )
+    {
+      t->begin= filter->begin;
+      t->end= filter->end;
+      t->ops= filter->ops;
+    }
+  else
+    {
+      t->begin= 0;
+      t->end= 4000;
+      t->ops= ~((uint64_t) 0);
+    }
+  t->whead= t->wtail= 0;
+  atomic_init ( &(t->head), 0 );
+  atomic_init ( &(t->tail), 0 );
+  atomic_init ( &(t->stop), false );
+  t->error= false;
+  if ( pthread_create ( &(t->thread), NULL, trace_writer, t ) != 0 )
+    goto error;
+  t->regs[0]= &(m->regs.A);
+  for ( a= 0; a < 6; ++a )
+    t->regs[a+1]= &(m->regs.I[a]);
+  t->regs[7]= &(m->regs.X);
+  t->regs[8]= &(m->regs.J);
+  // Les instruccions preparades per run_threaded han de passar per
+  // la traça.
+  for ( a= 0; a < 4000; ++a )
+    m->code[a]&= ~(CODE_TRACE|CODE_THREADED|CODE_FUSED);
+  m->trace= t;
+  
+  return MIX_TRUE;
+  
+ error:
+  if ( t->f != NULL ) { fclose ( t->f ); remove ( fn ); }
+  free ( t );
+  return MIX_FALSE;
+  
+} // end MIX_machine_trace_start
+
+
+MIX_Bool
+MIX_machine_trace_stop (
+                        MIX_Machine *m
+                        )
+{
+  
+  trace_t *t;
+  MIX_Bool ret;
+  int a;
+  
+  
+  t= m->trace;
+  if ( t == NULL ) return MIX_TRUE;
+  for ( a= 0; a < 4000; ++a )
+    m->code[a]&= ~(CODE_THREADED|CODE_FUSED);
+  trace_publish ( t );
+  atomic_store_explicit ( &(t->stop), true, memory_order_release );
+  pthread_join ( t->thread, NULL );
+  ret= !t->error;
+  if ( fclose ( t->f ) != 0 ) ret= MIX_FALSE;
+  free ( t );
+  m->trace= NULL;
+  
+  return ret;
+  
+} // end MIX_machine_trace_stop
+
+
+MIX_Bool
+MIX_machine_sample_start (
+                          MIX_Machine        *m,
+                          const unsigned int  period
+                          )
+{
+  
+  sampler_t *s;
+  int a;
+  
+  
+  if ( period == 0 ) return MIX_FALSE;
+  if ( m->sample == NULL )
+    {
+      m->sample= (sampler_t *) calloc ( 1, sizeof(sampler_t) );
+      if ( m->sample == NULL ) return MIX_FALSE;
+    }
+  s= m->sample;
+  if ( s->v != NULL ) memset ( s->v, 0, s->size*sizeof(sample_stack_t) );
+  s->n= 0;
+  for ( a= 0; a < 4000; ++a )
+    m->code[a]&= ~CODE_SAMPLE;
+  s->period= period;
+  s->next= m->clock + period;
+  s->on= true;
+  
+  return MIX_TRUE;
+  
+} // end MIX_machine_sample_start
+
+
+void
+MIX_machine_sample_stop (
+                         MIX_Machine *m
+                         )
+{
+  if ( m->sample != NULL ) m->sample->on= false;
+} // end MIX_machine_sample_stop
+
+
+MIX_Bool
+MIX_machine_sample_write_folded (
+                                 MIX_Machine *m,
+                                 FILE        *map,
+                                 FILE        *f
+                                 )
+{
+  
+  sampler_t *s;
+  sample_name_t *names;
+  sample_line_t *lines;
+  const sample_stack_t *e;
+  char *buf, *p;
+  size_t i, j, n;
+  int d, ret;
+  
+  
+  s= m->sample;
+  if ( s == NULL || s->n == 0 ) return MIX_TRUE;
+  names= (sample_name_t *) malloc ( 4000*sizeof(sample_name_t) );
+  lines= (sample_line_t *) malloc ( s->n*sizeof(sample_line_t) );
+  buf= (char *) malloc ( s->n*SAMPLE_DEPTH*sizeof(sample_name_t) );
+  ret= MIX_FALSE;
+  if ( names == NULL || lines == NULL || buf == NULL ||
+       !sample_names ( map, names ) )
+    goto end;
+  
+  // Construïx les línies, diferents piles poden tindre els mateixos noms.
+  p= buf;
+  for ( i= n= 0; i < s->size; ++i )
+    {
+      e= &(s->v[i]);
+      if ( e->depth == 0 ) continue;
+      lines[n].count= e->count;
+      lines[n].text= p;
+      for ( d= 0; d < e->depth; ++d )
+        p+= sprintf ( p, d == 0 ? "%s" : ";%s",
+                      names[e->frames[d]&~SAMPLE_ROOT] );
+      ++p;
+      ++n;
+    }
+  qsort ( lines, n, sizeof(sample_line_t), sample_line_cmp );
+  for ( i= 0; i < n; i= j )
+    {
+      for ( j= i+1; j < n && strcmp ( lines[i].text, lines[j].text ) == 0; ++j )
+        lines[i].count+= lines[j].count;
+      if ( fprintf ( f, "%s %llu\n", lines[i].text, lines[i].count ) < 0 )
+        goto end;
+    }
+  ret= MIX_TRUE;
+  
+ end:
+  free ( names );
+  free ( lines );
+  free ( buf );
+  return ret;
+  
+} // end MIX_machine_sample_write_folded
+
+
+MIX_Bool
+MIX_machine_timeline_start (
+                            MIX_Machine *m
+                            )
+{
+  
+  timeline_t *tl;
+  
+  
+  if ( m->timeline == NULL )
+    {
+      m->timeline= (timeline_t *) calloc ( 1, sizeof(timeline_t) );
+      if ( m->timeline == NULL ) return MIX_FALSE;
+    }
+  tl= m->timeline;
+  tl->n= 0;
+  tl->lost= false;
+  tl->state= RUNNING;
+  tl->t0= m->clock;
+  memset ( tl->open, 0, sizeof(tl->open) );
+  tl->on= true;
+  
+  return MIX_TRUE;
+  
+} // end MIX_machine_timeline_start
+
+
+void
+MIX_machine_timeline_stop (
+                           MIX_Machine *m
+                           )
+{
+  if ( m->timeline != NULL ) m->timeline->on= false;
+} // end MIX_machine_timeline_stop
+
+
+MIX_Bool
+MIX_machine_timeline_write (
+                            MIX_Machine *m,
+                            FILE        *f
+                            )
+{
+  
+  const timeline_t *tl;
+  const tl_event_t *e, *open[21], *wait;
+  uint64_t busy[21], stall, total;
+  bool used[21];
+  size_t i;
+  int dev;
+  
+  
+  tl= m->timeline;
+  if ( tl == NULL ) return MIX_FALSE;
+  memset ( open, 0, sizeof(open) );
+  memset ( busy, 0, sizeof(busy) );
+  memset ( used, 0, sizeof(used) );
+  wait= NULL;
+  stall= 0;
+  fprintf ( f, "{\"traceEvents\":[\n"
+            "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+            "\"args\":{\"name\":\"MIX\"}},\n"
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,"
+            "\"args\":{\"name\":\"CPU\"}}" );
+  for ( i= 0; i < tl->n; ++i )
+    {
+      e= &(tl->v[i]);
+      switch ( e->kind )
+        {
+        case TL_IN:
+        case TL_OUT:
+        case TL_IOC:
+          if ( !used[e->dev] )
+            {
+              used[e->dev]= true;
+              fprintf ( f, ",\n{\"name\":\"thread_name\",\"ph\":\"M\","
+                        "\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                        e->dev+1, _tl_devs[e->dev] );
+            }
+          open[e->dev]= e;
+          break;
+        case TL_DONE:
+          if ( open[e->dev] != NULL )
+            busy[e->dev]+= timeline_write_io ( f, open[e->dev], e->t );
+          open[e->dev]= NULL;
+          break;
+        case TL_WAIT:
+          wait= e;
+          break;
+        case TL_RUN:
+          if ( wait != NULL ) stall+= timeline_write_wait ( f, wait, e->t );
+          wait= NULL;
+          break;
+        case TL_HALT:
+          fprintf ( f, ",\n{\"name\":\"HLT\",\"ph\":\"i\",\"s\":\"t\","
+                    "\"pid\":1,\"tid\":0,\"ts\":%llu}",
+                    (unsigned long long) e->t );
+          break;
+        }
+    }
+  
+  // El que no ha acabat es talla en el cicle actual.
+  for ( dev= 0; dev < 21; ++dev )
+    if ( open[dev] != NULL )
+      busy[dev]+= timeline_write_io ( f, open[dev], m->clock );
+  if ( wait != NULL ) stall+= timeline_write_wait ( f, wait, m->clock );
+  
+  // Utilització des de MIX_machine_timeline_start.
+  total= m->clock > tl->t0 ? m->clock - tl->t0 : 0;
+  fprintf ( f, "\n],\n\"otherData\":{\"cicles\":\"%llu\"",
+            (unsigned long long) total );
+  timeline_write_use ( f, "CPU espera", stall, total );
+  for ( dev= 0; dev < 21; ++dev )
+    if ( used[dev] )
+      timeline_write_use ( f, _tl_devs[dev], busy[dev], total );
+  if ( tl->lost )
+    fprintf ( f, ",\"error\":\"falten esdeveniments per falta de memòria\"" );
+  fprintf ( f, "}}\n" );
+  
+  return ferror ( f ) ? MIX_FALSE : MIX_TRUE;
+  
+} // end MIX_machine_timeline_write
+
+
+void
+MIX_machine_device_ready (
+                          MIX_Machine      *m,
+                          const MIX_Device  dev
+                          )
+{
+  
+  pthread_mutex_lock ( &(m->events.lock) );
+  m->events.ready|= 1U<<dev;
+  pthread_cond_broadcast ( &(m->events.cond) );
+  pthread_mutex_unlock ( &(m->events.lock) );
+  
+} // end MIX_machine_device_ready
+
+
+MIX_Bool
+MIX_machine_wait_device (
+                         MIX_Machine *m,
+                         const int    timeout_ms
+                         )
+{
+  
+  struct timespec end;
+  unsigned int bit;
+  int ret;
+  
+  
+  /* Dispositiu que s'està esperant. */
+  switch ( m->run_state.v )
+    {
+    case WAIT_DEVICE:
+      if ( !m->run_state.busy ) return MIX_TRUE;
+      bit= 1U<<m->run_state.dev;
+      break;
+    case RUNNING_GO_STEP0:
+    case RUNNING_GO_STEP1:
+      bit= 1U<<MIX_CARDREADER;
+      break;
+    default: return MIX_TRUE;
+    }
+  
+  /* Espera. */
+  if ( timeout_ms >= 0 )
+    {
+      clock_gettime ( CLOCK_MONOTONIC, &end );
+      end.tv_sec+= timeout_ms/1000;
+      end.tv_nsec+= (long) (timeout_ms%1000)*1000000L;
+      if ( end.tv_nsec >= 1000000000L )
+        {
+          ++end.tv_sec;
+          end.tv_nsec-= 1000000000L;
+        }
+    }
+  ret= 0;
+  pthread_mutex_lock ( &(m->events.lock) );
+  while ( !(m->events.ready&bit) && ret == 0 )
+    ret= timeout_ms >= 0 ?
+      pthread_cond_timedwait ( &(m->events.cond), &(m->events.lock), &end ) :
+      pthread_cond_wait ( &(m->events.cond), &(m->events.lock) );
+  ret= (m->events.ready&bit) != 0;
+  m->events.ready&= ~bit;
+  pthread_mutex_unlock ( &(m->events.lock) );
+  
+  return ret ? MIX_TRUE : MIX_FALSE;
+  
+} // end MIX_machine_wait_device
+
+
+int
+MIX_machine_iter (
+                  MIX_Machine *m,
+                  const int    cc,
+                  MIX_Bool    *halt
+                  )
+{
+  
+  int ret;
+  
+  
+  ret= run ( m, cc, true, halt );
+  if ( check_signals ( m ) ) *halt= MIX_TRUE;
+  
+  return ret;
+  
+} // end MIX_machine_iter
+
+
+MIX_RunStatus
+MIX_run (
+         MIX_Machine    *m,
+         const uint64_t  max_cycles,
+         MIX_RunResult  *res
+         )
+{
+  
+  uint64_t remain, clock0, insts0;
+  int chunk, cc, since_check;
+  MIX_Bool halt;
+  MIX_RunStatus ret;
+  
+  
+  clock0= m->clock;
+  insts0= m->insts;
+  remain= max_cycles;
+  since_check= 0;
+  ret= MIX_RUN_LIMIT;
+  while ( remain > 0 )
+    {
+      chunk= m->check_interval - since_check;
+      if ( (uint64_t) chunk > remain ) chunk= (int) remain;
+      cc= run ( m, chunk, false, &halt );
+      remain= (uint64_t) cc < remain ? remain - (uint64_t) cc : 0;
+      since_check+= cc;
+      if ( halt ) { ret= MIX_RUN_HALT; break; }
+      if ( since_check >= m->check_interval )
+        {
+          since_check= 0;
+          if ( check_signals ( m ) ) { ret= MIX_RUN_STOP; break; }
+        }
+      // Si ha tornat abans d'hora és que espera un dispositiu.
+      if ( cc < chunk ) { ret= MIX_RUN_WAIT; break; }
+    }
+  
+  if ( res != NULL )
+    {
+      res->status= ret;
+      res->cycles= m->clock - clock0;
+      res->clock= m->clock;
+      res->insts= m->insts - insts0;
+      res->dev= m->run_state.v == WAIT_DEVICE ?
+        (MIX_Device) m->run_state.dev : MIX_CARDREADER;
+    }
+  
+  return ret;
+  
+} // end MIX_run
+
+
+void
+MIX_machine_set_check_interval (
+                                MIX_Machine *m,
+                                const int    cycles
+                                )
+{
+  m->check_interval= cycles > 0 ? cycles : 1;
+} // end MIX_machine_set_check_interval
+
+
+void
+MIX_machine_set_device_timing (
+                               MIX_Machine            *m,
+                               const MIX_Device        dev,
+                               const MIX_DeviceTiming *timing
+                               )
+{
+
+  if ( timing != NULL ) m->sched.timing[dev]= *timing;
+  m->sched.has[dev]= (timing != NULL);
+  sched_update_on ( m );
+
+} // end MIX_machine_set_device_timing
+
+
+void
+MIX_machine_set_disk_timing (
+                             MIX_Machine          *m,
+                             const MIX_DiskTiming *timing
+                             )
+{
+
+  if ( timing != NULL )
+    {
+      m->sched.disk.timing= *timing;
+      if ( m->sched.disk.timing.blocks == 0 )
+        m->sched.disk.timing.blocks= 1;
+    }
+  m->sched.disk.on= (timing != NULL);
+  sched_update_on ( m );
+
+} // end MIX_machine_set_disk_timing
+
+
+void
+MIX_machine_disk_stats (
+                        MIX_Machine      *m,
+                        const MIX_Device  dev,
+                        MIX_DiskStats    *stats
+                        )
+{
+  *stats= m->sched.disk.stats[dev-MIX_DISKORDRUMUNIT1];
+} // end MIX_machine_disk_stats
+
+
+size_t
+MIX_machine_read_chars (
+                        MIX_Machine  *m,
+                        MIX_Char     *to,
+                        size_t        nmeb,
+                        MIX_IOOPChar *op
+                        )
+{
+  
+  MIX_IOOPChar ioop;
+  size_t i, n, words, len;
+  
+  
+  ioop= *op;
+  n= nmeb < ioop.remain ? nmeb : ioop.remain;
+  for ( i= 0; i < n; )
+    {
+      /* Paraules senceres. La primera ja està en _aux i, com en el
+         cas general, al final es deixa carregada la següent. */
+      if ( ioop._pos == 0 && n-i >= 5 )
+        {
+          words= (n-i)/5;
+          unpack_chars ( &(to[i]), &ioop._aux, 1 );
+          for ( i+= 5, --words; words > 0; words-= len, i+= 5*len )
+            {
+              len= (size_t) (4000-ioop._addr);
+              if ( len > words ) len= words;
+              unpack_chars ( &(to[i]), &(m->mem[ioop._addr]), len );
+              ioop._addr+= (int) len;
+              if ( ioop._addr == 4000 ) ioop._addr= 0;
+            }
+          ioop._aux= m->mem[ioop._addr];
+          if ( ++ioop._addr == 4000 ) ioop._addr= 0;
+          continue;
+        }
+      to[i++]= (ioop._aux&0x3F000000)>>24;
+      ioop._aux<<= 6;
+      if ( ++ioop._pos == 5 )
+        {
+          ioop._aux= m->mem[ioop._addr];
+          if ( ++ioop._addr == 4000 ) ioop._addr= 0;
+          ioop._pos= 0;
+        }
+    }
+  ioop.remain-= n;
+  *op= ioop;
+  
+  return ioop.remain;
+  
+} /* end MIX_machine_read_chars */
+
+
+size_t
+MIX_machine_write_chars (
+                         MIX_Machine    *m,
+                         const MIX_Char *from,
+                         size_t          nmeb,
+                         MIX_IOOPChar   *op
+                         )
+{
+  
+  MIX_IOOPChar ioop;
+  size_t i, j, n, words, len;
+  
+
+  ioop= *op;
+  n= nmeb < ioop.remain ? nmeb : ioop.remain;
+  for ( i= 0; i < n; )
+    {
+      // Paraules senceres, com a molt en dos trossos.
+      if ( ioop._pos == 0 && ioop._aux == 0 && n-i >= 5 )
+        {
+          for ( words= (n-i)/5; words > 0; words-= len, i+= 5*len )
+            {
+              len= (size_t) (4000-ioop._addr);
+              if ( len > words ) len= words;
+              pack_chars ( &(m->mem[ioop._addr]), &(from[i]), len );
+              for ( j= 0; j < len; ++j )
+                MEM_WRITTEN ( ioop._addr+(int) j );
+              ioop._addr+= (int) len;
+              if ( ioop._addr == 4000 ) ioop._addr= 0;
+            }
+          continue;
+        }
+      ioop._aux<<= 6;
+      ioop._aux|= from[i++]&0x3F;
+      if ( ++ioop._pos == 5 )
+        {
+          m->mem[ioop._addr]= ioop._aux;
+          MEM_WRITTEN ( ioop._addr );
+          if ( ++ioop._addr == 4000 ) ioop._addr= 0;
+          ioop._pos= 0;
+          ioop._aux= 0;
+        }
+    }
+  ioop.remain-= n;
+  *op= ioop;
+  
+  return ioop.remain;
+  
+} /* end MIX_machine_write_chars */
+
+
+size_t
+MIX_machine_read_words (
+                        MIX_Machine  *m,
+                        MIX_Word     *to,
+                        size_t        nmeb,
+                        MIX_IOOPWord *op
+                        )
+{
+  
+  size_t n, i, len;
+  int addr;
+  
+  
+  // Com a molt dos trossos: fins al final de la memòria i des de 0.
+  n= nmeb < op->remain ? nmeb : op->remain;
+  addr= op->_addr;
+  for ( i= 0; i < n; i+= len )
+    {
+      len= (size_t) (4000-addr);
+      if ( len > n-i ) len= n-i;
+      memcpy ( &(to[i]), &(m->mem[addr]), len*sizeof(MIX_Word) );
+      addr+= (int) len;
+      if ( addr == 4000 ) addr= 0;
+    }
+  op->_addr= addr;
+  op->remain-= n;
+  
+  return op->remain;
+  
+} /* end MIX_machine_read_words */
+
+
+size_t
+MIX_machine_write_words (
+                         MIX_Machine    *m,
+                         const MIX_Word *from,
+                         size_t          nmeb,
+                         MIX_IOOPWord   *op
+                         )
+{
+  
+  size_t n, i, j, len;
+  int addr;
+  
+  
+  n= nmeb < op->remain ? nmeb : op->remain;
+  addr= op->_addr;
+  for ( i= 0; i < n; i+= len )
+    {
+      len= (size_t) (4000-addr);
+      if ( len > n-i ) len= n-i;
+      for ( j= 0; j < len; ++j )
+        m->mem[addr+j]= from[i+j]&(NMASK|INMASK);
+      for ( j= 0; j < len; ++j )
+        MEM_WRITTEN ( addr+j );
+      addr+= (int) len;
+      if ( addr == 4000 ) addr= 0;
+    }
+  op->_addr= addr;
+  op->remain-= n;
+  
+  return op->remain;
+  
+} /* end MIX_machine_write_words */
+
+
+size_t
+MIX_chars_to_text (
+                   char                *to,
+                   const MIX_Char      *from,
+                   size_t               n,
+                   const MIX_TextSubst *subst
+                   )
+{
+  
+  char tab[64];
+  uint8_t *p;
+  size_t i, j;
+#ifdef SIMD_SSSE3
+  __m128i t0, t1, t2, t3, mask, lo, hi, idx, r;
+#endif
+  
+  
+  memcpy ( tab, _text, sizeof(tab) );
+  if ( subst != NULL )
+    {
+      tab[MIX_DELTA]= subst->delta;
+      tab[MIX_SIGMA]= subst->sigma;
+      tab[MIX_PI]= subst->pi;
+    }
+  p= (uint8_t *) to;
+  i= 0;
+#ifdef SIMD_SSSE3
+  /* 16 caràcters alhora: els índexs es reduïxen a bytes i es busquen
+     en els 4 trossos de 16 bytes de la taula. Si en el grup hi ha
+     algun caràcter UTF-8 es fa d'un en un. */
+  if ( sizeof(MIX_Char) == sizeof(int32_t) )
+    {
+      t0= _mm_loadu_si128 ( (const __m128i *) &(tab[0]) );
+      t1= _mm_loadu_si128 ( (const __m128i *) &(tab[16]) );
+      t2= _mm_loadu_si128 ( (const __m128i *) &(tab[32]) );
+      t3= _mm_loadu_si128 ( (const __m128i *) &(tab[48]) );
+      mask= _mm_set1_epi32 ( 0x3F );
+      for ( ; i+16 <= n; i+= 16 )
+        {
+          idx= _mm_packus_epi16
+            ( _mm_packs_epi32
+              ( _mm_and_si128 ( _mm_loadu_si128
+                                ( (const __m128i *) &(from[i]) ), mask ),
+                _mm_and_si128 ( _mm_loadu_si128
+                                ( (const __m128i *) &(from[i+4]) ), mask ) ),
+              _mm_packs_epi32
+              ( _mm_and_si128 ( _mm_loadu_si128
+                                ( (const __m128i *) &(from[i+8]) ), mask ),
+                _mm_and_si128 ( _mm_loadu_si128
+                                ( (const __m128i *) &(from[i+12]) ), mask ) ) );
+          lo= _mm_and_si128 ( idx, _mm_set1_epi8 ( 0x0F ) );
+          hi= _mm_and_si128 ( _mm_srli_epi16 ( idx, 4 ), _mm_set1_epi8 ( 0x0F ) );
+          r= _mm_and_si128 ( _mm_shuffle_epi8 ( t0, lo ),
+                             _mm_cmpeq_epi8 ( hi, _mm_set1_epi8 ( 0 ) ) );
+          r= _mm_or_si128 ( r, _mm_and_si128
+                            ( _mm_shuffle_epi8 ( t1, lo ),
+                              _mm_cmpeq_epi8 ( hi, _mm_set1_epi8 ( 1 ) ) ) );
+          r= _mm_or_si128 ( r, _mm_and_si128
+                            ( _mm_shuffle_epi8 ( t2, lo ),
+                              _mm_cmpeq_epi8 ( hi, _mm_set1_epi8 ( 2 ) ) ) );
+          r= _mm_or_si128 ( r, _mm_and_si128
+                            ( _mm_shuffle_epi8 ( t3, lo ),
+                              _mm_cmpeq_epi8 ( hi, _mm_set1_epi8 ( 3 ) ) ) );
+          if ( _mm_movemask_epi8 ( _mm_cmpeq_epi8 ( r,
+                                                    _mm_setzero_si128 () ) ) )
+            for ( j= i; j < i+16; ++j )
+              p= char_to_text ( p, from[j]&0x3F, tab );
+          else
+            {
+              _mm_storeu_si128 ( (__m128i *) p, r );
+              p+= 16;
+            }
+        }
+    }
+#endif
+  for ( j= i; j < n; ++j )
+    p= char_to_text ( p, from[j]&0x3F, tab );
+  
+  return (size_t) (p - (uint8_t *) to);
+  
+} // end MIX_chars_to_text
+
+
+size_t
+MIX_text_to_chars (
+                   MIX_Char            *to,
+                   size_t               n,
+                   const char          *from,
+                   size_t               len,
+                   const MIX_TextSubst *subst,
+                   size_t              *used
+                   )
+{
+  
+  uint8_t buf[128];
+  const uint8_t *tab, *s;
+  size_t i, k;
+  int c;
+#ifdef SIMD_SSSE3
+  __m128i t0, t1, t2, t3, v, lo, hi, r, zero;
+  bool simd;
+#endif
+  
+  
+  tab= _text_chars;
+  if ( subst != NULL )
+    {
+      memcpy ( buf, _text_chars, sizeof(buf) );
+      if ( subst->delta > 0 ) buf[(int) subst->delta]= MIX_DELTA;
+      if ( subst->sigma > 0 ) buf[(int) subst->sigma]= MIX_SIGMA;
+      if ( subst->pi > 0 ) buf[(int) subst->pi]= MIX_PI;
+      tab= buf;
+    }
+  s= (const uint8_t *) from;
+#ifdef SIMD_SSSE3
+  /* Tots els caràcters estan entre ' ' i '_', els 64 bytes de la
+     taula que es busquen amb 4 PSHUFB. Fora d'eixe rang sols pot
+     haver espais, excepte si hi ha algun substitut. */
+  simd= sizeof(MIX_Char) == sizeof(int32_t);
+  if ( subst != NULL )
+    simd= simd &&
+      (subst->delta <= 0 || (subst->delta >= ' ' && subst->delta <= '_')) &&
+      (subst->sigma <= 0 || (subst->sigma >= ' ' && subst->sigma <= '_')) &&
+      (subst->pi <= 0 || (subst->pi >= ' ' && subst->pi <= '_'));
+  t0= _mm_loadu_si128 ( (const __m128i *) &(tab[32]) );
+  t1= _mm_loadu_si128 ( (const __m128i *) &(tab[48]) );
+  t2= _mm_loadu_si128 ( (const __m128i *) &(tab[64]) );
+  t3= _mm_loadu_si128 ( (const __m128i *) &(tab[80]) );
+  zero= _mm_setzero_si128 ();
+#endif
+  for ( i= k= 0; i < n && k < len; )
+    {
+#ifdef SIMD_SSSE3
+      // 16 bytes ASCII alhora, sense '\n' ni '\0'.
+      if ( simd && n-i >= 16 && len-k >= 16 )
+        {
+          v= _mm_loadu_si128 ( (const __m128i *) &(s[k]) );
+          if ( !(_mm_movemask_epi8 ( v ) |
+                 _mm_movemask_epi8
+                 ( _mm_or_si128 ( _mm_cmpeq_epi8 ( v, zero ),
+                                  _mm_cmpeq_epi8
+                                  ( v, _mm_set1_epi8 ( '\n' ) ) ) )) )
+            {
+              v= _mm_sub_epi8 ( v, _mm_set1_epi8 ( ' ' ) );
+              lo= _mm_and_si128 ( v, _mm_set1_epi8 ( 0x0F ) );
+              hi= _mm_srli_epi16 ( _mm_and_si128 ( v, _mm_set1_epi8 ( 0x70 ) ),
+                                   4 );
+              r= _mm_and_si128 ( _mm_shuffle_epi8 ( t0, lo ),
+                                 _mm_cmpeq_epi8 ( hi, zero ) );
+              r= _mm_or_si128 ( r, _mm_and_si128
+                                ( _mm_shuffle_epi8 ( t1, lo ),
+                                  _mm_cmpeq_epi8 ( hi, _mm_set1_epi8 ( 1 ) ) ) );
+              r= _mm_or_si128 ( r, _mm_and_si128
+                                ( _mm_shuffle_epi8 ( t2, lo ),
+                                  _mm_cmpeq_epi8 ( hi, _mm_set1_epi8 ( 2 ) ) ) );
+              r= _mm_or_si128 ( r, _mm_and_si128
+                                ( _mm_shuffle_epi8 ( t3, lo ),
+                                  _mm_cmpeq_epi8 ( hi, _mm_set1_epi8 ( 3 ) ) ) );
+              v= _mm_unpacklo_epi8 ( r, zero );
+              _mm_storeu_si128 ( (__m128i *) &(to[i]),
+                                 _mm_unpacklo_epi16 ( v, zero ) );
+              _mm_storeu_si128 ( (__m128i *) &(to[i+4]),
+                                 _mm_unpackhi_epi16 ( v, zero ) );
+              v= _mm_unpackhi_epi8 ( r, zero );
+              _mm_storeu_si128 ( (__m128i *) &(to[i+8]),
+                                 _mm_unpacklo_epi16 ( v, zero ) );
+              _mm_storeu_si128 ( (__m128i *) &(to[i+12]),
+                                 _mm_unpackhi_epi16 ( v, zero ) );
+              i+= 16;
+              k+= 16;
+              continue;
+            }
+        }
+#endif
+      c= s[k];
+      if ( c < 128 )
+        {
+          if ( tab[c] == TEXT_END ) break;
+          to[i++]= tab[c];
+          ++k;
+        }
+      else if ( c == 0xCE && k+1 < len &&
+                (s[k+1] == 0x94 || s[k+1] == 0xA3 || s[k+1] == 0xA0) )
+        {
+          c= s[k+1];
+          to[i++]= c == 0x94 ? MIX_DELTA : (c == 0xA3 ? MIX_SIGMA : MIX_PI);
+          k+= 2;
+        }
+      else
+        {
+          to[i++]= MIX_SPACE;
+          ++k;
+        }
+    }
+  if ( used != NULL ) *used= k;
+  
+  return i;
+  
+} // end MIX_text_to_chars
+
+
+size_t
+MIX_machine_read_text (
+                       MIX_Machine         *m,
+                       char                *to,
+                       size_t               nmeb,
+                       MIX_IOOPChar        *op,
+                       const MIX_TextSubst *subst,
+                       size_t              *len
+                       )
 {
   
-  int dev;
+  MIX_Char buf[120];
+  size_t i, n, nc, ret;
   
   
-  dev= READ_F;
-  CHECK_DEV_BASE ( dev, return 0 );
-    if ( _device_busy ( _udata, dev ) )
-    {
-      _regs.PC= _regs.old_PC;
-      _run_state.v= WAIT_DEVICE;
-      _run_state.dev= dev;
-      _notify_waiting_device ( _udata, dev, true );
-      return 0;
-    }
-  calc_M_val ();
-  switch ( dev )
+  // Per trossos menuts, així els caràcters intermedis no ixen de la cache.
+  n= nmeb < op->remain ? nmeb : op->remain;
+  ret= 0;
+  for ( i= 0; i < n; i+= nc )
     {
-    case MIX_TAPEUNIT1:
-    case MIX_TAPEUNIT2:
-    case MIX_TAPEUNIT3:
-    case MIX_TAPEUNIT4:
-    case MIX_TAPEUNIT5:
-    case MIX_TAPEUNIT6:
-    case MIX_TAPEUNIT7:
-    case MIX_TAPEUNIT8:
-      if ( _vars.M == 0 )
-        _io_control ( _udata, MIX_MT_REWOUND, dev );
-      else if ( _vars.M < 0 )
-        _io_control ( _udata, MIX_MT_SKIPBACKWARD, dev, -_vars.M*100 );
-      else
-        _io_control ( _udata, MIX_MT_SKIPFORWARD, dev, _vars.M*100 );
-      break;
-    case MIX_LINEPRINTER:
-      if ( _vars.M != 0 )
-        _warning ( _udata, "operació de control (M:%d) no"
-        	   " suportada per l'impresora", _vars.M );
-      else _io_control ( _udata, MIX_LP_SKIPTOFOLLOWINGPAGE );
-      break;
-    default: _warning ( _udata, "el dispositiu %d no suporta"
-        		" operacions de control", dev );
+      nc= n-i < 120 ? n-i : 120;
+      MIX_machine_read_chars ( m, buf, nc, op );
+      ret+= MIX_chars_to_text ( to+ret, buf, nc, subst );
     }
+  if ( len != NULL ) *len= ret;
   
-  return 1;
+  return op->remain;
   
-} /* end IOC */
+} // end MIX_machine_read_text
 
 
-static unsigned int
-SPECIAL ()
+size_t
+MIX_machine_write_text (
+                        MIX_Machine         *m,
+                        const char          *from,
+                        size_t               len,
+                        MIX_IOOPChar        *op,
+                        const MIX_TextSubst *subst
+                        )
 {
   
-  int F;
+  MIX_Char buf[120];
+  size_t n, nc, used;
   
   
-  F= READ_F;
-  switch ( F )
+  while ( op->remain > 0 )
     {
-      
-    case 0: /* NUM */
-      num ();
-      break;
-      
-    case 1: /* CHAR */
-      char_op ();
-      break;
-      
-    case 2:
-      _run_state.v= HALT;
-      break;
-      
-    default:
-      _warning ( _udata,
-        	 "operació C=%d F=%d no vàlida",
-        	 _vars.inst&0x3F, F );
-      
+      n= op->remain < 120 ? op->remain : 120;
+      nc= MIX_text_to_chars ( buf, n, from, len, subst, &used );
+      from+= used;
+      len-= used;
+      for ( ; nc < n; ++nc )
+        buf[nc]= MIX_SPACE;
+      MIX_machine_write_chars ( m, buf, n, op );
     }
   
-  return 10;
+  return op->remain;
   
-} /* end SPECIAL */
-
-
-static unsigned int (*_insts[64]) (void)=
-{
-  NOP,
-  ADD,
-  SUB,
-  MUL,
-  DIV,
-  SPECIAL,
-  SHIFT,
-  MOVE,
-  LDA,
-  LD1,
-  LD2,
-  LD3,
-  LD4,
-  LD5,
-  LD6,
-  LDX,
-  LDAN,
-  LD1N,
-  LD2N,
-  LD3N,
-  LD4N,
-  LD5N,
-  LD6N,
-  LDXN,
-  STA,
-  ST1,
-  ST2,
-  ST3,
-  ST4,
-  ST5,
-  ST6,
-  STX,
-  STJ,
-  STZ,
-  JBUS,
-  IOC,
-  IN,
-  OUT,
-  JRED,
-  JOP,
-  JA,
-  J1,
-  J2,
-  J3,
-  J4,
-  J5,
-  J6,
-  JX,
-  MOPA,
-  MOP1,
-  MOP2,
-  MOP3,
-  MOP4,
-  MOP5,
-  MOP6,
-  MOPX,
-  CMPA,
-  CMP1,
-  CMP2,
-  CMP3,
-  CMP4,
-  CMP5,
-  CMP6,
-  CMPX
-};
-
-
+} // end MIX_machine_write_text
 
 
-/**********************/
-/* FUNCIONS PÚBLIQUES */
-/**********************/
+// Interfície sobre la màquina per defecte.
 
 void
 MIX_go (void)
 {
-  _run_state.v= RUNNING_GO_STEP0;
+  MIX_machine_go ( &_default );
 } // end MIX_go
 
 
@@ -1703,40 +8363,7 @@ MIX_init (
           void               *udata
           )
 {
-  
-  int i;
-  
-  
-  _regs.A= _regs.X= 0;
-  for ( i= 0; i < 6; ++i )
-    _regs.I[i]= 0;
-  _regs.J= 0;
-  _regs.PC= 0;
-  
-  memset ( &(_mem[0]), 0, 16000 /* 4000 * 4 */ );
-  
-  _vars.inst= 0;
-  _vars.L= 0;
-  _vars.R= 5;
-  _vars.M= 0;
-  
-  _overflow= OFF;
-  _cmp= EQUAL;
-  
-  _init_ioopchar= frontend->init_ioopchar;
-  _init_ioopword= frontend->init_ioopword;
-  _device_busy= frontend->device_busy;
-  _io_control= frontend->io_control;
-  _notify_waiting_device= frontend->notify_waiting_device;
-  
-  _warning= frontend->warning;
-  _udata= udata;
-  
-  _check= frontend->check;
-  
-  _run_state.v= HALT;
-  _run_state.notify_cr= false;
-  
+  MIX_machine_init ( &_default, frontend, udata );
 } // end MIX_init
 
 
@@ -1746,122 +8373,7 @@ MIX_iter (
           MIX_Bool  *halt
           )
 {
-
-  static MIX_IOOPChar ioop; // Operació inicial
-  
-  int cc_remain,cc_total,tmp;
-  MIX_Bool stop;
-
-  
-
-  cc_remain= cc;
-  cc_total= 0;
-  *halt= MIX_FALSE;
-  while ( cc_remain > 0 )
-    switch ( _run_state.v )
-      {
-        
-      case RUNNING: // Executa següent instrucció.
-        _regs.old_PC= _regs.PC;
-        _vars.inst= _mem[_regs.PC];
-        if ( ++_regs.PC == 4000 ) _regs.PC= 0;
-        tmp= _insts[_vars.inst&0x3F] ();
-        cc_remain-= tmp;
-        cc_total+= tmp;
-        break;
-
-      case HALT:
-        *halt= MIX_TRUE;
-        cc_total+= cc_remain;
-        cc_remain= 0;
-        break;
-
-      case WAIT_DEVICE:
-        if ( _device_busy ( _udata, _run_state.dev ) )
-          {
-            cc_total+= cc_remain;
-            cc_remain= 0;
-          }
-        else
-          {
-            _run_state.v= RUNNING;
-            _notify_waiting_device ( _udata, _run_state.dev, false );
-          }
-        break;
-        
-      case RUNNING_GO_STEP0:
-        if ( _device_busy ( _udata, MIX_CARDREADER ) )
-          {
-            cc_total+= cc_remain;
-            cc_remain= 0;
-            if ( !_run_state.notify_cr )
-              {
-                _run_state.notify_cr= true;
-                _notify_waiting_device ( _udata, MIX_CARDREADER, true );
-              }
-          }
-        else
-          {
-            if ( _run_state.notify_cr )
-              {
-                _notify_waiting_device ( _udata, MIX_CARDREADER, false );
-                _run_state.notify_cr= false;
-              }
-            // LLig una targeta en 0.
-            ioop.remain= 80; // Vore inout.
-            ioop._pos= 0;
-            ioop._addr= 0;
-            ioop._aux= 0;
-            _init_ioopchar ( _udata, MIX_CARDREADER, &ioop, MIX_IN );
-            _run_state.v= RUNNING_GO_STEP1;
-          }
-        break;
-        
-      case RUNNING_GO_STEP1:
-        if ( _device_busy ( _udata, MIX_CARDREADER ) )
-          {
-            cc_total+= cc_remain;
-            cc_remain= 0;
-            if ( !_run_state.notify_cr )
-              {
-                _run_state.notify_cr= true;
-                _notify_waiting_device ( _udata, MIX_CARDREADER, true );
-              }
-          }
-        else
-          {
-            if ( _run_state.notify_cr )
-              {
-                _notify_waiting_device ( _udata, MIX_CARDREADER, false );
-                _run_state.notify_cr= false;
-              }
-            _regs.PC= 0;
-            _regs.J= 0;
-            _run_state.v= RUNNING;
-          }
-        break;
-        
-      }
-  
-  if ( _check != NULL )
-    {
-      _check ( _udata, &stop );
-      if ( stop )
-        {
-          *halt= MIX_TRUE;
-          if ( _run_state.v == WAIT_DEVICE )
-            _notify_waiting_device ( _udata, _run_state.dev, false );
-          else if ( _run_state.notify_cr )
-            {
-              _notify_waiting_device ( _udata, MIX_CARDREADER, false );
-              _run_state.notify_cr= false;
-            }
-          _run_state.v= HALT;
-        }
-    }
-
-  return cc_total;
-  
+  return MIX_machine_iter ( &_default, cc, halt );
 } // end MIX_iter
 
 
@@ -1872,28 +8384,7 @@ MIX_read_chars (
         	MIX_IOOPChar *op
         	)
 {
-  
-  MIX_IOOPChar ioop;
-  size_t i;
-  
-  
-  ioop= *op;
-  for ( i= 0; i < nmeb && ioop.remain > 0;
-        ++i, --ioop.remain )
-    {
-      to[i]= (ioop._aux&0x3F000000)>>24;
-      ioop._aux<<= 6;
-      if ( ++ioop._pos == 5 )
-        {
-          ioop._aux= _mem[ioop._addr];
-          if ( ++ioop._addr == 4000 ) ioop._addr= 0;
-          ioop._pos= 0;
-        }
-    }
-  *op= ioop;
-  
-  return ioop.remain;
-  
+  return MIX_machine_read_chars ( &_default, to, nmeb, op );
 } /* end MIX_read_chars */
 
 
@@ -1904,29 +8395,7 @@ MIX_write_chars (
         	 MIX_IOOPChar   *op
         	 )
 {
-  
-  MIX_IOOPChar ioop;
-  size_t i;
-  
-
-  ioop= *op;
-  for ( i= 0; i < nmeb && ioop.remain > 0;
-        ++i, --ioop.remain )
-    {
-      ioop._aux<<= 6;
-      ioop._aux|= from[i]&0x3F;
-      if ( ++ioop._pos == 5 )
-        {
-          _mem[ioop._addr]= ioop._aux;
-          if ( ++ioop._addr == 4000 ) ioop._addr= 0;
-          ioop._pos= 0;
-          ioop._aux= 0;
-        }
-    }
-  *op= ioop;
-  
-  return ioop.remain;
-  
+  return MIX_machine_write_chars ( &_default, from, nmeb, op );
 } /* end MIX_write_chars */
 
 
@@ -1937,22 +8406,7 @@ MIX_read_words (
         	MIX_IOOPWord *op
         	)
 {
-  
-  MIX_IOOPWord ioop;
-  size_t i;
-  
-  
-  ioop= *op;
-  for ( i= 0; i < nmeb && ioop.remain > 0;
-        ++i, --ioop.remain )
-    {
-      to[i]= _mem[ioop._addr];
-      if ( ++ioop._addr == 4000 ) ioop._addr= 0;
-    }
-  *op= ioop;
-  
-  return ioop.remain;
-  
+  return MIX_machine_read_words ( &_default, to, nmeb, op );
 } /* end MIX_read_words */
 
 
@@ -1963,20 +8417,5 @@ MIX_write_words (
         	 MIX_IOOPWord   *op
         	 )
 {
-  
-  MIX_IOOPWord ioop;
-  size_t i;
-  
-  
-  ioop= *op;
-  for ( i= 0; i < nmeb && ioop.remain > 0;
-        ++i, --ioop.remain )
-    {
-      _mem[ioop._addr]= from[i]&(NMASK|INMASK);
-      if ( ++ioop._addr == 4000 ) ioop._addr= 0;
-    }
-  *op= ioop;
-  
-  return ioop.remain;
-  
+  return MIX_machine_write_words ( &_default, from, nmeb, op );
 } /* end MIX_write_words */
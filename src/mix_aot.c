@@ -0,0 +1,721 @@
+/*
+ * Copyright 2009-2022 Adrià Giménez Pastor.
+ *
+ * This file is part of adriagipas/MIX.
+ *
+ * adriagipas/MIX is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * adriagipas/MIX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with adriagipas/MIX.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ *  mix_aot.c - Traducció a C d'imatges de memòria (MIX_aot_translate).
+ *
+ */
+
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "MIX.h"
+
+
+
+
+/**********/
+/* MACROS */
+/**********/
+
+#define NMASK 0x80000000
+#define INMASK 0x3FFFFFFF
+
+/* Qualsevol error d'escriptura acaba la traducció. */
+#define OUT(ARGS)        						\
+  if ( fprintf ARGS < 0 ) return false
+
+
+
+
+/*********/
+/* TIPUS */
+/*********/
+
+/* Instrucció descodificada. */
+typedef struct
+{
+
+  MIXu32 w;
+  int    C;
+  int    F;
+  int    I;
+  int    addr;  // Adreça amb signe (sense sumar l'índex)
+  bool   field; // F és un camp (L:R) vàlid
+  bool   sign;  // El camp inclou el signe
+  int    shift; // Desplaçament del byte R a la posició 5
+  MIXu32 mask;  // Màscara dels bytes del camp ja desplaçats
+
+} inst_t;
+
+
+
+
+/*********/
+/* ESTAT */
+/*********/
+
+/* Codi comú a totes les traduccions. Reproduïx la semàntica de
+   l'intèrpret, inclòs SLA/SRA amb més de 5 bytes, on l'intèrpret
+   depén de que la CPU només use els 5 bits baixos del desplaçament.
+   WRITTEN ix del bloc si la paraula escrita té alguna marca en
+   'code', excepte si sols té la de les còpies (CODE_SNAP, 0x20 en
+   mix.c), on només marca la pàgina en 'dirty'. */
+static const char *_preamble=
+  "#include <stdint.h>\n"
+  "\n"
+  "#include \"MIX.h\"\n"
+  "\n"
+  "#define NMASK 0x80000000u\n"
+  "#define INMASK 0x3FFFFFFFu\n"
+  "#define IMASK 0x80000FFFu\n"
+  "#define IVAL(R) (((R)&NMASK) ? -(int) ((R)&0xFFF) : (int) ((R)&0xFFF))\n"
+  "#define S32(W) (((W)&NMASK) ? -(int) ((W)&INMASK) : (int) ((W)&INMASK))\n"
+  "#define FLD(W,SIGN,SHIFT,MASK) \\\n"
+  "  (((SIGN) ? (W)&NMASK : 0) | (((W)>>(SHIFT))&(MASK)))\n"
+  "#define STEP(PC,CC,N) \\\n"
+  "  do { s->cc+= (CC); s->insts-= (N); return -1-(PC); } while ( 0 )\n"
+  "#define CHECK_M(PC,CC,N) if ( (unsigned int) M > 3999 ) STEP ( PC, CC, N )\n"
+  "#define WRITTEN(NEXT,CC,N) \\\n"
+  "  if ( s->code[M]&~0x20 ) \\\n"
+  "    { s->written= M; s->cc+= (CC); s->insts-= (N); return (NEXT); } \\\n"
+  "  else if ( s->code[M] ) s->dirty|= 1ull<<(M>>6)\n"
+  "\n"
+  "static MIXu32\n"
+  "add_aux (MIX_AOTState *s, MIXu32 reg, int val)\n"
+  "{\n"
+  "  if ( val == 0 ) return reg&NMASK;\n"
+  "  if ( val < 0 ) { reg= NMASK; val= -val; }\n"
+  "  else reg= 0;\n"
+  "  if ( val&0xC0000000 ) s->overflow= 1;\n"
+  "  return reg | (((MIXu32) val)&INMASK);\n"
+  "}\n"
+  "\n"
+  "static void\n"
+  "mul (MIX_AOTState *s, MIXu32 v)\n"
+  "{\n"
+  "  int64_t res= (int64_t) S32 ( s->A ) * (int64_t) S32 ( v );\n"
+  "  if ( res < 0 ) { s->A= s->X= NMASK; res= -res; }\n"
+  "  else s->A= s->X= 0;\n"
+  "  s->X|= (MIXu32) (res&INMASK);\n"
+  "  s->A|= (MIXu32) ((res>>30)&INMASK);\n"
+  "}\n"
+  "\n"
+  "static void\n"
+  "num (MIX_AOTState *s)\n"
+  "{\n"
+  "  MIXu32 res= 0;\n"
+  "  int i;\n"
+  "  for ( i= 24; i != -6; i-= 6 ) res= res*10 + ((s->A>>i)&0x3F)%10;\n"
+  "  for ( i= 24; i != -6; i-= 6 ) res= res*10 + ((s->X>>i)&0x3F)%10;\n"
+  "  s->A= (s->A&NMASK) | (res&INMASK);\n"
+  "}\n"
+  "\n"
+  "static void\n"
+  "char_op (MIX_AOTState *s)\n"
+  "{\n"
+  "  MIXu32 aux= s->A&INMASK, aux2= 0;\n"
+  "  int i;\n"
+  "  for ( i= 0; i < 5; ++i ) { aux2= (aux2>>6) | (((aux%10)+30)<<24); aux/= 10; }\n"
+  "  s->X= (s->X&NMASK) | aux2;\n"
+  "  aux2= 0;\n"
+  "  for ( i= 0; i < 5; ++i ) { aux2= (aux2>>6) | (((aux%10)+30)<<24); aux/= 10; }\n"
+  "  s->A= (s->A&NMASK) | aux2;\n"
+  "}\n"
+  "\n"
+  "static void\n"
+  "shift (MIX_AOTState *s, int F, int M)\n"
+  "{\n"
+  "  MIXu32 sA= s->A&NMASK, sX= s->X&NMASK, A= s->A, X= s->X;\n"
+  "  if ( F < 4 ) M= (M > 10 ? 10 : M)*6;\n"
+  "  else M= (M%10)*6;\n"
+  "  switch ( F )\n"
+  "    {\n"
+  "    case 0: s->A= ((A<<(M&31))&INMASK)|sA; break;\n"
+  "    case 1: s->A= ((A&INMASK)>>(M&31))|sA; break;\n"
+  "    case 2:\n"
+  "      if ( M < 30 )\n"
+  "        {\n"
+  "          s->A= (((A<<M)|((X&INMASK)>>(30-M)))&INMASK)|sA;\n"
+  "          s->X= ((X<<M)&INMASK)|sX;\n"
+  "        }\n"
+  "      else { s->A= ((X<<(M-30))&INMASK)|sA; s->X= sX; }\n"
+  "      break;\n"
+  "    case 3:\n"
+  "      if ( M < 30 )\n"
+  "        {\n"
+  "          s->X= ((((X&INMASK)>>M)|(A<<(30-M)))&INMASK)|sX;\n"
+  "          s->A= ((A&INMASK)>>M)|sA;\n"
+  "        }\n"
+  "      else { s->X= ((A&INMASK)>>(M-30))|sX; s->A= sA; }\n"
+  "      break;\n"
+  "    case 4:\n"
+  "      if ( M >= 30 ) { M-= 30; A= s->X; X= s->A; }\n"
+  "      s->A= (((A<<M)|((X&INMASK)>>(30-M)))&INMASK)|sA;\n"
+  "      s->X= (((X<<M)|((A&INMASK)>>(30-M)))&INMASK)|sX;\n"
+  "      break;\n"
+  "    default:\n"
+  "      if ( M >= 30 ) { M-= 30; A= s->X; X= s->A; }\n"
+  "      s->X= ((((X&INMASK)>>M)|(A<<(30-M)))&INMASK)|sX;\n"
+  "      s->A= ((((A&INMASK)>>M)|(X<<(30-M)))&INMASK)|sA;\n"
+  "      break;\n"
+  "    }\n"
+  "}\n"
+  "\n";
+
+/* Nom dels registres en MIX_AOTState: A, I1-I6, X, J. */
+static const char *_regs[]=
+  {
+    "s->A", "s->I[0]", "s->I[1]", "s->I[2]", "s->I[3]", "s->I[4]",
+    "s->I[5]", "s->X", "s->J"
+  };
+
+
+
+
+/************/
+/* FUNCIONS */
+/************/
+
+static void
+decode (
+        const MIXu32  w,
+        inst_t       *in
+        )
+{
+
+  int L, R;
+
+
+  in->w= w;
+  in->C= w&0x3F;
+  in->F= (w>>6)&0x3F;
+  in->I= (w>>12)&0x3F;
+  in->addr= (w>>18)&0xFFF;
+  if ( w&NMASK ) in->addr= -in->addr;
+  L= in->F>>3;
+  R= in->F&0x7;
+  in->field= !(L > 5 || R > 5 || L > R);
+  in->sign= (L == 0);
+  if ( L == 0 ) L= 1;
+  in->shift= 6*(5-R);
+  in->mask= R != 0 ? ~(0xFFFFFFFF<<(6*(R-L+1))) : 0;
+
+} /* end decode */
+
+
+/* Torna els cicles de la instrucció, o 0 si no es tradueix (i/o, HLT,
+ * MOVE, DIV, valors no vàlids o adreces fora de rang que generen
+ * avisos). Aquestes instruccions les executa l'intèrpret.
+ */
+static int
+cost (
+      const inst_t *in,
+      bool         *jump
+      )
+{
+
+  bool ok_M;
+
+
+  *jump= false;
+  if ( in->I > 6 ) return 0;
+  ok_M= in->I != 0 || (in->addr >= 0 && in->addr <= 3999);
+  switch ( in->C )
+    {
+    case 0: return 1;
+    case 1:
+    case 2: return in->field && ok_M ? 2 : 0;
+    case 3: return in->field && ok_M ? 10 : 0;
+    case 5: return in->F < 2 ? 10 : 0;
+    case 6: return in->F <= 5 ? 2 : 0;
+    case 4:
+    case 7:
+    case 34:
+    case 35:
+    case 36:
+    case 37:
+    case 38: return 0;
+    default:
+      if ( in->C >= 39 && in->C <= 47 )
+        {
+          if ( !ok_M || in->F > (in->C == 39 ? 9 : 5) ) return 0;
+          *jump= true;
+          return 1;
+        }
+      else if ( in->C >= 48 && in->C <= 55 ) return in->F <= 3 ? 1 : 0;
+      else return in->field && ok_M ? 2 : 0;
+    }
+
+} /* end cost */
+
+
+/* Escriu en F el càlcul de M. */
+static bool
+out_M (
+       FILE         *f,
+       const inst_t *in
+       )
+{
+
+  if ( in->I == 0 ) { OUT (( f, "  M= %d;\n", in->addr )); }
+  else { OUT (( f, "  M= %d + IVAL ( s->I[%d] );\n", in->addr, in->I-1 )); }
+
+  return true;
+
+} /* end out_M */
+
+
+/* Escriu en F el camp (L:R) de mem[M]. */
+static bool
+out_fld (
+         FILE         *f,
+         const inst_t *in,
+         const char   *word
+         )
+{
+
+  OUT (( f, "FLD ( %s, %d, %d, 0x%08Xu )",
+         word, in->sign, in->shift, in->mask ));
+
+  return true;
+
+} /* end out_fld */
+
+
+static bool
+out_inst (
+          FILE         *f,
+          const inst_t *in,
+          const int     pc,
+          const int     refund,
+          const int     irefund,
+          const int     cc
+          )
+{
+
+  int next, r;
+  MIXu32 mask, val;
+  const char *reg;
+
+
+  next= pc == 3999 ? 0 : pc+1;
+  OUT (( f, "\n  /* %04d: C=%d F=%d */\n", pc, in->C, in->F ));
+
+  /* ADD, SUB, MUL. */
+  if ( in->C >= 1 && in->C <= 3 )
+    {
+      if ( !out_M ( f, in ) ) return false;
+      OUT (( f, "  CHECK_M ( %d, %d, %d );\n  v= ", pc, refund, irefund ));
+      if ( !out_fld ( f, in, "mem[M]" ) ) return false;
+      if ( in->C == 3 ) { OUT (( f, ";\n  mul ( s, v );\n" )); }
+      else
+        {
+          OUT (( f, ";\n  s->A= add_aux ( s, s->A, S32 ( s->A ) %c S32 ( v ) );\n",
+        	 in->C == 1 ? '+' : '-' ));
+        }
+    }
+
+  /* NUM, CHAR. */
+  else if ( in->C == 5 )
+    {
+      OUT (( f, "  %s ( s );\n", in->F == 0 ? "num" : "char_op" ));
+    }
+
+  /* SHIFT. Amb M negatiu es genera un avís. */
+  else if ( in->C == 6 )
+    {
+      if ( !out_M ( f, in ) ) return false;
+      OUT (( f, "  if ( M < 0 ) STEP ( %d, %d, %d );\n", pc, refund, irefund ));
+      OUT (( f, "  shift ( s, %d, M );\n", in->F ));
+    }
+
+  /* LD, LDN. */
+  else if ( in->C >= 8 && in->C <= 23 )
+    {
+      r= in->C&0x7;
+      if ( !out_M ( f, in ) ) return false;
+      OUT (( f, "  CHECK_M ( %d, %d, %d );\n  %s= ",
+             pc, refund, irefund, _regs[r] ));
+      if ( in->C >= 16 ) { OUT (( f, "(" )); }
+      if ( !out_fld ( f, in, "mem[M]" ) ) return false;
+      if ( in->C >= 16 ) { OUT (( f, "^NMASK)" )); }
+      if ( r != 0 && r != 7 ) { OUT (( f, "&IMASK" )); }
+      OUT (( f, ";\n" ));
+    }
+
+  /* ST. */
+  else if ( in->C >= 24 && in->C <= 33 )
+    {
+      reg= in->C == 33 ? "0u" : _regs[in->C-24];
+      if ( !out_M ( f, in ) ) return false;
+      OUT (( f, "  CHECK_M ( %d, %d, %d );\n", pc, refund, irefund ));
+      if ( in->F == 5 )
+        {
+          OUT (( f, "  mem[M]= %s&(NMASK|INMASK);\n", reg ));
+        }
+      else
+        {
+          OUT (( f, "  v= mem[M];\n" ));
+          if ( in->sign )
+            {
+              OUT (( f, "  v= (v&INMASK) | (%s&NMASK);\n", reg ));
+            }
+          mask= in->mask<<in->shift;
+          if ( mask != 0 )
+            {
+              OUT (( f, "  v= (v&0x%08Xu) | ((%s<<%d)&0x%08Xu);\n",
+        	     ~mask, reg, in->shift, mask ));
+            }
+          OUT (( f, "  mem[M]= v;\n" ));
+        }
+      OUT (( f, "  WRITTEN ( %d, %d, %d );\n", next, refund-cc, irefund-1 ));
+    }
+
+  /* MOP. */
+  else if ( in->C >= 48 && in->C <= 55 )
+    {
+      r= in->C-48;
+      reg= _regs[r];
+      if ( in->F < 2 )
+        {
+          if ( !out_M ( f, in ) ) return false;
+          OUT (( f, "  %s= add_aux ( s, %s, S32 ( %s ) %c M )",
+        	 reg, reg, reg, in->F ? '-' : '+' ));
+        }
+      else if ( in->I == 0 )
+        {
+          if ( in->addr == 0 ) val= in->w&NMASK;
+          else if ( in->addr < 0 ) val= NMASK | (MIXu32) (-in->addr);
+          else val= (MIXu32) in->addr;
+          if ( in->F == 3 ) val^= NMASK;
+          OUT (( f, "  %s= 0x%08Xu", reg, val ));
+        }
+      else
+        {
+          if ( !out_M ( f, in ) ) return false;
+          OUT (( f, "  %s= (M == 0 ? 0x%08Xu : "
+        	 "(M < 0 ? NMASK|(MIXu32) -M : (MIXu32) M))",
+        	 reg, in->w&NMASK ));
+          if ( in->F == 3 ) { OUT (( f, "^NMASK" )); }
+        }
+      if ( r != 0 && r != 7 ) { OUT (( f, ";\n  %s&= IMASK", reg )); }
+      OUT (( f, ";\n" ));
+    }
+
+  /* CMP. */
+  else if ( in->C >= 56 )
+    {
+      reg= _regs[in->C-56];
+      if ( !out_M ( f, in ) ) return false;
+      OUT (( f, "  CHECK_M ( %d, %d, %d );\n", pc, refund, irefund ));
+      if ( in->mask == 0 ) { OUT (( f, "  s->cmp= 0;\n" )); }
+      else
+        {
+          OUT (( f, "  op1= (int) ((%s>>%d)&0x%08Xu);\n",
+        	 reg, in->shift, in->mask ));
+          OUT (( f, "  op2= (int) ((mem[M]>>%d)&0x%08Xu);\n",
+        	 in->shift, in->mask ));
+          if ( in->sign )
+            {
+              OUT (( f, "  if ( %s&NMASK ) op1= -op1;\n", reg ));
+              OUT (( f, "  if ( mem[M]&NMASK ) op2= -op2;\n" ));
+            }
+          OUT (( f, "  s->cmp= op1 == op2 ? 0 : (op1 < op2 ? 1 : 2);\n" ));
+        }
+    }
+
+  return true;
+
+} /* end out_inst */
+
+
+/* Salt final d'un bloc. Es llig la paraula de memòria, ja que és
+ * habitual que el programa modifique l'adreça (per exemple amb STJ
+ * per a tornar de les subrutines). Si ha canviat C, F o I
+ * l'executa l'intèrpret.
+ */
+static bool
+out_jump (
+          FILE         *f,
+          const inst_t *in,
+          const int     pc
+          )
+{
+
+  static const char *conds[]=
+    {
+      "S32 ( %s ) < 0", "S32 ( %s ) == 0", "S32 ( %s ) > 0",
+      "S32 ( %s ) >= 0", "S32 ( %s ) != 0", "S32 ( %s ) <= 0"
+    };
+  static const char *jops[]=
+    {
+      "1", "1", "s->overflow", "!s->overflow", "s->cmp == 1",
+      "s->cmp == 0", "s->cmp == 2", "s->cmp != 1", "s->cmp != 0",
+      "s->cmp != 2"
+    };
+
+  int next;
+
+
+  next= pc == 3999 ? 0 : pc+1;
+  OUT (( f, "\n  /* %04d: C=%d F=%d */\n", pc, in->C, in->F ));
+  OUT (( f, "  v= mem[%d];\n", pc ));
+  OUT (( f, "  if ( v == 0x%08Xu ) M= %d;\n", in->w, in->addr ));
+  OUT (( f, "  else if ( ((v^0x%08Xu)&0x4003FFFFu) == 0 )\n"
+         "    M= (v&NMASK) ? -(int) ((v>>18)&0xFFF) : (int) ((v>>18)&0xFFF);\n"
+         "  else STEP ( %d, 1, 1 );\n", in->w, pc ));
+  if ( in->I != 0 ) { OUT (( f, "  M+= IVAL ( s->I[%d] );\n", in->I-1 )); }
+  OUT (( f, "  CHECK_M ( %d, 1, 1 );\n", pc ));
+  if ( in->C == 39 )
+    {
+      OUT (( f, "  if ( %s )\n    {\n", jops[in->F] ));
+      if ( in->F == 2 ) { OUT (( f, "      s->overflow= 0;\n" )); }
+    }
+  else
+    {
+      OUT (( f, "  if ( " ));
+      OUT (( f, conds[in->F], _regs[in->C == 47 ? 7 : in->C-40] ));
+      OUT (( f, " )\n    {\n" ));
+    }
+  if ( in->C != 39 || in->F != 1 ) { OUT (( f, "      s->J= %d;\n", next )); }
+  OUT (( f, "      return M;\n    }\n" ));
+  if ( in->C == 39 && in->F == 3 ) { OUT (( f, "  s->overflow= 0;\n" )); }
+  OUT (( f, "  return %d;\n", next ));
+
+  return true;
+
+} /* end out_jump */
+
+
+/* Marca com a inici de bloc les adreces accessibles des de PC. */
+static void
+find_leaders (
+              const MIX_Word  mem[4000],
+              const int       pc,
+              bool            leader[4000]
+              )
+{
+
+  int queue[2*4000+1], n, a;
+  inst_t in;
+  bool jump;
+
+
+  n= 0;
+  queue[n++]= pc;
+  while ( n > 0 )
+    {
+      a= queue[--n];
+      if ( a < 0 || a > 3999 || leader[a] ) continue;
+      leader[a]= true;
+      for ( ;; )
+        {
+          decode ( mem[a], &in );
+          if ( cost ( &in, &jump ) == 0 || jump )
+            {
+              if ( jump && in.I == 0 ) queue[n++]= in.addr;
+              queue[n++]= a == 3999 ? 0 : a+1;
+              break;
+            }
+          if ( a == 3999 )
+            {
+              queue[n++]= 0;
+              break;
+            }
+          ++a;
+        }
+    }
+
+} /* end find_leaders */
+
+
+/* Escriu el bloc que comença en PC. END és la primera paraula que no
+   forma part del bloc (sense contar el salt final). Torna 1 si s'ha
+   escrit el bloc, 0 si la primera instrucció no es pot traduir i -1
+   si hi ha error. */
+static int
+out_block (
+           FILE           *f,
+           const MIX_Word  mem[4000],
+           const bool      leader[4000],
+           const int       pc,
+           short           owner[4000],
+           short          *end
+           )
+{
+
+  inst_t in;
+  int a, total, last, refund, cc, n;
+  bool jump, term;
+
+
+  /* Delimita. */
+  total= last= 0;
+  term= false;
+  for ( a= pc; a < 4000 && (a == pc || !leader[a]); ++a )
+    {
+      decode ( mem[a], &in );
+      cc= cost ( &in, &jump );
+      if ( cc == 0 ) break;
+      total+= cc;
+      last= cc;
+      if ( jump ) { term= true; break; }
+    }
+  if ( total == 0 ) return 0;
+  *end= (short) a;
+  n= a-pc + (term ? 1 : 0);
+
+  /* Capçalera. Si no queden cicles per a executar el bloc sencer
+     torna a l'intèrpret. */
+  OUT (( f,
+         "\nstatic int\nb%04d (MIX_AOTState *s)\n{\n\n"
+         "  MIXu32 *mem= s->mem, v;\n"
+         "  int M, op1, op2;\n\n"
+         "  (void) v; (void) M; (void) op1; (void) op2;\n"
+         "  if ( s->cc <= %d ) return -1-%d;\n"
+         "  s->cc-= %d;\n"
+         "  s->insts+= %d;\n",
+         pc, total-last, pc, total, n ));
+
+  /* Instruccions. */
+  refund= total;
+  for ( a= pc; a < *end; ++a )
+    {
+      decode ( mem[a], &in );
+      cc= cost ( &in, &jump );
+      if ( !out_inst ( f, &in, a, refund, n-(a-pc), cc ) ) return -1;
+      refund-= cc;
+      owner[a]= (short) pc;
+    }
+  if ( term )
+    {
+      decode ( mem[a], &in );
+      if ( !out_jump ( f, &in, a ) ) return -1;
+    }
+  else OUT (( f, "  return %d;\n", a == 4000 ? 0 : a ));
+  OUT (( f, "}\n" ));
+
+  return 1;
+
+} /* end out_block */
+
+
+/* Escriu una taula de 4000 sencers. */
+static bool
+out_table (
+           FILE        *f,
+           const char  *decl,
+           const short *v
+           )
+{
+
+  int i;
+
+
+  OUT (( f, "\n%s[4000]=\n  {", decl ));
+  for ( i= 0; i < 4000; ++i )
+    OUT (( f, "%s%d,", i%16 ? " " : "\n    ", v[i] ));
+  OUT (( f, "\n  };\n" ));
+
+  return true;
+
+} /* end out_table */
+
+
+static bool
+translate (
+           const MIX_Word  mem[4000],
+           const int      *entries,
+           const int       nentries,
+           FILE           *f,
+           int            *nblocks
+           )
+{
+
+  bool leader[4000], done[4000];
+  short owner[4000], end[4000];
+  int i, ret;
+
+
+  memset ( leader, 0, sizeof(leader) );
+  for ( i= 0; i < nentries; ++i )
+    find_leaders ( mem, entries[i], leader );
+  OUT (( f, "/* Generat per MIX_aot_translate. */\n\n%s", _preamble ));
+
+  /* Blocs. */
+  *nblocks= 0;
+  for ( i= 0; i < 4000; ++i )
+    {
+      owner[i]= end[i]= -1;
+      done[i]= false;
+    }
+  for ( i= 0; i < 4000; ++i )
+    if ( leader[i] )
+      {
+        ret= out_block ( f, mem, leader, i, owner, &end[i] );
+        if ( ret == -1 ) return false;
+        done[i]= (ret == 1);
+        *nblocks+= ret;
+      }
+
+  /* Taules. */
+  OUT (( f, "\nstatic MIX_AOTBlock *const table[4000]=\n  {\n" ));
+  for ( i= 0; i < 4000; ++i )
+    if ( done[i] )
+      OUT (( f, "    [%d]= b%04d,\n", i, i ));
+  OUT (( f, "  };\n" ));
+  OUT (( f, "\nstatic const MIX_Word image[4000]=\n  {" ));
+  for ( i= 0; i < 4000; ++i )
+    OUT (( f, "%s0x%08Xu,", i%6 ? " " : "\n    ", mem[i] ));
+  OUT (( f, "\n  };\n" ));
+  if ( !out_table ( f, "static const short owner", owner ) ||
+       !out_table ( f, "static const short end", end ) )
+    return false;
+  OUT (( f,
+         "\nconst MIX_AOTModule MIX_aot_module=\n"
+         "  {\n"
+         "    MIX_AOT_VERSION,\n"
+         "    image,\n"
+         "    table,\n"
+         "    owner,\n"
+         "    end\n"
+         "  };\n" ));
+
+  return true;
+
+} /* end translate */
+
+
+int
+MIX_aot_translate (
+                   const MIX_Word  mem[4000],
+                   const int      *entries,
+                   const int       nentries,
+                   FILE           *f
+                   )
+{
+
+  int nblocks;
+
+
+  return translate ( mem, entries, nentries, f, &nblocks ) ? nblocks : -1;
+
+} /* end MIX_aot_translate */
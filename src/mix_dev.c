@@ -0,0 +1,1060 @@
+/*
+ * Copyright 2009-2022 Adrià Giménez Pastor.
+ *
+ * This file is part of adriagipas/MIX.
+ *
+ * adriagipas/MIX is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * adriagipas/MIX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with adriagipas/MIX.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ *  mix_dev.c - Dispositius d'entrada/eixida sobre fitxers (MIX_Devices).
+ *
+ */
+/*
+ * Les transferències es fan completes dins de init_ioopchar i
+ * init_ioopword, per tant els dispositius mai estan ocupats. Les
+ * cintes i els discs guarden blocs de 100 paraules de 4 bytes en
+ * 'big endian', en el format de MIX_Word, o són imatges projectades
+ * en memòria (img_header_t seguida de les paraules). Les targetes,
+ * l'impresora, el terminal i la cinta de paper són fitxers de text
+ * amb una línia per registre.
+ *
+ * Amb fils de treball (MIX_devices_set_workers) la part de fitxer de
+ * les operacions es fa en un altre fil. La còpia des de o cap a la
+ * memòria de la màquina es fa sempre en el fil de la màquina: en
+ * iniciar l'eixida, i en la primera crida a device_busy després
+ * d'acabar l'entrada. Així la memòria està actualitzada abans que
+ * JBUS/JRED vegen el dispositiu preparat.
+ */
+
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MIX.h"
+
+
+
+
+/**********/
+/* MACROS */
+/**********/
+
+#define NDEVS 21
+
+#define BLOCK_WORDS 100
+#define BLOCK_BYTES (4*BLOCK_WORDS)
+
+// Targetes que es lligen de colp del lector.
+#define CARD_BLOCK 16
+
+// Línies per pàgina de l'impresora.
+#define PAGE_LINES 66
+
+#define FILE_BUF_SIZE (64*1024)
+
+#define MAX_WORKERS 8
+
+#define IMG_MAGIC "MIXIMG1"
+#define IMG_ORDER 0x01020304
+
+// Paraules d'una imatge nova. Creix al doble quan s'escriu fora.
+#define IMG_INITIAL_WORDS (64*BLOCK_WORDS)
+
+#define IS_DISK(DEV)        					\
+  ((DEV) >= MIX_DISKORDRUMUNIT1 && (DEV) <= MIX_DISKORDRUMUNIT8)
+
+
+
+
+/*********/
+/* TIPUS */
+/*********/
+
+typedef struct
+{
+
+  FILE *f;
+  char *buf;     // Buffer de stdio
+  bool  std;     // stdin o stdout, no es tanca
+
+} file_t;
+
+/* Capçalera de les imatges de cinta i disc. */
+typedef struct
+{
+
+  char     magic[8];  // IMG_MAGIC
+  uint32_t order;     // IMG_ORDER, per a detectar l'ordre dels bytes
+  uint32_t reserved;
+  uint64_t nwords;    // Paraules escrites (final de la cinta)
+
+} img_header_t;
+
+typedef struct
+{
+
+  int           fd;    // -1 si no hi ha imatge
+  img_header_t *hdr;   // Projecció del fitxer
+  MIX_Word     *words; // Paraules, darrere de la capçalera
+  uint64_t      cap;   // Paraules projectades
+
+} img_t;
+
+/* Operació en curs d'un dispositiu. */
+typedef struct
+{
+
+  MIX_OPType    type;
+  long          pos;       // Cintes i discs: posició en paraules
+  int           n;         // Caràcters del registre
+  MIX_Word      words[BLOCK_WORDS];
+  MIX_Char      chars[120];                // Entrada
+  char          text[MIX_TEXT_SIZE(120)+1]; // Eixida, amb el '\n'
+  size_t        len;
+  MIX_IOOPWord *opw;
+  MIX_IOOPChar *opc;
+  bool          pending;   // Falta copiar l'entrada en la memòria
+
+} job_t;
+
+struct MIX_Devices
+{
+
+  MIX_Machine *m;
+
+  // Fitxers d'entrada i d'eixida de cada dispositiu.
+  file_t in[NDEVS];
+  file_t out[NDEVS];
+  bool   warned[NDEVS];
+
+  // Cintes i discs: posició actual en paraules, posició del fitxer
+  // i última operació (MIX_IN, MIX_OUT o -1 si cal reposicionar el
+  // fitxer).
+  long  pos[MIX_CARDREADER];
+  long  fpos[MIX_CARDREADER];
+  int   last[MIX_CARDREADER];
+  img_t img[MIX_CARDREADER];
+
+  // Operacions. Com a molt n'hi ha una en curs per dispositiu, ja que
+  // la màquina espera que el dispositiu no estiga ocupat.
+  job_t      jobs[NDEVS];
+  atomic_int busy[NDEVS];
+
+  // Fils de treball i cua de dispositius amb operacions pendents.
+  pthread_t       workers[MAX_WORKERS];
+  int             nworkers;
+  pthread_mutex_t lock;
+  pthread_cond_t  cond;
+  pthread_cond_t  idle;
+  int             queue[NDEVS];
+  int             qhead;
+  int             qlen;
+  int             njobs;   // En la cua o executant-se
+  bool            stop;
+
+  // Targetes llegides per avançat.
+  MIX_Char cards[CARD_BLOCK][80];
+  int      ncards;
+  int      next_card;
+
+  // Línia actual de la pàgina de l'impresora.
+  int line;
+
+};
+
+
+
+
+/*************/
+/* CONSTANTS */
+/*************/
+
+// Les targetes de mixala escriuen Δ com '&'.
+static const MIX_TextSubst _subst= { '&', '\0', '\0' };
+
+
+
+
+/************/
+/* FUNCIONS */
+/************/
+
+static void
+warning (
+         void       *udata,
+         const char *format,
+         ...
+         )
+{
+
+  va_list ap;
+
+
+  (void) udata;
+  va_start ( ap, format );
+  fprintf ( stderr, "Avís: " );
+  vfprintf ( stderr, format, ap );
+  fprintf ( stderr, "\n" );
+  va_end ( ap );
+
+} /* end warning */
+
+
+static void
+file_close (
+            file_t *fl
+            )
+{
+
+  if ( fl->f != NULL )
+    {
+      if ( fl->std ) fflush ( fl->f );
+      else           fclose ( fl->f );
+    }
+  free ( fl->buf );
+  fl->f= NULL;
+  fl->buf= NULL;
+  fl->std= false;
+
+} /* end file_close */
+
+
+static bool
+file_open (
+           file_t     *fl,
+           const char *fn,
+           const char *mode
+           )
+{
+
+  file_close ( fl );
+  if ( strcmp ( fn, "-" ) == 0 )
+    {
+      fl->f= mode[0] == 'r' && mode[1] != '+' ? stdin : stdout;
+      fl->std= true;
+      return true;
+    }
+  fl->f= fopen ( fn, mode );
+  if ( fl->f == NULL && strcmp ( mode, "r+b" ) == 0 )
+    fl->f= fopen ( fn, "w+b" );
+  if ( fl->f == NULL ) return false;
+  fl->buf= malloc ( FILE_BUF_SIZE );
+  if ( fl->buf != NULL )
+    setvbuf ( fl->f, fl->buf, _IOFBF, FILE_BUF_SIZE );
+
+  return true;
+
+} /* end file_open */
+
+
+/* Llig una línia de F. Torna false si no queden línies. Les línies
+   massa llargues es tallen. */
+static bool
+read_line (
+           FILE      *f,
+           MIX_Char  *to,
+           const int  n
+           )
+{
+
+  char line[4*120+2];
+  size_t len, i;
+  int c;
+
+
+  if ( fgets ( line, sizeof(line), f ) == NULL ) return false;
+  len= strlen ( line );
+  if ( len > 0 && line[len-1] != '\n' )
+    while ( (c= getc ( f )) != EOF && c != '\n' );
+  for ( i= MIX_text_to_chars ( to, (size_t) n, line, len, &_subst, NULL );
+        i < (size_t) n; ++i )
+    to[i]= MIX_SPACE;
+
+  return true;
+
+} /* end read_line */
+
+
+/* Escriu el text d'un registre sense els espais finals. */
+static void
+write_line (
+            FILE   *f,
+            char   *text,
+            size_t  len
+            )
+{
+
+  while ( len > 0 && text[len-1] == ' ' ) --len;
+  text[len++]= '\n';
+  fwrite ( text, 1, len, f );
+
+} /* end write_line */
+
+
+/* Llig fins a CARD_BLOCK targetes. */
+static void
+fill_cards (
+            MIX_Devices *d
+            )
+{
+
+  FILE *f;
+
+
+  d->ncards= d->next_card= 0;
+  f= d->in[MIX_CARDREADER].f;
+  if ( f == NULL ) return;
+  while ( d->ncards < CARD_BLOCK &&
+          read_line ( f, d->cards[d->ncards], 80 ) )
+    ++(d->ncards);
+
+} /* end fill_cards */
+
+
+/* Part de fitxer d'una operació de caràcters. */
+static void
+char_transfer (
+               MIX_Devices *d,
+               const int    dev
+               )
+{
+
+  job_t *j;
+  FILE *f;
+
+
+  j= &(d->jobs[dev]);
+  f= j->type == MIX_IN ? d->in[dev].f : d->out[dev].f;
+  if ( f == NULL && !d->warned[dev] )
+    {
+      warning ( d, "el dispositiu %d no té fitxer %s", dev,
+                j->type == MIX_IN ? "d'entrada" : "d'eixida" );
+      d->warned[dev]= true;
+    }
+  if ( j->type == MIX_IN )
+    {
+      if ( dev == MIX_CARDREADER )
+        {
+          if ( d->next_card == d->ncards ) fill_cards ( d );
+          if ( d->next_card < d->ncards )
+            memcpy ( j->chars, d->cards[d->next_card++], 80*sizeof(MIX_Char) );
+          else
+            memset ( j->chars, MIX_SPACE, sizeof(j->chars) );
+        }
+      else if ( f == NULL || !read_line ( f, j->chars, j->n ) )
+        memset ( j->chars, MIX_SPACE, sizeof(j->chars) );
+    }
+  else
+    {
+      if ( f != NULL ) write_line ( f, j->text, j->len );
+      if ( dev == MIX_LINEPRINTER && ++(d->line) == PAGE_LINES )
+        d->line= 0;
+    }
+
+} /* end char_transfer */
+
+
+/* Part de fitxer d'una operació de paraules. El fitxer sols es
+   reposiciona si no està ja en la posició o si canvia el tipus
+   d'operació. */
+static void
+word_transfer (
+               MIX_Devices *d,
+               const int    dev
+               )
+{
+
+  job_t *j;
+  unsigned char b[BLOCK_BYTES];
+  FILE *f;
+  size_t n;
+  int i;
+
+
+  j= &(d->jobs[dev]);
+  f= d->in[dev].f;
+  if ( f == NULL )
+    {
+      if ( !d->warned[dev] )
+        {
+          warning ( d, "el dispositiu %d no té fitxer", dev );
+          d->warned[dev]= true;
+        }
+      if ( j->type == MIX_IN ) memset ( j->words, 0, sizeof(j->words) );
+      return;
+    }
+  if ( d->last[dev] != (int) j->type || d->fpos[dev] != j->pos )
+    fseek ( f, 4*j->pos, SEEK_SET );
+  d->last[dev]= (int) j->type;
+  d->fpos[dev]= j->pos + BLOCK_WORDS;
+  if ( j->type == MIX_IN )
+    {
+      n= fread ( b, 1, BLOCK_BYTES, f );
+      memset ( b+n, 0, BLOCK_BYTES-n );
+      for ( i= 0; i < BLOCK_WORDS; ++i )
+        j->words[i]= (((MIX_Word) b[4*i])<<24) | (((MIX_Word) b[4*i+1])<<16) |
+          (((MIX_Word) b[4*i+2])<<8) | ((MIX_Word) b[4*i+3]);
+    }
+  else
+    {
+      for ( i= 0; i < BLOCK_WORDS; ++i )
+        {
+          b[4*i]= (unsigned char) (j->words[i]>>24);
+          b[4*i+1]= (unsigned char) (j->words[i]>>16);
+          b[4*i+2]= (unsigned char) (j->words[i]>>8);
+          b[4*i+3]= (unsigned char) j->words[i];
+        }
+      fwrite ( b, 1, BLOCK_BYTES, f );
+    }
+
+} /* end word_transfer */
+
+
+/* Copia en la memòria de la màquina el registre llegit. S'executa en
+   el fil de la màquina. */
+static void
+finish (
+        MIX_Devices *d,
+        const int    dev
+        )
+{
+
+  job_t *j;
+
+
+  j= &(d->jobs[dev]);
+  if ( !j->pending ) return;
+  if ( dev < MIX_CARDREADER )
+    MIX_machine_write_words ( d->m, j->words, BLOCK_WORDS, j->opw );
+  else
+    MIX_machine_write_chars ( d->m, j->chars, (size_t) j->n, j->opc );
+  j->pending= false;
+
+} /* end finish */
+
+
+static void *
+worker (
+        void *udata
+        )
+{
+
+  MIX_Devices *d;
+  int dev;
+
+
+  d= (MIX_Devices *) udata;
+  pthread_mutex_lock ( &(d->lock) );
+  for (;;)
+    {
+      while ( d->qlen == 0 && !d->stop )
+        pthread_cond_wait ( &(d->cond), &(d->lock) );
+      if ( d->qlen == 0 ) break;
+      dev= d->queue[d->qhead];
+      d->qhead= (d->qhead+1)%NDEVS;
+      --(d->qlen);
+      pthread_mutex_unlock ( &(d->lock) );
+      if ( dev < MIX_CARDREADER ) word_transfer ( d, dev );
+      else                        char_transfer ( d, dev );
+      // Les dades del treball han de ser visibles abans que el flag.
+      atomic_store_explicit ( &(d->busy[dev]), 0, memory_order_release );
+      MIX_machine_device_ready ( d->m, (MIX_Device) dev );
+      pthread_mutex_lock ( &(d->lock) );
+      if ( --(d->njobs) == 0 ) pthread_cond_broadcast ( &(d->idle) );
+    }
+  pthread_mutex_unlock ( &(d->lock) );
+
+  return NULL;
+
+} /* end worker */
+
+
+/* Executa el treball del dispositiu DEV, o el passa als fils de
+   treball si n'hi ha. */
+static void
+submit (
+        MIX_Devices *d,
+        const int    dev
+        )
+{
+
+  d->jobs[dev].pending= d->jobs[dev].type == MIX_IN;
+  if ( d->nworkers == 0 )
+    {
+      if ( dev < MIX_CARDREADER ) word_transfer ( d, dev );
+      else                        char_transfer ( d, dev );
+      finish ( d, dev );
+      return;
+    }
+  atomic_store_explicit ( &(d->busy[dev]), 1, memory_order_relaxed );
+  pthread_mutex_lock ( &(d->lock) );
+  d->queue[(d->qhead+d->qlen)%NDEVS]= dev;
+  ++(d->qlen);
+  ++(d->njobs);
+  pthread_cond_signal ( &(d->cond) );
+  pthread_mutex_unlock ( &(d->lock) );
+
+} /* end submit */
+
+
+static void
+init_ioopchar (
+               void         *udata,
+               MIX_Device    dev,
+               MIX_IOOPChar *op,
+               MIX_OPType    type
+               )
+{
+
+  MIX_Devices *d;
+  job_t *j;
+
+
+  d= (MIX_Devices *) udata;
+  j= &(d->jobs[dev]);
+  j->type= type;
+  j->n= (int) op->remain;
+  j->opc= op;
+  if ( type == MIX_OUT )
+    MIX_machine_read_text ( d->m, j->text, (size_t) j->n, op, NULL, &(j->len) );
+  submit ( d, dev );
+
+} /* end init_ioopchar */
+
+
+/* Projecta la imatge amb CAP paraules, fent créixer el fitxer si
+   cal. */
+static bool
+img_map (
+         img_t          *img,
+         const uint64_t  cap
+         )
+{
+
+  size_t size;
+  void *p;
+
+
+  size= sizeof(img_header_t) + (size_t) cap*sizeof(MIX_Word);
+  if ( ftruncate ( img->fd, (off_t) size ) == -1 ) return false;
+  p= mmap ( NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, img->fd, 0 );
+  if ( p == MAP_FAILED ) return false;
+  if ( img->hdr != NULL )
+    munmap ( img->hdr, sizeof(img_header_t) + img->cap*sizeof(MIX_Word) );
+  img->hdr= (img_header_t *) p;
+  img->words= (MIX_Word *) (img->hdr+1);
+  img->cap= cap;
+
+  return true;
+
+} /* end img_map */
+
+
+/* Deixa el fitxer amb les paraules escrites i el tanca. */
+static void
+img_close (
+           img_t *img
+           )
+{
+
+  uint64_t nwords;
+
+
+  if ( img->fd == -1 ) return;
+  if ( img->hdr != NULL )
+    {
+      nwords= img->hdr->nwords;
+      munmap ( img->hdr, sizeof(img_header_t) + img->cap*sizeof(MIX_Word) );
+      if ( ftruncate ( img->fd, (off_t) (sizeof(img_header_t) +
+                                         nwords*sizeof(MIX_Word)) ) == -1 )
+        warning ( NULL, "no s'ha pogut ajustar la grandària de la imatge" );
+    }
+  close ( img->fd );
+  img->fd= -1;
+  img->hdr= NULL;
+  img->words= NULL;
+  img->cap= 0;
+
+} /* end img_close */
+
+
+static bool
+img_open (
+          img_t      *img,
+          const char *fn
+          )
+{
+
+  struct stat st;
+  img_header_t hdr;
+  uint64_t cap;
+  bool created;
+
+
+  img_close ( img );
+  created= false;
+  img->fd= open ( fn, O_RDWR );
+  if ( img->fd == -1 && errno == ENOENT )
+    {
+      img->fd= open ( fn, O_RDWR|O_CREAT|O_EXCL, 0666 );
+      created= true;
+    }
+  if ( img->fd == -1 ) return false;
+  if ( fstat ( img->fd, &st ) == -1 ) goto error;
+  if ( st.st_size == 0 )
+    {
+      if ( !img_map ( img, IMG_INITIAL_WORDS ) ) goto error;
+      memcpy ( img->hdr->magic, IMG_MAGIC, sizeof(img->hdr->magic) );
+      img->hdr->order= IMG_ORDER;
+      img->hdr->reserved= 0;
+      img->hdr->nwords= 0;
+    }
+  else
+    {
+      // Es comprova la capçalera abans de tocar el fitxer.
+      cap= (size_t) st.st_size < sizeof(img_header_t) ? 0 :
+        ((uint64_t) st.st_size - sizeof(img_header_t))/sizeof(MIX_Word);
+      if ( (size_t) st.st_size < sizeof(img_header_t) ||
+           pread ( img->fd, &hdr, sizeof(hdr), 0 ) != (ssize_t) sizeof(hdr) ||
+           memcmp ( hdr.magic, IMG_MAGIC, sizeof(hdr.magic) ) != 0 ||
+           hdr.order != IMG_ORDER ||
+           hdr.nwords > cap )
+        {
+          warning ( NULL, "'%s' no és una imatge vàlida", fn );
+          goto error;
+        }
+      if ( !img_map ( img, cap ) ) goto error;
+    }
+
+  return true;
+
+ error:
+  img_close ( img );
+  if ( created ) remove ( fn );
+  return false;
+
+} /* end img_open */
+
+
+/* Transferix el bloc de la posició POS directament entre la
+   projecció i la memòria de la màquina. */
+static void
+img_ioop (
+          MIX_Devices      *d,
+          img_t            *img,
+          MIX_IOOPWord     *op,
+          const MIX_OPType  type,
+          const long        pos
+          )
+{
+
+  static const MIX_Word zeros[BLOCK_WORDS];
+
+  uint64_t end, cap;
+
+
+  end= (uint64_t) pos + BLOCK_WORDS;
+  if ( type == MIX_IN )
+    {
+      if ( (uint64_t) pos < img->cap )
+        MIX_machine_write_words ( d->m, img->words + pos,
+                                  end <= img->cap ?
+                                  BLOCK_WORDS : img->cap - (uint64_t) pos,
+                                  op );
+      if ( op->remain > 0 )
+        MIX_machine_write_words ( d->m, zeros, BLOCK_WORDS, op );
+    }
+  else
+    {
+      if ( end > img->cap )
+        {
+          cap= 2*img->cap > end ? 2*img->cap : end;
+          if ( !img_map ( img, cap ) )
+            {
+              warning ( d, "no s'ha pogut fer créixer la imatge" );
+              return;
+            }
+        }
+      MIX_machine_read_words ( d->m, img->words + pos, BLOCK_WORDS, op );
+      if ( end > img->hdr->nwords ) img->hdr->nwords= end;
+    }
+
+} /* end img_ioop */
+
+
+static void
+init_ioopword (
+               void         *udata,
+               MIX_Device    dev,
+               MIX_IOOPWord *op,
+               MIX_OPType    type
+               )
+{
+
+  MIX_Devices *d;
+  job_t *j;
+  long pos;
+
+
+  d= (MIX_Devices *) udata;
+  pos= IS_DISK ( dev ) ? (long) op->block*BLOCK_WORDS : d->pos[dev];
+  d->pos[dev]= pos + BLOCK_WORDS;
+  if ( d->img[dev].fd != -1 )
+    {
+      img_ioop ( d, &(d->img[dev]), op, type, pos );
+      return;
+    }
+  j= &(d->jobs[dev]);
+  j->type= type;
+  j->pos= pos;
+  j->opw= op;
+  if ( type == MIX_OUT )
+    MIX_machine_read_words ( d->m, j->words, BLOCK_WORDS, op );
+  submit ( d, dev );
+
+} /* end init_ioopword */
+
+
+static MIX_Bool
+device_busy (
+             void       *udata,
+             MIX_Device  dev
+             )
+{
+
+  MIX_Devices *d;
+
+
+  d= (MIX_Devices *) udata;
+  if ( atomic_load_explicit ( &(d->busy[dev]), memory_order_acquire ) )
+    return MIX_TRUE;
+  finish ( d, dev );
+
+  return MIX_FALSE;
+
+} /* end device_busy */
+
+
+/* Paraules que té el fitxer de la cinta DEV. */
+static long
+tape_size (
+           MIX_Devices *d,
+           const int    dev
+           )
+{
+
+  FILE *f;
+  long ret;
+
+
+  if ( d->img[dev].fd != -1 ) return (long) d->img[dev].hdr->nwords;
+  f= d->in[dev].f;
+  if ( f == NULL ) return 0;
+  fflush ( f );
+  fseek ( f, 0, SEEK_END );
+  ret= ftell ( f ) / 4;
+  d->last[dev]= -1;
+
+  return ret;
+
+} /* end tape_size */
+
+
+static void
+io_control (
+            void            *udata,
+            MIX_IOControlOp  op,
+            ...
+            )
+{
+
+  MIX_Devices *d;
+  va_list ap;
+  int dev, n;
+  long size;
+  FILE *f;
+
+
+  d= (MIX_Devices *) udata;
+  va_start ( ap, op );
+  if ( op == MIX_LP_SKIPTOFOLLOWINGPAGE )
+    {
+      f= d->out[MIX_LINEPRINTER].f;
+      for ( ; d->line != 0; d->line= (d->line+1)%PAGE_LINES )
+        if ( f != NULL ) putc ( '\n', f );
+    }
+  else if ( op != MIX_DK_SEEK ) // Els discs es posicionen en cada operació
+    {
+      dev= va_arg ( ap, int );
+      if ( op == MIX_MT_REWOUND ) d->pos[dev]= 0;
+      else
+        {
+          n= va_arg ( ap, int );
+          if ( op == MIX_MT_SKIPBACKWARD )
+            d->pos[dev]= d->pos[dev] > n ? d->pos[dev]-n : 0;
+          else
+            {
+              size= tape_size ( d, dev );
+              d->pos[dev]= d->pos[dev]+n < size ? d->pos[dev]+n : size;
+            }
+        }
+    }
+  va_end ( ap );
+
+} /* end io_control */
+
+
+static void
+notify_waiting_device (
+                       void             *udata,
+                       const MIX_Device  dev,
+                       const bool        waiting
+                       )
+{
+
+  (void) udata;
+  (void) dev;
+  (void) waiting;
+
+} /* end notify_waiting_device */
+
+
+
+/* Espera que acaben totes les operacions dels fils de treball. */
+static void
+wait_idle (
+           MIX_Devices *d
+           )
+{
+
+  pthread_mutex_lock ( &(d->lock) );
+  while ( d->njobs > 0 )
+    pthread_cond_wait ( &(d->idle), &(d->lock) );
+  pthread_mutex_unlock ( &(d->lock) );
+
+} /* end wait_idle */
+
+
+static void
+stop_workers (
+              MIX_Devices *d
+              )
+{
+
+  int i;
+
+
+  pthread_mutex_lock ( &(d->lock) );
+  d->stop= true;
+  pthread_cond_broadcast ( &(d->cond) );
+  pthread_mutex_unlock ( &(d->lock) );
+  for ( i= 0; i < d->nworkers; ++i )
+    pthread_join ( d->workers[i], NULL );
+  d->nworkers= 0;
+  d->stop= false;
+
+} /* end stop_workers */
+
+
+
+
+/**********************/
+/* FUNCIONS PÚBLIQUES */
+/**********************/
+
+MIX_Devices *
+MIX_devices_new (
+                 MIX_Machine *m
+                 )
+{
+
+  MIX_Devices *ret;
+  int i;
+
+
+  ret= (MIX_Devices *) calloc ( 1, sizeof(MIX_Devices) );
+  if ( ret == NULL ) return NULL;
+  ret->m= m;
+  for ( i= 0; i < MIX_CARDREADER; ++i )
+    {
+      ret->last[i]= -1;
+      ret->img[i].fd= -1;
+    }
+  for ( i= 0; i < NDEVS; ++i )
+    atomic_init ( &(ret->busy[i]), 0 );
+  pthread_mutex_init ( &(ret->lock), NULL );
+  pthread_cond_init ( &(ret->cond), NULL );
+  pthread_cond_init ( &(ret->idle), NULL );
+
+  return ret;
+
+} // end MIX_devices_new
+
+
+void
+MIX_devices_free (
+                  MIX_Devices *d
+                  )
+{
+
+  int i;
+
+
+  stop_workers ( d );
+  for ( i= 0; i < NDEVS; ++i )
+    {
+      file_close ( &(d->in[i]) );
+      file_close ( &(d->out[i]) );
+    }
+  for ( i= 0; i < MIX_CARDREADER; ++i )
+    img_close ( &(d->img[i]) );
+  pthread_mutex_destroy ( &(d->lock) );
+  pthread_cond_destroy ( &(d->cond) );
+  pthread_cond_destroy ( &(d->idle) );
+  free ( d );
+
+} // end MIX_devices_free
+
+
+MIX_Bool
+MIX_devices_open (
+                  MIX_Devices      *d,
+                  const MIX_Device  dev,
+                  const char       *fn,
+                  const MIX_OPType  type
+                  )
+{
+
+  bool ok;
+
+
+  wait_idle ( d );
+  d->warned[dev]= false;
+  if ( dev < MIX_CARDREADER )
+    {
+      img_close ( &(d->img[dev]) );
+      ok= file_open ( &(d->in[dev]), fn, "r+b" );
+      d->pos[dev]= 0;
+      d->last[dev]= -1;
+    }
+  else if ( dev == MIX_CARDREADER ||
+            (type == MIX_IN && dev >= MIX_TYPEWRITERTERMINAL) )
+    {
+      ok= file_open ( &(d->in[dev]), fn, "r" );
+      if ( dev == MIX_CARDREADER ) d->ncards= d->next_card= 0;
+    }
+  else
+    {
+      ok= file_open ( &(d->out[dev]), fn, "w" );
+      if ( dev == MIX_LINEPRINTER ) d->line= 0;
+    }
+
+  return ok ? MIX_TRUE : MIX_FALSE;
+
+} // end MIX_devices_open
+
+
+void
+MIX_devices_frontend (
+                      MIX_Devices  *d,
+                      MIX_Frontend *fe
+                      )
+{
+
+  (void) d;
+  fe->warning= warning;
+  fe->check= NULL;
+  fe->init_ioopchar= init_ioopchar;
+  fe->init_ioopword= init_ioopword;
+  fe->device_busy= device_busy;
+  fe->io_control= io_control;
+  fe->notify_waiting_device= notify_waiting_device;
+
+} // end MIX_devices_frontend
+
+
+MIX_Bool
+MIX_devices_open_image (
+                        MIX_Devices      *d,
+                        const MIX_Device  dev,
+                        const char       *fn
+                        )
+{
+
+  if ( dev >= MIX_CARDREADER ) return MIX_FALSE;
+  wait_idle ( d );
+  d->warned[dev]= false;
+  file_close ( &(d->in[dev]) );
+  d->pos[dev]= 0;
+  d->last[dev]= -1;
+
+  return img_open ( &(d->img[dev]), fn ) ? MIX_TRUE : MIX_FALSE;
+
+} // end MIX_devices_open_image
+
+
+MIX_Bool
+MIX_devices_set_workers (
+                         MIX_Devices *d,
+                         const int    n
+                         )
+{
+
+  int i;
+
+
+  if ( n < 0 || n > MAX_WORKERS ) return MIX_FALSE;
+  stop_workers ( d );
+  for ( i= 0; i < n; ++i )
+    {
+      if ( pthread_create ( &(d->workers[i]), NULL, worker, d ) != 0 )
+        break;
+      ++(d->nworkers);
+    }
+  if ( d->nworkers != n )
+    {
+      stop_workers ( d );
+      return MIX_FALSE;
+    }
+
+  return MIX_TRUE;
+
+} // end MIX_devices_set_workers
+
+
+void
+MIX_devices_sync (
+                  MIX_Devices *d
+                  )
+{
+
+  int i;
+
+
+  wait_idle ( d );
+  for ( i= 0; i < NDEVS; ++i )
+    finish ( d, i );
+
+} // end MIX_devices_sync
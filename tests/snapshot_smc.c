@@ -0,0 +1,167 @@
+/*
+ * Copyright 2026 Adrià Giménez Pastor.
+ *
+ * This file is part of adriagipas/MIX.
+ *
+ * adriagipas/MIX is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation, either version 3 of the
+ * License, or (at your option) any later version.
+ *
+ * adriagipas/MIX is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with adriagipas/MIX.  If not, see <https://www.gnu.org/licenses/>.
+ */
+/*
+ *  snapshot_smc.c - Comprova que les escriptures de dades després
+ *                   d'una còpia no es compten com a codi
+ *                   automodificat.
+ *
+ *  cc -std=gnu11 -O2 -Isrc tests/snapshot_smc.c src/mix.c \
+ *     src/mix_dev.c src/mix_aot.c -lpthread -o snapshot_smc
+ *  ./snapshot_smc
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "MIX.h"
+
+
+
+
+/**********/
+/* MACROS */
+/**********/
+
+#define INST(A,I,F,C)        					\
+  ((MIX_Word) (((A)<<18) | ((I)<<12) | ((F)<<6) | (C)))
+
+#define DATA 3000
+
+
+
+
+/*************/
+/* PROGRAMES */
+/*************/
+
+/* Si DATA és 0 hi guarda 7 deu vegades, si no para. Executa
+   PROG_INSTS instruccions només si la còpia ha recuperat DATA. */
+static const MIX_Word _prog[]=
+  {
+    INST ( DATA, 0, 5, 8 ),  // LDA DATA
+    INST ( 7, 0, 4, 40 ),    // JANZ 7
+    INST ( 7, 0, 2, 48 ),    // ENTA 7
+    INST ( 10, 0, 2, 49 ),   // ENT1 10
+    INST ( DATA, 0, 5, 24 ), // STA DATA
+    INST ( 1, 0, 1, 49 ),    // DEC1 1
+    INST ( 4, 0, 2, 41 ),    // J1P 4
+    INST ( 0, 0, 2, 5 )      // HLT
+  };
+
+#define PROG_INSTS (4+10*3+1)
+
+
+
+
+/************/
+/* FUNCIONS */
+/************/
+
+static int
+check (
+       const char       *name,
+       const MIX_Engine  engine,
+       const MIX_Bool    counting
+       )
+{
+
+  MIX_Machine *m;
+  MIX_Devices *dev;
+  MIX_Frontend fe;
+  MIX_Snapshot *snap;
+  MIX_Counters ctr;
+  MIX_RunResult res;
+  unsigned long long insts;
+  int ret, it;
+
+
+  m= MIX_machine_new ();
+  dev= m != NULL ? MIX_devices_new ( m ) : NULL;
+  snap= MIX_snapshot_new ();
+  if ( m == NULL || dev == NULL || snap == NULL )
+    {
+      fprintf ( stderr, "%s: sense memòria\n", name );
+      return 1;
+    }
+  MIX_devices_frontend ( dev, &fe );
+  MIX_machine_init ( m, &fe, dev );
+  MIX_machine_set_engine ( m, engine );
+  MIX_machine_set_counting ( m, counting );
+  MIX_load_image ( m, _prog, 0, sizeof(_prog)/sizeof(_prog[0]), 0 );
+
+  // Diverses voltes perquè el JIT tradueix el bucle en la segona.
+  ret= 0;
+  MIX_machine_snapshot ( m, snap );
+  for ( it= 0; it < 3 && ret == 0; ++it )
+    {
+      MIX_machine_fork ( m, snap );
+      MIX_machine_reset_counters ( m );
+      insts= 0;
+      do {
+        MIX_run ( m, 100000, &res );
+        insts+= res.insts;
+      } while ( res.status != MIX_RUN_HALT );
+      MIX_machine_counters ( m, &ctr );
+      if ( ctr.smc != 0 )
+        {
+          fprintf ( stderr, "%s: smc=%llu, s'esperava 0\n", name, ctr.smc );
+          ret= 1;
+        }
+      if ( insts != PROG_INSTS )
+        {
+          fprintf ( stderr, "%s: %llu instruccions, s'esperaven %d\n",
+                    name, insts, PROG_INSTS );
+          ret= 1;
+        }
+    }
+
+  MIX_snapshot_free ( snap );
+  MIX_devices_free ( dev );
+  MIX_machine_free ( m );
+  if ( ret == 0 ) printf ( "%s: ok\n", name );
+
+  return ret;
+
+} /* end check */
+
+
+
+
+/******************/
+/* PUNT D'ENTRADA */
+/******************/
+
+int
+main (void)
+{
+
+  int ret;
+
+
+  ret= 0;
+  ret|= check ( "interp", MIX_ENGINE_INTERP, MIX_FALSE );
+  ret|= check ( "interp+counting", MIX_ENGINE_INTERP, MIX_TRUE );
+  ret|= check ( "jit", MIX_ENGINE_JIT, MIX_FALSE );
+  ret|= check ( "profile", MIX_ENGINE_PROFILE, MIX_FALSE );
+
+  return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+} // end main